@@ -11,8 +11,15 @@ layout(binding = 0) uniform UniformBufferObject {
     mat4 model, view, projection;
 } ubo;
 
+layout(std430, binding = 3) readonly buffer DrawData {
+    mat4 models[];
+} draws;
+
+invariant gl_Position;
+
 void main() {
-    FragPos = vec3(ubo.model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(ubo.model))) * aNormal;
+    mat4 model = draws.models[gl_InstanceIndex];
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(model))) * aNormal;
     gl_Position = ubo.projection * ubo.view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,5 @@
+#version 450 core
+
+// Depth only, color writes are masked
+void main() {
+}
@@ -0,0 +1,19 @@
+#version 450 core
+
+// Position-only stream, the model matrix is the shading pass's
+layout(location = 0) in vec3 aPos;
+layout(location = 3) in uint aDrawID;     // per instance, the base instance selects the draw
+
+layout(std430, binding = 0) readonly buffer DrawData {
+    mat4 models[];
+} draws;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+invariant gl_Position;
+
+void main() {
+    vec3 FragPos = vec3(draws.models[aDrawID] * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,19 @@
+#version 450
+
+// Position-only stream, the model matrix is the shading pass's
+layout(location = 0) in vec3 aPos;
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model, view, projection;
+} ubo;
+
+layout(std430, binding = 3) readonly buffer DrawData {
+    mat4 models[];
+} draws;
+
+invariant gl_Position;
+
+void main() {
+    vec3 FragPos = vec3(draws.models[gl_InstanceIndex] * vec4(aPos, 1.0));
+    gl_Position = ubo.projection * ubo.view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,43 @@
+#version 450 core
+#extension GL_ARB_bindless_texture : require
+
+in vec2 TexCoords;
+in vec3 FragPos;
+in vec3 Normal;
+flat in uint MaterialIndex;
+out vec4 FragColor;
+
+struct Material {
+    vec4 diffuse;       // alpha in w
+    vec4 specular;      // shininess in w
+    vec4 emissive;
+    uvec2 texture;      // resident handle, zero for shapes without a texture
+    uint alphaMode;     // 1 masked, 2 blended
+    uint padding;
+};
+
+layout(std430, binding = 2) readonly buffer Materials {
+    Material materials[];
+};
+
+uniform mat4 view;
+
+void main() {
+    Material material = materials[MaterialIndex];
+    if (material.texture != uvec2(0)) {
+        vec4 color = texture(sampler2D(material.texture), TexCoords);
+        FragColor = vec4(color.rgb + material.emissive.rgb, color.a * material.diffuse.a);
+    } else {    // No Texture, the same as solid
+        vec3 lightDir = normalize(vec3(view * vec4(-0.2, -1.0, -0.3, 0.0)));
+        vec3 norm = normalize(Normal);
+        float diff = max(dot(norm, lightDir), 0.0);
+        vec3 viewDir = normalize(inverse(view)[3].xyz - FragPos);
+        float spec = pow(max(dot(norm, normalize(lightDir + viewDir)), 0.0), max(material.specular.w, 1.0));
+        vec3 ambient= vec3(0.3, 0.3, 0.3);
+        vec3 diffuse = diff * vec3(0.8, 0.8, 0.8);
+        vec3 result = material.diffuse.rgb * (ambient + diffuse) + material.specular.rgb * spec + material.emissive.rgb;
+        FragColor = vec4(result, material.diffuse.a);
+    }
+    if (material.alphaMode == 1u && FragColor.a < 0.5) discard;
+
+}
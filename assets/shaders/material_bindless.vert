@@ -0,0 +1,34 @@
+#version 450 core
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+layout(location = 3) in uint aDrawID;     // per instance, the base instance selects the draw
+
+layout(std430, binding = 0) readonly buffer DrawData {
+    mat4 models[];
+} draws;
+
+// Entry of the material table per draw, it holds the resident texture handle
+layout(std430, binding = 1) readonly buffer DrawMaterials {
+    uint indices[];
+} drawMaterials;
+
+out vec2 TexCoords;
+out vec3 FragPos;
+out vec3 Normal;
+flat out uint MaterialIndex;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+invariant gl_Position;
+
+void main() {
+    mat4 model = draws.models[aDrawID];
+    TexCoords = aTexCoords;
+    MaterialIndex = drawMaterials.indices[aDrawID];
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(model))) * aNormal;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,47 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec2 TexCoords;
+layout(location = 1) in vec3 FragPos;
+layout(location = 2) in vec3 Normal;
+layout(location = 3) flat in uint MaterialIndex;
+layout(location = 0) out vec4 FragColor;
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model, view, projection;
+} ubo;
+
+layout(binding = 4) uniform sampler2D textures[];
+
+struct Material {
+    vec4 diffuse;       // alpha in w
+    vec4 specular;      // shininess in w
+    vec4 emissive;
+    uvec2 texture;      // texture array element plus one in x, zero for shapes without texture coordinates
+    uint alphaMode;     // 1 masked, 2 blended
+    uint padding;
+};
+
+layout(std430, binding = 6) readonly buffer Materials {
+    Material materials[];
+};
+
+
+void main() {
+    Material material = materials[MaterialIndex];
+    if (material.texture.x != 0u) {
+        vec4 color = texture(textures[nonuniformEXT(material.texture.x - 1u)], TexCoords);
+        FragColor = vec4(color.rgb + material.emissive.rgb, color.a * material.diffuse.a);
+    } else {    // No Texture, the same as solid
+        vec3 lightDir = normalize(vec3(ubo.view * vec4(-0.2, -1.0, -0.3, 0.0)));
+        vec3 norm = normalize(Normal);
+        float diff = max(dot(norm, lightDir), 0.0);
+        vec3 viewDir = normalize(inverse(ubo.view)[3].xyz - FragPos);
+        float spec = pow(max(dot(norm, normalize(lightDir + viewDir)), 0.0), max(material.specular.w, 1.0));
+        vec3 ambient= vec3(0.3, 0.3, 0.3);
+        vec3 diffuse = diff * vec3(0.8, 0.8, 0.8);
+        vec3 result = material.diffuse.rgb * (ambient + diffuse) + material.specular.rgb * spec + material.emissive.rgb;
+        FragColor = vec4(result, material.diffuse.a);
+    }
+    if (material.alphaMode == 1u && FragColor.a < 0.5) discard;
+}
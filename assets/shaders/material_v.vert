@@ -7,14 +7,29 @@ layout(location = 2) in vec2 aTexCoords;
 layout(location = 0) out vec2 TexCoords;
 layout(location = 1) out vec3 FragPos;
 layout(location = 2) out vec3 Normal;
+layout(location = 3) flat out uint MaterialIndex;
 
 layout(binding = 0) uniform UniformBufferObject {
     mat4 model, view, projection;
 } ubo;
 
+layout(std430, binding = 3) readonly buffer DrawData {
+    mat4 models[];
+} draws;
+
+// Entry of the material table per draw
+layout(std430, binding = 5) readonly buffer DrawMaterials {
+    uint indices[];
+} drawMaterials;
+
+// Matches the depth pre-pass bit for bit, so the EQUAL depth test passes
+invariant gl_Position;
+
 void main() {
+    mat4 model = draws.models[gl_InstanceIndex];
     TexCoords = aTexCoords;
-    FragPos = vec3(ubo.model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(ubo.model))) * aNormal;
+    MaterialIndex = drawMaterials.indices[gl_InstanceIndex];
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(model))) * aNormal;
     gl_Position = ubo.projection * ubo.view * vec4(FragPos, 1.0);
 }
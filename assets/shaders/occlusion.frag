@@ -0,0 +1,7 @@
+#version 450 core
+
+out vec4 FragColor;
+
+void main() {
+    FragColor = vec4(0.0);
+}
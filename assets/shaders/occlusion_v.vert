@@ -0,0 +1,23 @@
+#version 450
+
+// Unit cube corners indexed by gl_VertexIndex, no vertex buffer needed
+const int indices[36] = int[36](
+    0, 2, 1, 1, 2, 3,
+    4, 5, 6, 5, 7, 6,
+    0, 1, 4, 1, 5, 4,
+    2, 6, 3, 3, 6, 7,
+    0, 4, 2, 2, 4, 6,
+    1, 3, 5, 3, 7, 5
+);
+
+layout(push_constant) uniform ProxyBox {
+    mat4 viewProjection;
+    vec4 boxMin;
+    vec4 boxMax;
+} box;
+
+void main() {
+    int corner = indices[gl_VertexIndex];
+    vec3 t = vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+    gl_Position = box.viewProjection * vec4(mix(box.boxMin.xyz, box.boxMax.xyz, t), 1.0);
+}
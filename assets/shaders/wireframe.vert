@@ -2,11 +2,16 @@
 
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
+layout(location = 3) in uint aDrawID;     // per instance, the base instance selects the draw
+
+layout(std430, binding = 0) readonly buffer DrawData {
+    mat4 models[];
+} draws;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
 void main() {
+    mat4 model = draws.models[aDrawID];
     gl_Position = projection * view * model * vec4(aPos, 1.0);
 }
@@ -8,8 +8,13 @@ layout(binding = 0) uniform UniformBufferObject {
     mat4 model, view, projection;
 } ubo;
 
+layout(std430, binding = 3) readonly buffer DrawData {
+    mat4 models[];
+} draws;
+
 void main() {
-    vec3 FragPos = vec3(ubo.model * vec4(aPos, 1.0));
-    vec3 Normal = mat3(transpose(inverse(ubo.model))) * aNormal;
+    mat4 model = draws.models[gl_InstanceIndex];
+    vec3 FragPos = vec3(model * vec4(aPos, 1.0));
+    vec3 Normal = mat3(transpose(inverse(model))) * aNormal;
     gl_Position = ubo.projection * ubo.view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
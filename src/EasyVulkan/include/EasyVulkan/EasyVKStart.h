@@ -8,6 +8,7 @@
 #include <vector>
 #include <stack>
 #include <map>
+#include <set>
 #include <unordered_map>
 #include <span>
 #include <memory>
@@ -18,6 +19,10 @@
 #include <numeric>
 #include <numbers>
 #include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <bit>
+#include <mutex>
 
 //GLM
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -335,7 +335,8 @@ namespace vulkan {
                     .size = size,
                     .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
             };
-            mbufferMemory.Create(bufferCreateInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+            //Staging memory is short-lived, bump allocate it
+            mbufferMemory.Create(bufferCreateInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, memoryAllocator::strategy_linear);
         }
         void Release() {
             mbufferMemory.~bufferMemory();
@@ -387,7 +388,9 @@ namespace vulkan {
             vkGetImageSubresourceLayout(graphicsBase::Base().Device(), aliasedImage, &subResource, &subresourceLayout);
             if (subresourceLayout.size != imageDataSize)
                 return VK_NULL_HANDLE;//No padding bytes
-            aliasedImage.BindMemory(mbufferMemory.Memory());
+            if (mbufferMemory.MemoryOffset() % aliasedImage.MemoryRequirements().alignment)
+                return VK_NULL_HANDLE;//The buffer's sub-allocation is not aligned for the image
+            aliasedImage.BindMemory(mbufferMemory.Memory(), mbufferMemory.MemoryOffset());
             return aliasedImage;
         }
         //Static Function
@@ -434,6 +437,7 @@ namespace vulkan {
         operator VkBuffer() const { return mbufferMemory.Buffer(); }
         const VkBuffer* Address() const { return mbufferMemory.AddressOfBuffer(); }
         VkDeviceSize AllocationSize() const { return mbufferMemory.AllocationSize(); }
+        VkMemoryPropertyFlags MemoryProperties() const { return mbufferMemory.MemoryProperties(); }
         //Const Function
         void TransferData(const void* pData_src, VkDeviceSize size, VkDeviceSize offset = 0) const {
             if (mbufferMemory.MemoryProperties() & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
@@ -553,6 +557,427 @@ namespace vulkan {
 		}
 	};
 
+	//Staging memory that any number of threads fill at the same time.
+	//Every thread writes through a writer of its own, which keeps a chunk of the pool to itself and only locks to trade it
+	//for a fresh one or to queue a copy. The render thread records the queued copies with CmdCopy(...) and Recycle(...)s
+	//chunks once the submission that read them has completed.
+	class stagingPool {
+	public:
+		struct copy {
+			VkBuffer buffer_src;
+			VkBuffer buffer_dst;
+			VkBufferCopy region;
+		};
+	private:
+		struct chunk {
+			bufferMemory memory;
+			VkDeviceSize size = 0;
+			VkDeviceSize head = 0;
+			uint32_t unrecorded = 0;//Queued copies CmdCopy(...) hasn't recorded yet
+			uint64_t retireValue = 0;//Completion value of the last submission reading it
+			bool held = false;//A writer is filling it
+		};
+		static constexpr VkDeviceSize copyAlignment = 16;
+		VkDeviceSize chunkSize;
+		VkDeviceSize keepBytes;//Free chunks kept around for reuse, the rest are released by Recycle(...)
+		std::mutex mutex;
+		std::vector<std::unique_ptr<chunk>> chunks;//Null for released slots, addresses stay put while writers hold them
+		std::vector<std::pair<copy, chunk*>> queued;
+		//--------------------
+		//Called with the mutex locked
+		chunk* Take(VkDeviceSize size) {
+			for (auto& i : chunks)
+				if (i && !i->held && !i->head && i->size >= size)
+					return i->held = true, i.get();
+			auto newChunk = std::make_unique<chunk>();
+			newChunk->size = std::max(size, chunkSize);
+			VkBufferCreateInfo bufferCreateInfo = {
+				.size = newChunk->size,
+				.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+			};
+			//Always available. Non-coherent memory would invalidate whole atoms on map, which may reach into a chunk another thread is writing
+			if (VkResult result = newChunk->memory.Create(bufferCreateInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, memoryAllocator::strategy_linear)) {
+				outStream << std::format("[ stagingPool ] ERROR\nFailed to create a staging chunk!\nError code: {}\n", int32_t(result));
+				return nullptr;
+			}
+			newChunk->held = true;
+			auto slot = std::find(chunks.begin(), chunks.end(), nullptr);
+			if (slot == chunks.end())
+				return chunks.emplace_back(std::move(newChunk)).get();
+			return (*slot = std::move(newChunk)).get();
+		}
+	public:
+		class writer {
+			stagingPool& pool;
+			chunk* current = nullptr;
+			//--------------------
+			void Drop() {
+				if (!current)
+					return;
+				std::lock_guard lock(pool.mutex);
+				current->held = false;
+				current = nullptr;
+			}
+		public:
+			writer(stagingPool& pool) :pool(pool) {}
+			writer(writer&&) = delete;
+			~writer() { Drop(); }
+			//Non-const Function
+			//write(void* pData_dst) fills size bytes of staging memory, they land at offset_dst of buffer_dst once the copy is recorded and submitted.
+			//Host-visible destinations are written right away and need no copy
+			template<typename F>
+			result_t Upload(const deviceLocalBuffer& buffer_dst, VkDeviceSize size, VkDeviceSize offset_dst, F&& write) {
+				if (!size)
+					return VK_SUCCESS;
+				if (buffer_dst.MemoryProperties() & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+					std::unique_ptr<uint8_t[]> pData = std::make_unique<uint8_t[]>(size_t(size));
+					write(static_cast<void*>(pData.get()));
+					buffer_dst.TransferData(pData.get(), size, offset_dst);
+					return VK_SUCCESS;
+				}
+				VkDeviceSize alignedSize = (size + copyAlignment - 1) / copyAlignment * copyAlignment;
+				if (!current || current->size - current->head < alignedSize) {
+					Drop();
+					std::lock_guard lock(pool.mutex);
+					if (!(current = pool.Take(alignedSize)))
+						return VK_ERROR_OUT_OF_HOST_MEMORY;
+				}
+				VkDeviceSize offset_src = current->head;
+				current->head += alignedSize;
+				void* pData_dst;
+				if (VkResult result = current->memory.MapMemory(pData_dst, size, offset_src))
+					return result;
+				write(pData_dst);
+				if (VkResult result = current->memory.UnmapMemory(size, offset_src))
+					return result;
+				std::lock_guard lock(pool.mutex);
+				current->unrecorded++;
+				pool.queued.push_back({ { current->memory.Buffer(), buffer_dst, { offset_src, offset_dst, size } }, current });
+				return VK_SUCCESS;
+			}
+			result_t Upload(const deviceLocalBuffer& buffer_dst, const void* pData_src, VkDeviceSize size, VkDeviceSize offset_dst = 0) {
+				return Upload(buffer_dst, size, offset_dst, [&](void* pData_dst) { memcpy(pData_dst, pData_src, size_t(size)); });
+			}
+		};
+		stagingPool(VkDeviceSize chunkSize = 4 << 20, VkDeviceSize keepBytes = 64 << 20) :chunkSize(chunkSize), keepBytes(keepBytes) {}
+		stagingPool(stagingPool&&) = delete;
+		//Getter
+		VkDeviceSize ChunkSize() const { return chunkSize; }
+		//Non-const Function
+		bool Pending() {
+			std::lock_guard lock(mutex);
+			return queued.size();
+		}
+		//Records every copy queued so far, their chunks are recycled once retireValue has completed.
+		//Returns the recorded copies, e.g. for the barriers that hand the buffers to another queue family
+		std::vector<copy> CmdCopy(VkCommandBuffer commandBuffer, uint64_t retireValue) {
+			std::vector<std::pair<copy, chunk*>> copies;
+			{
+				std::lock_guard lock(mutex);
+				copies.swap(queued);
+				for (auto& [i, owner] : copies)
+					owner->unrecorded--,
+					owner->retireValue = retireValue;
+			}
+			std::vector<copy> recorded;
+			recorded.reserve(copies.size());
+			for (auto& [i, owner] : copies) {
+				vkCmdCopyBuffer(commandBuffer, i.buffer_src, i.buffer_dst, 1, &i.region);
+				recorded.push_back(i);
+			}
+			return recorded;
+		}
+		//Chunks no writer holds and whose copies are done at completedValue are reused.
+		//Free chunks past keepBytes are released
+		void Recycle(uint64_t completedValue) {
+			std::lock_guard lock(mutex);
+			VkDeviceSize kept = 0;
+			for (auto& i : chunks) {
+				if (!i || i->held || i->unrecorded || i->head && i->retireValue > completedValue)
+					continue;
+				i->head = 0;
+				if ((kept += i->size) > keepBytes)
+					i.reset();
+			}
+		}
+	};
+
+	//Copies data into device-local buffers on the transfer queue without waiting for the copies.
+	//Data is staged in a host-visible ring, every Submit(...) signals the next value of a timeline semaphore,
+	//and a batch's ring space and command buffer are reused once the semaphore has passed its value.
+	//The host only blocks when the ring or all command buffers are taken by copies still running.
+	class asyncTransfer {
+		static constexpr uint32_t batchCount = 8;
+		static constexpr VkDeviceSize ringAlignment = 16;
+		struct batch {
+			uint64_t value = 0;
+			VkDeviceSize end = 0;//Ring head after the batch
+			VkDeviceSize bytes = 0;//Ring space the batch holds, wrap-around padding included
+		};
+		struct release {
+			uint64_t value;
+			VkBufferMemoryBarrier barrier;
+		};
+		bufferMemory ring;
+		VkDeviceSize capacity = 0;
+		VkDeviceSize head = 0;
+		VkDeviceSize tail = 0;
+		VkDeviceSize used = 0;
+		commandPool commandPool_transfer;
+		commandBuffer commandBuffers[batchCount];
+		timelineSemaphore timeline;
+		uint64_t submitted = 0;//Value signaled by the last submission
+		uint64_t joined = 0;//The graphics queue waits for values up to this
+		batch recording;
+		bool isRecording = false;
+		std::vector<batch> batchesInFlight;
+		std::vector<release> releases;//Buffers the transfer family gave up, not yet acquired by the graphics family
+		//--------------------
+		const commandBuffer& CurrentCommandBuffer() const {
+			return commandBuffers[(submitted + 1) % batchCount];
+		}
+		void Reclaim() {
+			uint64_t value = 0;
+			timeline.GetValue(value);
+			size_t count = 0;
+			for (; count < batchesInFlight.size() && batchesInFlight[count].value <= value; count++)
+				tail = batchesInFlight[count].end,
+				used -= batchesInFlight[count].bytes;
+			batchesInFlight.erase(batchesInFlight.begin(), batchesInFlight.begin() + count);
+			if (!used)
+				head = tail = 0;
+		}
+		bool Fit(VkDeviceSize size, VkDeviceSize& offset) {
+			VkDeviceSize padding = 0;
+			if (head >= tail) {
+				if (used && head == tail)
+					return false;
+				if (capacity - head < size)
+					if (tail >= size)
+						padding = capacity - head,
+						head = 0;
+					else
+						return false;
+			}
+			else if (tail - head < size)
+				return false;
+			offset = head;
+			head += size;
+			used += padding + size;
+			recording.bytes += padding + size;
+			return true;
+		}
+		result_t Reserve(VkDeviceSize size, VkDeviceSize& offset) {
+			size = (size + ringAlignment - 1) / ringAlignment * ringAlignment;
+			if (size > capacity) {
+				uint64_t value;
+				if (VkResult result = Submit(value))
+					return result;
+				if (VkResult result = WaitAll())
+					return result;
+				if (VkResult result = Expand(std::bit_ceil(size)))
+					return result;
+			}
+			while (true) {
+				Reclaim();
+				if (Fit(size, offset))
+					return VK_SUCCESS;
+				//Full, the copies recorded so far have to go out before their space can come back
+				if (isRecording) {
+					uint64_t value;
+					if (VkResult result = Submit(value))
+						return result;
+				}
+				if (VkResult result = timeline.Wait(batchesInFlight.front().value))
+					return result;
+			}
+		}
+		result_t BeginRecording() {
+			if (isRecording)
+				return VK_SUCCESS;
+			//The batch that used this command buffer before is batchCount submissions back
+			if (submitted + 1 > batchCount)
+				if (VkResult result = timeline.Wait(submitted + 1 - batchCount))
+					return result;
+			if (VkResult result = CurrentCommandBuffer().Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT))
+				return result;
+			isRecording = true;
+			return VK_SUCCESS;
+		}
+		void Release(VkBuffer buffer_dst, const VkBufferCopy& region) {
+			if (DedicatedQueue())
+				releases.push_back({ submitted + 1, {
+					.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+					.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+					.srcQueueFamilyIndex = graphicsBase::Base().QueueFamilyIndex_Transfer(),
+					.dstQueueFamilyIndex = graphicsBase::Base().QueueFamilyIndex_Graphics(),
+					.buffer = buffer_dst,
+					.offset = region.dstOffset,
+					.size = region.size } });
+		}
+		result_t Expand(VkDeviceSize size) {
+			ring.~bufferMemory();
+			VkBufferCreateInfo bufferCreateInfo = {
+				.size = size,
+				.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+			};
+			if (VkResult result = ring.Create(bufferCreateInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+				return result;
+			capacity = size;
+			head = tail = used = 0;
+			return VK_SUCCESS;
+		}
+	public:
+		asyncTransfer(VkDeviceSize ringSize = 64 << 20) {
+			commandPool_transfer.Create(graphicsBase::Base().QueueFamilyIndex_Transfer(), VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+			commandPool_transfer.AllocateBuffers(commandBuffers);
+			Expand(ringSize);
+		}
+		asyncTransfer(asyncTransfer&&) = delete;
+		~asyncTransfer() {
+			if (submitted)
+				timeline.Wait(submitted);
+		}
+		//Getter
+		const timelineSemaphore& Semaphore() const { return timeline; }
+		VkDeviceSize RingSize() const { return capacity; }
+		//Ownership of the destination buffers moves from the transfer family to the graphics family
+		bool DedicatedQueue() const {
+			return graphicsBase::Base().QueueFamilyIndex_Transfer() != graphicsBase::Base().QueueFamilyIndex_Graphics();
+		}
+		//Const Function
+		bool Finished(uint64_t value) const {
+			return Completed() >= value;
+		}
+		result_t Wait(uint64_t value) const {
+			return timeline.Wait(value);
+		}
+		//Value the semaphore has reached, e.g. for stagingPool::Recycle(...)
+		uint64_t Completed() const {
+			uint64_t value = 0;
+			timeline.GetValue(value);
+			return value;
+		}
+		//Non-const Function
+		//Host-visible destinations are written right away and need no copy
+		result_t Upload(const deviceLocalBuffer& buffer_dst, const void* pData_src, VkDeviceSize size, VkDeviceSize offset_dst = 0) {
+			if (!size)
+				return VK_SUCCESS;
+			if (buffer_dst.MemoryProperties() & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+				buffer_dst.TransferData(pData_src, size, offset_dst);
+				return VK_SUCCESS;
+			}
+			VkDeviceSize offset_src;
+			if (VkResult result = Reserve(size, offset_src))
+				return result;
+			if (VkResult result = ring.BufferData(pData_src, size, offset_src))
+				return result;
+			if (VkResult result = BeginRecording())
+				return result;
+			VkBufferCopy region = { offset_src, offset_dst, size };
+			vkCmdCopyBuffer(CurrentCommandBuffer(), ring.Buffer(), buffer_dst, 1, &region);
+			Release(buffer_dst, region);
+			return VK_SUCCESS;
+		}
+		//Records the copies worker threads have queued in the pool, they go out with the next Submit(...)
+		result_t Record(stagingPool& pool) {
+			if (!pool.Pending())
+				return VK_SUCCESS;
+			if (VkResult result = BeginRecording())
+				return result;
+			for (auto& i : pool.CmdCopy(CurrentCommandBuffer(), submitted + 1))
+				Release(i.buffer_dst, i.region);
+			return VK_SUCCESS;
+		}
+		//Outputs the value the semaphore reaches once every copy uploaded so far is done
+		result_t Submit(uint64_t& value) {
+			value = submitted;
+			if (!isRecording)
+				return VK_SUCCESS;
+			auto& commandBuffer = CurrentCommandBuffer();
+			std::vector<VkBufferMemoryBarrier> barriers;
+			for (auto& i : releases)
+				if (i.value == submitted + 1)
+					barriers.push_back(i.barrier);
+			if (barriers.size())
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+					0, nullptr, uint32_t(barriers.size()), barriers.data(), 0, nullptr);
+			isRecording = false;
+			if (VkResult result = commandBuffer.End())
+				return result;
+			uint64_t signalValue = submitted + 1;
+			VkTimelineSemaphoreSubmitInfo timelineSemaphoreSubmitInfo = {
+				.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+				.signalSemaphoreValueCount = 1,
+				.pSignalSemaphoreValues = &signalValue
+			};
+			VkSubmitInfo submitInfo = {
+				.pNext = &timelineSemaphoreSubmitInfo,
+				.commandBufferCount = 1,
+				.pCommandBuffers = commandBuffer.Address(),
+				.signalSemaphoreCount = 1,
+				.pSignalSemaphores = timeline.Address()
+			};
+			if (VkResult result = graphicsBase::Base().SubmitCommandBuffer_Transfer(submitInfo))
+				return result;
+			recording.value = value = submitted = signalValue;
+			recording.end = head;
+			batchesInFlight.push_back(recording);
+			recording = {};
+			return VK_SUCCESS;
+		}
+		//Work submitted to the graphics queue after this call sees the copies up to value, the host doesn't wait.
+		//Call once value is Finished(...) and the GPU doesn't stall either
+		result_t Join_Graphics(uint64_t value) {
+			if (value <= joined)
+				return VK_SUCCESS;
+			static constexpr VkPipelineStageFlags waitDstStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			VkTimelineSemaphoreSubmitInfo timelineSemaphoreSubmitInfo = {
+				.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+				.waitSemaphoreValueCount = 1,
+				.pWaitSemaphoreValues = &value
+			};
+			VkSubmitInfo submitInfo = {
+				.pNext = &timelineSemaphoreSubmitInfo,
+				.waitSemaphoreCount = 1,
+				.pWaitSemaphores = timeline.Address(),
+				.pWaitDstStageMask = &waitDstStage
+			};
+			if (VkResult result = graphicsBase::Base().SubmitCommandBuffer_Graphics(submitInfo))
+				return result;
+			joined = value;
+			return VK_SUCCESS;
+		}
+		//Records the graphics family's half of the ownership transfer for copies up to value, outside any render pass.
+		//Nothing to do when the copies ran on the graphics queue
+		void CmdAcquire(VkCommandBuffer commandBuffer_graphics, uint64_t value) {
+			std::vector<VkBufferMemoryBarrier> barriers;
+			std::erase_if(releases, [&](const release& i) {
+				if (i.value > value)
+					return false;
+				barriers.push_back(i.barrier);
+				barriers.back().srcAccessMask = 0;
+				barriers.back().dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+				return true;
+			});
+			if (barriers.size())
+				vkCmdPipelineBarrier(commandBuffer_graphics, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+					0, nullptr, uint32_t(barriers.size()), barriers.data(), 0, nullptr);
+		}
+		result_t WaitAll() {
+			if (submitted)
+				if (VkResult result = timeline.Wait(submitted))
+					return result;
+			Reclaim();
+			return VK_SUCCESS;
+		}
+		//Static Function
+		//Needs Vulkan 1.2's timeline semaphores, without them keep using deviceLocalBuffer::TransferData(...)
+		static bool Available() {
+			return graphicsBase::Base().PhysicalDeviceVulkan12Features().timelineSemaphore;
+		}
+	};
+
 	//Attachment
     class attachment {
     protected:
@@ -573,10 +998,8 @@ namespace vulkan {
         void Destroy(VkDevice device){
             if(mimageView)
                 mimageView.~imageView();
-            if(mimageMemory.Image())
-                vkDestroyImage(device, mimageMemory.Image(), nullptr);
-            if(mimageMemory.Memory())
-                vkFreeMemory(device, mimageMemory.Memory(), nullptr);
+            //The memory may be part of an allocator block, let imageMemory give it back
+            mimageMemory.~imageMemory();
         }
     };
 
@@ -1463,6 +1886,115 @@ namespace vulkan {
 		}
 	};
 
+	//Descriptor
+	//Hands out sets of one shape (at most setSizes descriptors each) from a chain of pools.
+	//A full chain gets a new pool twice the size of the last, freed sets go back to the pool they came from.
+	class descriptorAllocator {
+		std::vector<VkDescriptorPoolSize> setSizes;
+		std::vector<descriptorPool> pools;
+		std::vector<uint32_t> freeSetCounts;
+		std::unordered_map<VkDescriptorSet, uint32_t> owners;
+		uint32_t setCountOfFirstPool = 64;
+		uint32_t setCountOfNextPool = 64;
+		//--------------------
+		result_t AddPool() {
+			std::vector<VkDescriptorPoolSize> poolSizes = setSizes;
+			for (auto& i : poolSizes)
+				i.descriptorCount *= setCountOfNextPool;
+			descriptorPool& pool = pools.emplace_back();
+			if (VkResult result = pool.Create(setCountOfNextPool, { poolSizes.data(), poolSizes.size() }, VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT)) {
+				pools.pop_back();
+				return result;
+			}
+			freeSetCounts.push_back(setCountOfNextPool);
+			setCountOfNextPool *= 2;
+			return VK_SUCCESS;
+		}
+	public:
+		descriptorAllocator() = default;
+		descriptorAllocator(arrayRef<const VkDescriptorPoolSize> setSizes, uint32_t setCountOfFirstPool = 64) {
+			Create(setSizes, setCountOfFirstPool);
+		}
+		descriptorAllocator(descriptorAllocator&&) = default;
+		//Getter
+		uint32_t PoolCount() const { return pools.size(); }
+		uint32_t SetCount() const { return owners.size(); }
+		//Non-const Function
+		void Create(arrayRef<const VkDescriptorPoolSize> setSizes, uint32_t setCountOfFirstPool = 64) {
+			this->setSizes.assign(setSizes.begin(), setSizes.end());
+			this->setCountOfFirstPool = setCountOfFirstPool;
+			Clear();
+		}
+		result_t Allocate(descriptorSet& set, VkDescriptorSetLayout setLayout) {
+			uint32_t index = 0;
+			while (index < pools.size() && !freeSetCounts[index])
+				index++;
+			if (index == pools.size())
+				if (VkResult result = AddPool())
+					return result;
+			if (VkResult result = pools[index].AllocateSets(set, setLayout))
+				return result;
+			freeSetCounts[index]--;
+			owners[set] = index;
+			return VK_SUCCESS;
+		}
+		void Free(descriptorSet& set) {
+			auto iterator = owners.find(set);
+			if (iterator == owners.end())
+				return;
+			pools[iterator->second].FreeSets(set);
+			freeSetCounts[iterator->second]++;
+			owners.erase(iterator);
+		}
+		//Frees every set at once by destroying the pools
+		void Clear() {
+			owners.clear();
+			freeSetCounts.clear();
+			pools.clear();
+			setCountOfNextPool = setCountOfFirstPool;
+		}
+	};
+	//Devices may only create maxSamplerAllocationCount samplers (as few as 4000), identical create infos share one
+	class samplerCache {
+		//Every member from flags to unnormalizedCoordinates, pNext chains are compared by pointer
+		struct key {
+			VkSamplerCreateInfo createInfo;
+			bool operator==(const key& other) const {
+				return createInfo.pNext == other.createInfo.pNext &&
+					!memcmp(&createInfo.flags, &other.createInfo.flags, Size());
+			}
+			static constexpr size_t Size() {
+				return offsetof(VkSamplerCreateInfo, unnormalizedCoordinates) + sizeof(VkBool32) - offsetof(VkSamplerCreateInfo, flags);
+			}
+		};
+		struct hash {
+			size_t operator()(const key& value) const {
+				size_t hash = 14695981039346656037ull;
+				auto pBytes = reinterpret_cast<const uint8_t*>(&value.createInfo.flags);
+				for (size_t i = 0; i < key::Size(); i++)
+					hash = (hash ^ pBytes[i]) * 1099511628211ull;
+				return hash;
+			}
+		};
+		std::unordered_map<key, sampler, hash> samplers;
+	public:
+		samplerCache() = default;
+		samplerCache(samplerCache&&) = default;
+		//Getter
+		uint32_t Count() const { return samplers.size(); }
+		//Non-const Function
+		VkSampler Get(VkSamplerCreateInfo createInfo) {
+			createInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+			auto [iterator, inserted] = samplers.try_emplace({ createInfo });
+			if (inserted)
+				iterator->second.Create(createInfo);
+			return iterator->second;
+		}
+		void Clear() {
+			samplers.clear();
+		}
+	};
+
 	//Query
 	class occlusionQueries {
 	protected:
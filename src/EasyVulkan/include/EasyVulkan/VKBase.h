@@ -63,15 +63,20 @@ namespace vulkan {
 		VkPhysicalDevice physicalDevice;
 		VkPhysicalDeviceProperties physicalDeviceProperties;
 		VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties;
+		VkPhysicalDeviceFeatures physicalDeviceFeatures = {};
+		VkPhysicalDeviceVulkan11Features physicalDeviceVulkan11Features = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES };
+		VkPhysicalDeviceVulkan12Features physicalDeviceVulkan12Features = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
 		std::vector<VkPhysicalDevice> availablePhysicalDevices;
 
 		VkDevice device;
 		uint32_t queueFamilyIndex_graphics = VK_QUEUE_FAMILY_IGNORED;
 		uint32_t queueFamilyIndex_presentation = VK_QUEUE_FAMILY_IGNORED;
 		uint32_t queueFamilyIndex_compute = VK_QUEUE_FAMILY_IGNORED;
+		uint32_t queueFamilyIndex_transfer = VK_QUEUE_FAMILY_IGNORED;
 		VkQueue queue_graphics;
 		VkQueue queue_presentation;
 		VkQueue queue_compute;
+		VkQueue queue_transfer;
 
 		VkSurfaceKHR surface;
 		std::vector <VkSurfaceFormatKHR> availableSurfaceFormats;
@@ -176,6 +181,18 @@ namespace vulkan {
 			queueFamilyIndex_compute = ic;
 			return VK_SUCCESS;
 		}
+		void GetTransferQueueFamilyIndex() {
+			uint32_t queueFamilyCount = 0;
+			vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+			std::vector<VkQueueFamilyProperties> queueFamilyPropertieses(queueFamilyCount);
+			vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilyPropertieses.data());
+			queueFamilyIndex_transfer = queueFamilyIndex_graphics;
+			for (uint32_t i = 0; i < queueFamilyCount; i++)
+				if ((queueFamilyPropertieses[i].queueFlags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == VK_QUEUE_TRANSFER_BIT) {
+					queueFamilyIndex_transfer = i;
+					break;
+				}
+		}
 		result_t CreateSwapchain_Internal() {
 			if (VkResult result = vkCreateSwapchainKHR(device, &swapchainCreateInfo, nullptr, &swapchain)) {
 				outStream << std::format("[ graphicsBase ] ERROR\nFailed to create a swapchain!\nError code: {}\n", int32_t(result));
@@ -265,6 +282,16 @@ namespace vulkan {
 		const VkPhysicalDeviceMemoryProperties& PhysicalDeviceMemoryProperties() const {
 			return physicalDeviceMemoryProperties;
 		}
+		//Features enabled on the logical device, Vulkan 1.1/1.2 ones stay zeroed below 1.2
+		const VkPhysicalDeviceFeatures& PhysicalDeviceFeatures() const {
+			return physicalDeviceFeatures;
+		}
+		const VkPhysicalDeviceVulkan11Features& PhysicalDeviceVulkan11Features() const {
+			return physicalDeviceVulkan11Features;
+		}
+		const VkPhysicalDeviceVulkan12Features& PhysicalDeviceVulkan12Features() const {
+			return physicalDeviceVulkan12Features;
+		}
 		VkPhysicalDevice AvailablePhysicalDevice(uint32_t index) const {
 			return availablePhysicalDevices[index];
 		}
@@ -296,6 +323,13 @@ namespace vulkan {
 		VkQueue Queue_Compute() const {
 			return queue_compute;
 		}
+		//A transfer-only family (DMA engine) if the device has one, otherwise the graphics family and queue
+		uint32_t QueueFamilyIndex_Transfer() const {
+			return queueFamilyIndex_transfer;
+		}
+		VkQueue Queue_Transfer() const {
+			return queue_transfer;
+		}
 
 		VkSurfaceKHR Surface() const {
 			return surface;
@@ -528,9 +562,34 @@ namespace vulkan {
 			physicalDevice = availablePhysicalDevices[deviceIndex];
 			return VK_SUCCESS;
 		}
+		//The version both the instance and the physical device support
+		uint32_t DeviceApiVersion() const {
+			VkPhysicalDeviceProperties properties;
+			vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+			return std::min(apiVersion, properties.apiVersion);
+		}
+		void GetPhysicalDeviceFeatures() {
+			physicalDeviceVulkan11Features = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES };
+			physicalDeviceVulkan12Features = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+			if (DeviceApiVersion() >= VK_API_VERSION_1_2) {
+				physicalDeviceVulkan11Features.pNext = &physicalDeviceVulkan12Features;
+				VkPhysicalDeviceFeatures2 physicalDeviceFeatures2 = {
+					.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+					.pNext = &physicalDeviceVulkan11Features
+				};
+				vkGetPhysicalDeviceFeatures2(physicalDevice, &physicalDeviceFeatures2);
+				physicalDeviceFeatures = physicalDeviceFeatures2.features;
+			}
+			else
+				vkGetPhysicalDeviceFeatures(physicalDevice, &physicalDeviceFeatures);
+		}
 		result_t CreateDevice(VkDeviceCreateFlags flags = 0) {
 			float queuePriority = 1.f;
-			VkDeviceQueueCreateInfo queueCreateInfos[3] = {
+			VkDeviceQueueCreateInfo queueCreateInfos[4] = {
+				{
+					.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+					.queueCount = 1,
+					.pQueuePriorities = &queuePriority },
 				{
 					.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
 					.queueCount = 1,
@@ -553,10 +612,13 @@ namespace vulkan {
 				queueFamilyIndex_compute != queueFamilyIndex_graphics &&
 				queueFamilyIndex_compute != queueFamilyIndex_presentation)
 				queueCreateInfos[queueCreateInfoCount++].queueFamilyIndex = queueFamilyIndex_compute;
-			VkPhysicalDeviceFeatures physicalDeviceFeatures;
-			vkGetPhysicalDeviceFeatures(physicalDevice, &physicalDeviceFeatures);
-            physicalDeviceFeatures.fillModeNonSolid = VK_TRUE;
-            VkDeviceCreateInfo deviceCreateInfo = {
+			GetTransferQueueFamilyIndex();
+			if (queueFamilyIndex_transfer != queueFamilyIndex_graphics &&
+				queueFamilyIndex_transfer != queueFamilyIndex_presentation)
+				queueCreateInfos[queueCreateInfoCount++].queueFamilyIndex = queueFamilyIndex_transfer;
+			GetPhysicalDeviceFeatures();
+			physicalDeviceFeatures.fillModeNonSolid = VK_TRUE;
+			VkDeviceCreateInfo deviceCreateInfo = {
 				.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
 				.flags = flags,
 				.queueCreateInfoCount = queueCreateInfoCount,
@@ -565,6 +627,15 @@ namespace vulkan {
 				.ppEnabledExtensionNames = deviceExtensions.data(),
 				.pEnabledFeatures = &physicalDeviceFeatures
 			};
+			//From 1.2 on, every supported feature (descriptor indexing, timeline semaphores...) is enabled through the pNext chain
+			VkPhysicalDeviceFeatures2 physicalDeviceFeatures2 = {
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+				.pNext = &physicalDeviceVulkan11Features,
+				.features = physicalDeviceFeatures
+			};
+			if (DeviceApiVersion() >= VK_API_VERSION_1_2)
+				deviceCreateInfo.pNext = &physicalDeviceFeatures2,
+				deviceCreateInfo.pEnabledFeatures = nullptr;
 			if (VkResult result = vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &device)) {
 				outStream << std::format("[ graphicsBase ] ERROR\nFailed to create a vulkan logical device!\nError code: {}\n", int32_t(result));
 				return result;
@@ -575,6 +646,8 @@ namespace vulkan {
 				vkGetDeviceQueue(device, queueFamilyIndex_presentation, 0, &queue_presentation);
 			if (queueFamilyIndex_compute != VK_QUEUE_FAMILY_IGNORED)
 				vkGetDeviceQueue(device, queueFamilyIndex_compute, 0, &queue_compute);
+			if (queueFamilyIndex_transfer != VK_QUEUE_FAMILY_IGNORED)
+				vkGetDeviceQueue(device, queueFamilyIndex_transfer, 0, &queue_transfer);
 			vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
 			vkGetPhysicalDeviceMemoryProperties(physicalDevice, &physicalDeviceMemoryProperties);
 			outStream << std::format("Renderer: {}\n", physicalDeviceProperties.deviceName);
@@ -873,6 +946,13 @@ namespace vulkan {
 			};
 			return SubmitCommandBuffer_Compute(submitInfo, fence);
 		}
+		result_t SubmitCommandBuffer_Transfer(VkSubmitInfo& submitInfo, VkFence fence = VK_NULL_HANDLE) const {
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			VkResult result = vkQueueSubmit(queue_transfer, 1, &submitInfo, fence);
+			if (result)
+				outStream << std::format("[ graphicsBase ] ERROR\nFailed to submit the command buffer!\nError code: {}\n", int32_t(result));
+			return result;
+		}
 		result_t SubmitCommandBuffer_Presentation(VkCommandBuffer commandBuffer,
 			VkSemaphore semaphore_renderingIsOver = VK_NULL_HANDLE, VkSemaphore semaphore_ownershipIsTransfered = VK_NULL_HANDLE, VkFence fence = VK_NULL_HANDLE) const {
 			static constexpr VkPipelineStageFlags waitDstStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
@@ -1095,16 +1175,296 @@ namespace vulkan {
 		}
 	};
 
+	//Hands out device memory from large blocks, so a scene with thousands of resources doesn't run into maxMemoryAllocationCount.
+	//Requests are sorted into size classes, each class has its own blocks per memory type. Anything bigger than a class allows,
+	//and lazily allocated memory, gets a dedicated allocation.
+	class memoryAllocator {
+	public:
+		enum strategy_t : uint8_t {
+			strategy_buddy,		//Power of two nodes, a freed node merges with its buddy
+			strategy_linear		//Bump allocation, a block is rewound once everything in it has been freed
+		};
+		enum resource_t : uint8_t {
+			resource_linear,	//Buffers and linear images
+			resource_optimal	//Optimal tiling images, kept in separate blocks so bufferImageGranularity never applies
+		};
+		struct allocation {
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize offset = 0;
+			VkDeviceSize size = 0;
+			VkDeviceSize memorySize = 0;	//Size of the whole VkDeviceMemory
+			void* pMapped = nullptr;		//Persistent mapping of the block, null for dedicated allocations
+			uint32_t block = UINT32_MAX;	//UINT32_MAX for dedicated allocations
+			uint32_t generation = 0;
+			uint8_t order = 0;
+		};
+		struct statistics {
+			uint32_t blockCount;
+			uint32_t dedicatedCount;
+			uint32_t allocationCount;
+			VkDeviceSize reservedBytes;		//Blocks and dedicated allocations
+			VkDeviceSize usedBytes;			//Requested by live allocations
+			VkDeviceSize largestFreeRange;
+			float utilisation;				//usedBytes / reservedBytes
+			float fragmentation;			//1 - largestFreeRange / free bytes in blocks
+		};
+		static constexpr VkDeviceSize minNodeSize = 256;
+		static constexpr VkDeviceSize blockSizes[] = { 4ull << 20, 32ull << 20, 128ull << 20 };
+		static constexpr VkDeviceSize maxAllocationsPerBlock = 8;	//A request goes to the smallest class at least this many times its size
+	private:
+		struct block {
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			void* pMapped = nullptr;
+			uint32_t memoryTypeIndex = 0;
+			resource_t resource = resource_linear;
+			strategy_t strategy = strategy_buddy;
+			uint32_t allocationCount = 0;
+			VkDeviceSize usedBytes = 0;
+			VkDeviceSize reservedBytes = 0;				//Nodes handed out, or the top of a linear block
+			std::vector<std::set<VkDeviceSize>> freeNodes;	//Buddy, free offsets per order
+		};
+		std::vector<block> blocks;
+		uint32_t dedicatedCount = 0;
+		VkDeviceSize dedicatedBytes = 0;
+		uint32_t generation = 0;
+		mutable std::mutex mutex;
+		//--------------------
+		memoryAllocator() {
+			graphicsBase::Base().AddCallback_DestroyDevice([] { Default().ReleaseBlocks(); });
+		}
+		memoryAllocator(memoryAllocator&&) = delete;
+		~memoryAllocator() = default;
+		//Returns 0 when the request is too big for any class
+		static VkDeviceSize BlockSize(uint32_t heapIndex, VkDeviceSize size) {
+			VkDeviceSize heapSize = graphicsBase::Base().PhysicalDeviceMemoryProperties().memoryHeaps[heapIndex].size;
+			for (VkDeviceSize blockSize : blockSizes) {
+				//Small heaps, e.g. the 256 MB host visible VRAM window, get smaller blocks
+				blockSize = std::min(blockSize, std::bit_floor(heapSize / 8));
+				if (size * maxAllocationsPerBlock <= blockSize)
+					return blockSize;
+			}
+			return 0;
+		}
+		static bool Suballocate(block& block, const VkMemoryRequirements& requirements, allocation& result) {
+			if (block.strategy == strategy_linear) {
+				VkDeviceSize offset = (block.reservedBytes + requirements.alignment - 1) / requirements.alignment * requirements.alignment;
+				if (offset + requirements.size > block.size)
+					return false;
+				block.reservedBytes = offset + requirements.size;
+				result.offset = offset;
+				return true;
+			}
+			VkDeviceSize nodeSize = std::max({ std::bit_ceil(requirements.size), std::bit_ceil(requirements.alignment), minNodeSize });
+			uint32_t order = std::countr_zero(nodeSize / minNodeSize);
+			uint32_t available = order;
+			while (available < block.freeNodes.size() && block.freeNodes[available].empty())
+				available++;
+			if (available >= block.freeNodes.size())
+				return false;
+			VkDeviceSize offset = *block.freeNodes[available].begin();
+			block.freeNodes[available].erase(block.freeNodes[available].begin());
+			//Split down to the requested order, the upper halves stay free
+			while (available > order)
+				available--,
+				block.freeNodes[available].insert(offset + (minNodeSize << available));
+			block.reservedBytes += nodeSize;
+			result.offset = offset;
+			result.order = uint8_t(order);
+			return true;
+		}
+		static void Deallocate(block& block, const allocation& allocation) {
+			if (block.strategy == strategy_linear) {
+				if (!block.allocationCount)
+					block.reservedBytes = 0;
+				return;
+			}
+			VkDeviceSize offset = allocation.offset;
+			uint32_t order = allocation.order;
+			block.reservedBytes -= minNodeSize << order;
+			while (order + 1 < block.freeNodes.size()) {
+				VkDeviceSize buddy = offset ^ (minNodeSize << order);
+				auto iterator = block.freeNodes[order].find(buddy);
+				if (iterator == block.freeNodes[order].end())
+					break;
+				block.freeNodes[order].erase(iterator);
+				offset = std::min(offset, buddy);
+				order++;
+			}
+			block.freeNodes[order].insert(offset);
+		}
+		static VkDeviceSize LargestFreeRange(const block& block) {
+			if (block.strategy == strategy_linear)
+				return block.size - block.reservedBytes;
+			for (size_t order = block.freeNodes.size(); order--;)
+				if (!block.freeNodes[order].empty())
+					return minNodeSize << order;
+			return 0;
+		}
+		VkResult CreateBlock(uint32_t memoryTypeIndex, VkDeviceSize size, resource_t resource, strategy_t strategy, uint32_t& index) {
+			VkMemoryAllocateInfo allocateInfo = {
+				.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+				.allocationSize = size,
+				.memoryTypeIndex = memoryTypeIndex
+			};
+			VkDeviceMemory memory;
+			if (VkResult result = vkAllocateMemory(graphicsBase::Base().Device(), &allocateInfo, nullptr, &memory))
+				return result;
+			void* pMapped = nullptr;
+			if (graphicsBase::Base().PhysicalDeviceMemoryProperties().memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+				if (VkResult result = vkMapMemory(graphicsBase::Base().Device(), memory, 0, VK_WHOLE_SIZE, 0, &pMapped)) {
+					vkFreeMemory(graphicsBase::Base().Device(), memory, nullptr);
+					return result;
+				}
+			index = 0;
+			while (index < blocks.size() && blocks[index].memory)
+				index++;
+			if (index == blocks.size())
+				blocks.emplace_back();
+			block& block = blocks[index];
+			block = { memory, size, pMapped, memoryTypeIndex, resource, strategy };
+			if (strategy == strategy_buddy)
+				block.freeNodes.resize(std::countr_zero(size / minNodeSize) + 1),
+				block.freeNodes.back().insert(0);
+			return VK_SUCCESS;
+		}
+		void ReleaseBlock(block& block) {
+			//Unmapped implicitly
+			vkFreeMemory(graphicsBase::Base().Device(), block.memory, nullptr);
+			block = {};
+		}
+		VkResult AllocateDedicated(uint32_t memoryTypeIndex, VkDeviceSize size, allocation& result) {
+			VkMemoryAllocateInfo allocateInfo = {
+				.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+				.allocationSize = size,
+				.memoryTypeIndex = memoryTypeIndex
+			};
+			if (VkResult result_allocate = vkAllocateMemory(graphicsBase::Base().Device(), &allocateInfo, nullptr, &result.memory))
+				return result_allocate;
+			result.offset = 0;
+			result.size = result.memorySize = size;
+			result.pMapped = nullptr;
+			result.block = UINT32_MAX;
+			dedicatedCount++;
+			dedicatedBytes += size;
+			return VK_SUCCESS;
+		}
+		void ReleaseBlocks() {
+			std::lock_guard lock(mutex);
+			for (auto& i : blocks)
+				if (i.memory)
+					ReleaseBlock(i);
+			blocks.clear();
+			//Allocations still held by static objects become no-ops when freed
+			generation++;
+		}
+	public:
+		//Getter
+		statistics Statistics() const {
+			std::lock_guard lock(mutex);
+			statistics statistics = { .dedicatedCount = dedicatedCount, .allocationCount = dedicatedCount, .reservedBytes = dedicatedBytes, .usedBytes = dedicatedBytes };
+			VkDeviceSize freeBytes = 0;
+			for (auto& i : blocks) {
+				if (!i.memory)
+					continue;
+				statistics.blockCount++;
+				statistics.allocationCount += i.allocationCount;
+				statistics.reservedBytes += i.size;
+				statistics.usedBytes += i.usedBytes;
+				statistics.largestFreeRange = std::max(statistics.largestFreeRange, LargestFreeRange(i));
+				freeBytes += i.size - i.reservedBytes;
+			}
+			statistics.utilisation = statistics.reservedBytes ? float(statistics.usedBytes) / statistics.reservedBytes : 1.f;
+			statistics.fragmentation = freeBytes ? 1.f - float(statistics.largestFreeRange) / freeBytes : 0.f;
+			return statistics;
+		}
+		//Non-const Function
+		result_t Allocate(uint32_t memoryTypeIndex, const VkMemoryRequirements& requirements, resource_t resource, strategy_t strategy, allocation& result) {
+			auto& memoryType = graphicsBase::Base().PhysicalDeviceMemoryProperties().memoryTypes[memoryTypeIndex];
+			std::lock_guard lock(mutex);
+			result.generation = generation;
+			VkDeviceSize blockSize = BlockSize(memoryType.heapIndex, requirements.size);
+			auto Allocate_Dedicated = [&] {
+				if (VkResult result_allocate = AllocateDedicated(memoryTypeIndex, requirements.size, result)) {
+					outStream << std::format("[ memoryAllocator ] ERROR\nFailed to allocate memory!\nError code: {}\n", int32_t(result_allocate));
+					return result_allocate;
+				}
+				return VK_SUCCESS;
+			};
+			if (!blockSize ||
+				memoryType.propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
+				return Allocate_Dedicated();
+			uint32_t index = 0;
+			for (; index < blocks.size(); index++) {
+				block& block = blocks[index];
+				if (block.memory &&
+					block.memoryTypeIndex == memoryTypeIndex && block.size == blockSize &&
+					block.resource == resource && block.strategy == strategy &&
+					Suballocate(block, requirements, result))
+					break;
+			}
+			if (index == blocks.size()) {
+				//Out of memory for a new block may still leave room for the request itself
+				if (CreateBlock(memoryTypeIndex, blockSize, resource, strategy, index))
+					return Allocate_Dedicated();
+				Suballocate(blocks[index], requirements, result);
+			}
+			block& block = blocks[index];
+			block.allocationCount++;
+			block.usedBytes += requirements.size;
+			result.memory = block.memory;
+			result.size = requirements.size;
+			result.memorySize = block.size;
+			result.pMapped = block.pMapped;
+			result.block = index;
+			return VK_SUCCESS;
+		}
+		void Free(allocation& allocation) {
+			if (!allocation.memory)
+				return;
+			std::lock_guard lock(mutex);
+			if (allocation.block == UINT32_MAX) {
+				vkFreeMemory(graphicsBase::Base().Device(), allocation.memory, nullptr);
+				dedicatedCount--;
+				dedicatedBytes -= allocation.size;
+			}
+			else if (allocation.generation == generation) {
+				block& block = blocks[allocation.block];
+				block.allocationCount--;
+				block.usedBytes -= allocation.size;
+				Deallocate(block, allocation);
+				//Keep one empty block per pool around, so recreating a resource doesn't allocate again
+				if (!block.allocationCount)
+					for (auto& i : blocks)
+						if (&i != &block && i.memory && !i.allocationCount &&
+							i.memoryTypeIndex == block.memoryTypeIndex && i.size == block.size &&
+							i.resource == block.resource && i.strategy == block.strategy) {
+							ReleaseBlock(block);
+							break;
+						}
+			}
+			allocation = {};
+		}
+		//Static Function
+		static memoryAllocator& Default() {
+			//Created on first use and never destroyed, the device callback that frees the blocks may run during static destruction
+			static memoryAllocator* pSingleton = new memoryAllocator;
+			return *pSingleton;
+		}
+	};
+
 	class deviceMemory {
 		VkDeviceMemory handle = VK_NULL_HANDLE;
 		VkDeviceSize allocationSize = 0;
 		VkMemoryPropertyFlags memoryProperties = 0;
+		memoryAllocator::allocation allocation;//Empty unless the memory came from memoryAllocator
 		//--------------------
 		VkDeviceSize AdjustNonCoherentMemoryRange(VkDeviceSize& size, VkDeviceSize& offset) const {
 			const VkDeviceSize& nonCoherentAtomSize = graphicsBase::Base().PhysicalDeviceProperties().limits.nonCoherentAtomSize;
+			VkDeviceSize memorySize = allocation.memory ? allocation.memorySize : allocationSize;
 			VkDeviceSize _offset = offset;
 			offset = offset / nonCoherentAtomSize * nonCoherentAtomSize;
-			size = std::min((size + _offset + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize, allocationSize) - offset;
+			size = std::min((size + _offset + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize, memorySize) - offset;
 			return _offset - offset;
 		}
 	protected:
@@ -1124,21 +1484,37 @@ namespace vulkan {
 			MoveHandle;
 			allocationSize = other.allocationSize;
 			memoryProperties = other.memoryProperties;
+			allocation = other.allocation;
 			other.allocationSize = 0;
 			other.memoryProperties = 0;
+			other.allocation = {};
+		}
+		~deviceMemory() {
+			if (allocation.memory)
+				memoryAllocator::Default().Free(allocation),
+				handle = VK_NULL_HANDLE;
+			else
+				DestroyHandleBy(vkFreeMemory);
+			allocationSize = 0;
+			memoryProperties = 0;
 		}
-		~deviceMemory() { DestroyHandleBy(vkFreeMemory); allocationSize = 0; memoryProperties = 0; }
 		//Getter
 		DefineHandleTypeOperator;
 		DefineAddressFunction;
 		VkDeviceSize AllocationSize() const { return allocationSize; }
 		VkMemoryPropertyFlags MemoryProperties() const { return memoryProperties; }
+		//Where the resource starts inside the VkDeviceMemory, non-zero for sub-allocations
+		VkDeviceSize MemoryOffset() const { return allocation.offset; }
 		//Const Function
 		result_t MapMemory(void*& pData, VkDeviceSize size, VkDeviceSize offset = 0) const {
-			VkDeviceSize inverseDeltaOffset;
+			offset += allocation.offset;
+			VkDeviceSize inverseDeltaOffset = 0;
 			if (!(memoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
 				inverseDeltaOffset = AdjustNonCoherentMemoryRange(size, offset);
-			if (VkResult result = vkMapMemory(graphicsBase::Base().Device(), handle, offset, size, 0, &pData)) {
+			//Blocks stay mapped for as long as they live
+			if (allocation.pMapped)
+				pData = static_cast<uint8_t*>(allocation.pMapped) + offset;
+			else if (VkResult result = vkMapMemory(graphicsBase::Base().Device(), handle, offset, size, 0, &pData)) {
 				outStream << std::format("[ deviceMemory ] ERROR\nFailed to map the memory!\nError code: {}\n", int32_t(result));
 				return result;
 			}
@@ -1158,6 +1534,7 @@ namespace vulkan {
 			return VK_SUCCESS;
 		}
 		result_t UnmapMemory(VkDeviceSize size, VkDeviceSize offset = 0) const {
+			offset += allocation.offset;
 			if (!(memoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
 				AdjustNonCoherentMemoryRange(size, offset);
 				VkMappedMemoryRange mappedMemoryRange = {
@@ -1171,7 +1548,8 @@ namespace vulkan {
 					return result;
 				}
 			}
-			vkUnmapMemory(graphicsBase::Base().Device(), handle);
+			if (!allocation.pMapped)
+				vkUnmapMemory(graphicsBase::Base().Device(), handle);
 			return VK_SUCCESS;
 		}
 		result_t BufferData(const void* pData_src, VkDeviceSize size, VkDeviceSize offset = 0) const {
@@ -1206,6 +1584,20 @@ namespace vulkan {
 			memoryProperties = graphicsBase::Base().PhysicalDeviceMemoryProperties().memoryTypes[allocateInfo.memoryTypeIndex].propertyFlags;
 			return VK_SUCCESS;
 		}
+		//Takes the memory from memoryAllocator instead of allocating it directly
+		result_t Allocate(uint32_t memoryTypeIndex, const VkMemoryRequirements& requirements,
+			memoryAllocator::resource_t resource, memoryAllocator::strategy_t strategy = memoryAllocator::strategy_buddy) {
+			if (memoryTypeIndex >= graphicsBase::Base().PhysicalDeviceMemoryProperties().memoryTypeCount) {
+				outStream << std::format("[ deviceMemory ] ERROR\nInvalid memory type index!\n");
+				return VK_RESULT_MAX_ENUM;
+			}
+			if (VkResult result = memoryAllocator::Default().Allocate(memoryTypeIndex, requirements, resource, strategy, allocation))
+				return result;
+			handle = allocation.memory;
+			allocationSize = requirements.size;
+			memoryProperties = graphicsBase::Base().PhysicalDeviceMemoryProperties().memoryTypes[memoryTypeIndex].propertyFlags;
+			return VK_SUCCESS;
+		}
 	};
 	class buffer {
 		VkBuffer handle = VK_NULL_HANDLE;
@@ -1220,12 +1612,16 @@ namespace vulkan {
 		DefineHandleTypeOperator;
 		DefineAddressFunction;
 		//Const Function
+		VkMemoryRequirements MemoryRequirements() const {
+			VkMemoryRequirements memoryRequirements;
+			vkGetBufferMemoryRequirements(graphicsBase::Base().Device(), handle, &memoryRequirements);
+			return memoryRequirements;
+		}
 		VkMemoryAllocateInfo MemoryAllocateInfo(VkMemoryPropertyFlags desiredMemoryProperties) const {
 			VkMemoryAllocateInfo memoryAllocateInfo = {
 				.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO
 			};
-			VkMemoryRequirements memoryRequirements;
-			vkGetBufferMemoryRequirements(graphicsBase::Base().Device(), handle, &memoryRequirements);
+			VkMemoryRequirements memoryRequirements = MemoryRequirements();
 			memoryAllocateInfo.allocationSize = memoryRequirements.size;
 			memoryAllocateInfo.memoryTypeIndex = UINT32_MAX;
 			auto& physicalDeviceMemoryProperties = graphicsBase::Base().PhysicalDeviceMemoryProperties();
@@ -1272,6 +1668,7 @@ namespace vulkan {
 		bool AreBound() const { return areBound; }
 		using deviceMemory::AllocationSize;
 		using deviceMemory::MemoryProperties;
+		using deviceMemory::MemoryOffset;
 		//Const Function
 		using deviceMemory::MapMemory;
 		using deviceMemory::UnmapMemory;
@@ -1281,23 +1678,23 @@ namespace vulkan {
 		result_t CreateBuffer(VkBufferCreateInfo& createInfo) {
 			return buffer::Create(createInfo);
 		}
-		result_t AllocateMemory(VkMemoryPropertyFlags desiredMemoryProperties) {
+		result_t AllocateMemory(VkMemoryPropertyFlags desiredMemoryProperties, memoryAllocator::strategy_t strategy = memoryAllocator::strategy_buddy) {
 			VkMemoryAllocateInfo allocateInfo = MemoryAllocateInfo(desiredMemoryProperties);
 			if (allocateInfo.memoryTypeIndex >= graphicsBase::Base().PhysicalDeviceMemoryProperties().memoryTypeCount)
 				return VK_RESULT_MAX_ENUM;
-			return Allocate(allocateInfo);
+			return Allocate(allocateInfo.memoryTypeIndex, MemoryRequirements(), memoryAllocator::resource_linear, strategy);
 		}
 		result_t BindMemory() {
-			if (VkResult result = buffer::BindMemory(Memory()))
+			if (VkResult result = buffer::BindMemory(Memory(), MemoryOffset()))
 				return result;
 			areBound = true;
 			return VK_SUCCESS;
 		}
-		result_t Create(VkBufferCreateInfo& createInfo, VkMemoryPropertyFlags desiredMemoryProperties) {
+		result_t Create(VkBufferCreateInfo& createInfo, VkMemoryPropertyFlags desiredMemoryProperties, memoryAllocator::strategy_t strategy = memoryAllocator::strategy_buddy) {
 			VkResult result;
 			false ||
 				(result = CreateBuffer(createInfo)) ||
-				(result = AllocateMemory(desiredMemoryProperties)) ||
+				(result = AllocateMemory(desiredMemoryProperties, strategy)) ||
 				(result = BindMemory());
 			return result;
 		}
@@ -1315,12 +1712,16 @@ namespace vulkan {
 		DefineHandleTypeOperator;
 		DefineAddressFunction;
 		//Const Function
+		VkMemoryRequirements MemoryRequirements() const {
+			VkMemoryRequirements memoryRequirements;
+			vkGetImageMemoryRequirements(graphicsBase::Base().Device(), handle, &memoryRequirements);
+			return memoryRequirements;
+		}
 		VkMemoryAllocateInfo MemoryAllocateInfo(VkMemoryPropertyFlags desiredMemoryProperties) const {
 			VkMemoryAllocateInfo memoryAllocateInfo = {
 				.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO
 			};
-			VkMemoryRequirements memoryRequirements;
-			vkGetImageMemoryRequirements(graphicsBase::Base().Device(), handle, &memoryRequirements);
+			VkMemoryRequirements memoryRequirements = MemoryRequirements();
 			memoryAllocateInfo.allocationSize = memoryRequirements.size;
 			auto GetMemoryTypeIndex = [](uint32_t memoryTypeBits, VkMemoryPropertyFlags desiredMemoryProperties) {
 				auto& physicalDeviceMemoryProperties = graphicsBase::Base().PhysicalDeviceMemoryProperties();
@@ -1352,6 +1753,7 @@ namespace vulkan {
 		}
 	};
 	class imageMemory :image, deviceMemory {
+		memoryAllocator::resource_t resource = memoryAllocator::resource_optimal;
 	public:
 		imageMemory() = default;
 		imageMemory(VkImageCreateInfo& createInfo, VkMemoryPropertyFlags desiredMemoryProperties) {
@@ -1359,6 +1761,7 @@ namespace vulkan {
 		}
 		imageMemory(imageMemory&& other) noexcept :
 			image(std::move(other)), deviceMemory(std::move(other)) {
+			resource = other.resource;
 			areBound = other.areBound;
 			other.areBound = false;
 		}
@@ -1371,18 +1774,20 @@ namespace vulkan {
 		bool AreBound() const { return areBound; }
 		using deviceMemory::AllocationSize;
 		using deviceMemory::MemoryProperties;
+		using deviceMemory::MemoryOffset;
 		//Non-const Function
 		result_t CreateImage(VkImageCreateInfo& createInfo) {
+			resource = createInfo.tiling == VK_IMAGE_TILING_LINEAR ? memoryAllocator::resource_linear : memoryAllocator::resource_optimal;
 			return image::Create(createInfo);
 		}
 		result_t AllocateMemory(VkMemoryPropertyFlags desiredMemoryProperties) {
 			VkMemoryAllocateInfo allocateInfo = MemoryAllocateInfo(desiredMemoryProperties);
 			if (allocateInfo.memoryTypeIndex >= graphicsBase::Base().PhysicalDeviceMemoryProperties().memoryTypeCount)
 				return VK_RESULT_MAX_ENUM;
-			return Allocate(allocateInfo);
+			return Allocate(allocateInfo.memoryTypeIndex, MemoryRequirements(), resource);
 		}
 		result_t BindMemory() {
-			if (VkResult result = image::BindMemory(Memory()))
+			if (VkResult result = image::BindMemory(Memory(), MemoryOffset()))
 				return result;
 			areBound = true;
 			return VK_SUCCESS;
@@ -0,0 +1,143 @@
+//
+// Created by clx on 26-10-19.
+//
+// Frame time of the OpenGL renderer in a hidden window, for a grid of copies of one generated mesh.
+// Every frame ends in glFinish so the time covers the GPU's work too. On a machine without a GPU
+// run it with LIBGL_ALWAYS_SOFTWARE=1 to get llvmpipe. Loads shaders from ./assets, run it from the
+// repository root. Sizes are object counts. --stats writes the renderer's counters for every frame
+// of every size, CSV or JSON by the extension. --depth-prepass and --front-to-back switch those on,
+// the overdraw they save shows in the summary line.
+//
+// usage: TR_EXE_BENCH_FRAME [--sizes objects,...] [--triangles N] [--frames N] [--width W] [--height H]
+//                           [--depth-prepass on] [--front-to-back on]
+//                           [--stats frames.csv|frames.json] [--filter name] [--repetitions N] [--json report.json]
+//
+
+#include "harness.h"
+#include "synthetic.h"
+#include "render/render_OpenGL.h"
+#include "render/statsRecorder.h"
+#include "scene/scene.h"
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <memory>
+
+int main(int argc, char** argv)
+{
+    Bench::Suite suite("frame", argc, argv, {100, 1000, 10000});
+    size_t triangles = 2000;
+    int frames = 30, width = 1280, height = 720;
+    std::string statsPath;
+    bool depthPrepass = false, frontToBack = false;
+    const auto& args = suite.args();
+    for (size_t i = 0; i + 1 < args.size(); ++i) {
+        if (args[i] == "--triangles") triangles = std::strtoull(args[++i].c_str(), nullptr, 10);
+        else if (args[i] == "--frames") frames = std::max(1, std::atoi(args[++i].c_str()));
+        else if (args[i] == "--width") width = std::max(1, std::atoi(args[++i].c_str()));
+        else if (args[i] == "--height") height = std::max(1, std::atoi(args[++i].c_str()));
+        else if (args[i] == "--stats") statsPath = args[++i];
+        else if (args[i] == "--depth-prepass") depthPrepass = args[++i] == "on";
+        else if (args[i] == "--front-to-back") frontToBack = args[++i] == "on";
+    }
+    std::unique_ptr<StatsRecorder> recorder;
+    if (!statsPath.empty()) {
+        recorder = std::make_unique<StatsRecorder>(statsPath);
+        if (!recorder->isOpen()) return 1;
+    }
+    uint64_t frameNumber = 0;
+
+    if (!glfwInit()) {
+        std::fprintf(stderr, "Failed to initialize GLFW\n");
+        return 1;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(width, height, "benchmark", nullptr, nullptr);
+    if (!window) {
+        std::fprintf(stderr, "Failed to create GLFW window\n");
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::fprintf(stderr, "Failed to initialize GLAD\n");
+        return 1;
+    }
+    glViewport(0, 0, width, height);
+    glEnable(GL_DEPTH_TEST);
+    std::printf("%s, %zu triangles per object, %dx%d\n",
+                reinterpret_cast<const char*>(glGetString(GL_RENDERER)), triangles, width, height);
+
+    // One shared mesh, as an instanced scene would have it
+    auto prototype = std::make_shared<Object>();
+    prototype->addShape(Synthetic::gridShape(triangles));
+    prototype->buildLODs();
+    prototype->buildMeshlets();
+
+    for (size_t objects : suite.sizes()) {
+        auto scene = std::make_shared<Scene>();
+        const auto side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(objects))));
+        for (size_t i = 0; i < objects; ++i) {
+            auto model = prototype->instance();
+            model->setModelMatrix(glm::vec3(static_cast<float>(i % side) * 1.5f, 0.0f, static_cast<float>(i / side) * 1.5f));
+            scene->addObject(model);
+        }
+        scene->updateTransforms();
+
+        // From above one corner, looking across the grid
+        const float extent = static_cast<float>(side) * 1.5f;
+        const glm::mat4 view = glm::lookAt(glm::vec3(-extent * 0.1f - 1.0f, extent * 0.4f + 1.0f, -extent * 0.1f - 1.0f),
+                                           glm::vec3(extent * 0.5f, 0.0f, extent * 0.5f), glm::vec3(0.0f, 1.0f, 0.0f));
+        const glm::mat4 proj = glm::perspective(glm::radians(45.0f), static_cast<float>(width) / static_cast<float>(height),
+                                                0.1f, extent * 3.0f + 10.0f);
+
+        // The first frame of a new renderer uploads geometry, measured apart from the steady state
+        std::shared_ptr<Render_OpenGL> render;
+        auto freshRender = [&] {
+            render.reset();
+            render = std::make_shared<Render_OpenGL>();
+            render->setDepthPrepass(depthPrepass);
+            render->setFrontToBack(frontToBack);
+            render->init();
+            render->setup(scene);
+        };
+        suite.run("first_frame", objects, objects, freshRender, [&] {
+            render->render(scene, view, proj);
+            glFinish();
+        });
+        if (!render) freshRender();
+        suite.run("frame", objects, size_t(frames) * objects, [&] {
+            for (int frame = 0; frame < frames; ++frame) {
+                render->render(scene, view, proj);
+                glFinish();
+                glfwSwapBuffers(window);
+            }
+        });
+        const CullingStats& stats = render->getCullingStats();
+        const MemoryStats& memory = render->getMemoryStats();
+        const RenderStats& work = render->getRenderStats();
+        std::printf("    %u draw calls, %u shapes drawn, %llu triangles, %u state changes (%u unsorted), %.2f overdraw, %.1f MB GPU memory\n",
+                    stats.drawCalls, stats.drawnShapes, static_cast<unsigned long long>(stats.drawnTriangles),
+                    work.sortedStateChanges, work.unsortedStateChanges, work.overdraw(), memory.total() / 1048576.0);
+
+        // Apart from the timed runs, a fresh renderer so the first frame's uploads show up
+        if (recorder) {
+            freshRender();
+            for (int frame = 0; frame < frames; ++frame) {
+                auto start = std::chrono::steady_clock::now();
+                render->render(scene, view, proj);
+                glFinish();
+                glfwSwapBuffers(window);
+                recorder->record(frameNumber++, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), *render);
+            }
+        }
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return suite.finish();
+}
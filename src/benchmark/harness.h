@@ -0,0 +1,138 @@
+//
+// Created by clx on 26-10-19.
+//
+// Timing loop, command line and JSON report shared by the benchmark suites.
+// Every case runs once untimed, then --repetitions timed runs; the report keeps min, median and mean
+// so a regression check can compare medians across commits.
+//
+// Common options: [--filter substring] [--repetitions N] [--sizes a,b,c] [--json report.json]
+//
+
+#ifndef TOY_RENDERER_BENCH_HARNESS_H
+#define TOY_RENDERER_BENCH_HARNESS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <nlohmann/json.hpp>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace Bench {
+
+struct Result {
+    std::string name;
+    size_t size;            // the swept parameter, triangles, objects, pixels...
+    size_t items;           // work units per run, for the throughput column
+    std::vector<double> ms; // one per timed repetition
+};
+
+class Suite {
+public:
+    Suite(std::string name, int argc, char** argv, std::vector<size_t> defaultSizes)
+        : mName(std::move(name)), mSizes(std::move(defaultSizes)) {
+        for (int i = 1; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+                mFilter = argv[++i];
+            } else if (std::strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc) {
+                mRepetitions = std::max(1, std::atoi(argv[++i]));
+            } else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+                mJsonPath = argv[++i];
+            } else if (std::strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+                mSizes.clear();
+                for (char* token = std::strtok(argv[++i], ","); token; token = std::strtok(nullptr, ","))
+                    mSizes.push_back(std::strtoull(token, nullptr, 10));
+            } else {
+                mArgs.emplace_back(argv[i]);
+            }
+        }
+        std::printf("%-28s %10s %12s %12s %12s %14s\n", mName.c_str(), "size", "min ms", "median ms", "mean ms", "items/s");
+    }
+
+    const std::vector<size_t>& sizes() const { return mSizes; }
+    // Arguments the suite didn't consume, for suite specific options
+    const std::vector<std::string>& args() const { return mArgs; }
+    bool enabled(const std::string& name) const { return mFilter.empty() || name.find(mFilter) != std::string::npos; }
+
+    // setup runs before every repetition and isn't timed, body is
+    void run(const std::string& name, size_t size, size_t items,
+             const std::function<void()>& setup, const std::function<void()>& body) {
+        if (!enabled(name)) return;
+        Result result{name, size, items, {}};
+        for (int i = 0; i <= mRepetitions; ++i) {
+            if (setup) setup();
+            auto start = std::chrono::steady_clock::now();
+            body();
+            auto end = std::chrono::steady_clock::now();
+            if (i > 0) result.ms.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        print(result);
+        mResults.push_back(std::move(result));
+    }
+    void run(const std::string& name, size_t size, size_t items, const std::function<void()>& body) {
+        run(name, size, items, nullptr, body);
+    }
+
+    // Writes the report when --json was given, returns the exit code
+    int finish() const {
+        if (mJsonPath.empty()) return 0;
+        nlohmann::json report;
+        report["suite"] = mName;
+        report["repetitions"] = mRepetitions;
+#ifdef NDEBUG
+        report["optimized"] = true;
+#else
+        report["optimized"] = false;
+#endif
+        report["results"] = nlohmann::json::array();
+        for (const Result& result : mResults) {
+            auto stats = summarize(result);
+            report["results"].push_back({
+                {"name", result.name}, {"size", result.size}, {"items", result.items},
+                {"min_ms", stats.min}, {"median_ms", stats.median}, {"mean_ms", stats.mean}, {"runs_ms", result.ms}
+            });
+        }
+        std::ofstream file(mJsonPath);
+        if (!file.is_open()) {
+            std::fprintf(stderr, "Failed to write %s\n", mJsonPath.c_str());
+            return 1;
+        }
+        file << report.dump(2) << '\n';
+        return 0;
+    }
+
+private:
+    struct Stats {
+        double min, median, mean;
+    };
+    static Stats summarize(const Result& result) {
+        std::vector<double> sorted = result.ms;
+        std::sort(sorted.begin(), sorted.end());
+        double median = sorted.size() % 2 ? sorted[sorted.size() / 2]
+                                          : 0.5 * (sorted[sorted.size() / 2 - 1] + sorted[sorted.size() / 2]);
+        return {sorted.front(), median, std::accumulate(sorted.begin(), sorted.end(), 0.0) / static_cast<double>(sorted.size())};
+    }
+    static void print(const Result& result) {
+        auto stats = summarize(result);
+        double rate = result.items ? static_cast<double>(result.items) / (std::max(stats.median, 1e-6) * 1e-3) : 0.0;
+        std::printf("  %-26s %10zu %12.3f %12.3f %12.3f %14.0f\n",
+                    result.name.c_str(), result.size, stats.min, stats.median, stats.mean, rate);
+    }
+
+    std::string mName;
+    std::vector<size_t> mSizes;
+    std::vector<std::string> mArgs;
+    std::string mFilter;
+    std::string mJsonPath;
+    int mRepetitions = 5;
+    std::vector<Result> mResults;
+};
+
+}
+
+#endif //TOY_RENDERER_BENCH_HARNESS_H
@@ -0,0 +1,102 @@
+//
+// Created by clx on 26-10-19.
+//
+// CPU side of getting a scene on screen, each stage swept over generated inputs:
+// OBJ and PLY loading (with and without normals in the file, the difference is normal generation),
+// LOD and meshlet building, welding and packing vertices, texture decode, JSON scene loading and
+// per-frame culling. Model loads include building LODs and meshlets, those are also timed alone.
+// No window or GPU.
+//
+// usage: TR_EXE_BENCH_LOAD [--sizes triangles,...] [--filter name] [--repetitions N] [--json report.json]
+//
+
+#include "harness.h"
+#include "synthetic.h"
+#include "render/render.h"
+#include "scene/scene.h"
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Exposes the renderers' shared culling pass without a graphics API behind it
+class CullingProbe : public Render {
+public:
+    void add(const std::shared_ptr<Object>& model) { mStore.add(model); }
+    size_t cull(const glm::mat4& view, const glm::mat4& proj) { return collectDrawItems(view, proj).size(); }
+
+    void render(const std::shared_ptr<Scene>&, const glm::mat4&, const glm::mat4&) override {}
+    SHADER_BACKEND_TYPE getType() override { return SHADER_BACKEND_TYPE::OPENGL; }
+    void setup(const std::shared_ptr<Scene>&) override {}
+    void addModel(const std::shared_ptr<Object>&) override {}
+    void removeModel(const std::shared_ptr<Object>&) override {}
+    void setShaderType(SHADER_TYPE) override {}
+    SHADER_TYPE getShaderType() const override { return SHADER_TYPE::MATERIAL; }
+    void cleanup() override {}
+    void init() override {}
+};
+
+}
+
+int main(int argc, char** argv)
+{
+    Bench::Suite suite("load", argc, argv, {10000, 100000, 1000000});
+    const fs::path directory = fs::temp_directory_path() / "toy_renderer_bench";
+    fs::create_directories(directory);
+
+    for (size_t triangles : suite.sizes()) {
+        const std::string tag = std::to_string(triangles);
+        const fs::path obj = directory / ("grid" + tag + ".obj");
+        const fs::path objNoNormals = directory / ("grid" + tag + "_nonormals.obj");
+        const fs::path ply = directory / ("grid" + tag + ".ply");
+        Synthetic::writeOBJ(obj, triangles, true);
+        Synthetic::writeOBJ(objNoNormals, triangles, false);
+        Synthetic::writePLY(ply, triangles);
+
+        // A new Scene each run, the loaded file cache would skip the parse otherwise
+        auto load = [&](const fs::path& path) {
+            return [path] { Scene().loadModelFile(path); };
+        };
+        suite.run("obj_load", triangles, triangles, load(obj));
+        suite.run("obj_load_gen_normals", triangles, triangles, load(objNoNormals));
+        suite.run("ply_load", triangles, triangles, load(ply));
+
+        std::shared_ptr<Object> model;
+        auto freshModel = [&] {
+            model = std::make_shared<Object>();
+            model->addShape(Synthetic::gridShape(triangles));
+        };
+        suite.run("lod_build", triangles, triangles, freshModel, [&] { model->buildLODs(); });
+        suite.run("meshlet_build", triangles, triangles, freshModel, [&] { model->buildMeshlets(); });
+        freshModel();
+        model->buildLODs();
+        suite.run("weld_pack", triangles, triangles, [&] { GeometryPool::weld(*model); });
+
+        // About as many pixels as triangles
+        const auto side = static_cast<uint32_t>(std::clamp(std::sqrt(static_cast<double>(triangles)), 64.0, 8192.0));
+        const fs::path texture = directory / ("texture" + std::to_string(side) + ".tga");
+        Synthetic::writeTGA(texture, side, side);
+        suite.run("texture_decode", size_t(side) * side, size_t(side) * side,
+                  [&] { ResourceCache().image(texture.string()); });
+
+        // A tenth as many instances of a small model, each one a graph node and an Object
+        const size_t instances = std::max<size_t>(1, triangles / 10);
+        const fs::path small = directory / "small.obj";
+        const fs::path json = directory / ("scene" + tag + ".json");
+        Synthetic::writeOBJ(small, 200, true);
+        Synthetic::writeInstancedScene(json, small.filename().string(), instances);
+        suite.run("scene_json_load", instances, instances, [&] { Scene().loadJSON(json); });
+
+        Scene scene;
+        scene.loadJSON(json);
+        CullingProbe probe;
+        for (const auto& object : scene.getModels()) probe.add(object);
+        const float extent = 2.0f * std::sqrt(static_cast<float>(instances));
+        const glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, extent * 4.0f);
+        const glm::mat4 view = glm::lookAt(glm::vec3(-extent * 0.2f, extent * 0.3f, -extent * 0.2f),
+                                           glm::vec3(extent * 0.5f, 0.0f, extent * 0.5f), glm::vec3(0.0f, 1.0f, 0.0f));
+        suite.run("cull", instances, instances, [&] { probe.cull(view, proj); });
+    }
+    return suite.finish();
+}
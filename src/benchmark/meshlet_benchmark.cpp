@@ -0,0 +1,134 @@
+//
+// Created by clx on 26-10-19.
+//
+// Triangles submitted per view with shape level frustum culling, against what survives
+// the per-meshlet frustum and normal cone tests. Runs the same tests as meshlet_cull.comp
+// on the CPU, so it needs no window or GPU.
+//
+// usage: TR_EXE_BENCH_MESHLET [model.obj ...] [--views N]
+//
+
+#include "camera/frustum.h"
+#include "scene/scene.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct ViewResult {
+    uint64_t submitted = 0;     // every triangle of the shapes inside the frustum
+    uint64_t afterFrustum = 0;  // meshlet shapes reduced to their visible clusters
+    uint64_t afterCone = 0;     // and without clusters that face away from the camera
+};
+
+ViewResult measureView(const std::vector<std::shared_ptr<Object>>& models, const glm::mat4& view, const glm::mat4& proj) {
+    const Frustum frustum(proj * view);
+    const glm::vec3 cameraPosition = glm::vec3(glm::inverse(view)[3]);
+    ViewResult result;
+    for (const auto& model : models) {
+        const glm::mat4 modelMatrix = model->getModelMatrix();
+        for (size_t i = 0; i < model->getShapeCount(); ++i) {
+            AABB world = model->getShapeBounds(i).transformed(modelMatrix);
+            if (world.valid() && !frustum.intersectsAABB(world.center(), world.extent())) continue;
+            uint64_t triangles = model->getVertices(i).size() / 3;
+            result.submitted += triangles;
+
+            const MeshletData* data = model->getMeshlets(i);
+            if (!data) {
+                result.afterFrustum += triangles;
+                result.afterCone += triangles;
+                continue;
+            }
+            for (const Meshlet& meshlet : data->meshlets) {
+                if (!Meshlets::frustumVisible(meshlet, modelMatrix, frustum)) continue;
+                result.afterFrustum += meshlet.indexCount / 3;
+                if (Meshlets::coneVisible(meshlet, modelMatrix, cameraPosition))
+                    result.afterCone += meshlet.indexCount / 3;
+            }
+        }
+    }
+    return result;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> paths;
+    int viewCount = 16;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--views") == 0 && i + 1 < argc)
+            viewCount = std::max(1, std::atoi(argv[++i]));
+        else
+            paths.emplace_back(argv[i]);
+    }
+    if (paths.empty())
+        paths.emplace_back("./assets/SJTU_east_gate_MC/East_Gate_Voxel.obj");
+
+    for (const auto& path : paths) {
+        Scene scene;
+        auto start = std::chrono::steady_clock::now();
+        scene.addModel(path);
+        double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        auto models = scene.getModels();
+        if (models.empty()) {
+            std::fprintf(stderr, "%s: failed to load\n", path.c_str());
+            continue;
+        }
+
+        // Time the clustering on its own, the scene already built it once while loading
+        start = std::chrono::steady_clock::now();
+        for (const auto& model : models) model->buildMeshlets();
+        double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        AABB bounds;
+        uint64_t triangles = 0;
+        size_t shapes = 0, clusteredShapes = 0, meshlets = 0;
+        for (const auto& model : models) {
+            bounds.expand(model->getBounds().transformed(model->getModelMatrix()));
+            for (size_t i = 0; i < model->getShapeCount(); ++i) {
+                triangles += model->getVertices(i).size() / 3;
+                ++shapes;
+                if (const MeshletData* data = model->getMeshlets(i)) {
+                    ++clusteredShapes;
+                    meshlets += data->meshlets.size();
+                }
+            }
+        }
+
+        std::printf("%s\n", path.c_str());
+        std::printf("  %llu triangles, %zu shapes (%zu clustered), %zu meshlets\n",
+                    static_cast<unsigned long long>(triangles), shapes, clusteredShapes, meshlets);
+        std::printf("  load %.1f ms, meshlet build %.1f ms\n", loadMs, buildMs);
+        if (!bounds.valid()) continue;
+
+        // Orbit slightly above the model, close enough that part of it falls outside the frustum
+        const glm::vec3 center = bounds.center();
+        const float radius = glm::length(bounds.extent());
+        const glm::mat4 proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, radius * 0.001f, radius * 10.0f);
+        ViewResult total;
+        std::printf("  %6s %14s %14s %14s\n", "view", "submitted", "cluster frust", "+ cone");
+        for (int v = 0; v < viewCount; ++v) {
+            float angle = glm::radians(360.0f * v / viewCount);
+            glm::vec3 eye = center + glm::vec3(std::cos(angle), 0.35f, std::sin(angle)) * radius * 0.9f;
+            ViewResult r = measureView(models, glm::lookAt(eye, center, glm::vec3(0.0f, 1.0f, 0.0f)), proj);
+            std::printf("  %6d %14llu %14llu %14llu\n", v, static_cast<unsigned long long>(r.submitted),
+                        static_cast<unsigned long long>(r.afterFrustum), static_cast<unsigned long long>(r.afterCone));
+            total.submitted += r.submitted;
+            total.afterFrustum += r.afterFrustum;
+            total.afterCone += r.afterCone;
+        }
+        if (total.submitted) {
+            std::printf("  rendered / submitted: %.1f%% after cluster frustum, %.1f%% after cone\n",
+                        100.0 * total.afterFrustum / total.submitted, 100.0 * total.afterCone / total.submitted);
+        }
+    }
+    return 0;
+}
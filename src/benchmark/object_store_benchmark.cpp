@@ -0,0 +1,198 @@
+//
+// Created by clx on 26-10-19.
+//
+// Per-frame CPU cost of culling and building the draw list for many small objects, reading them
+// through shared_ptr<Object> and hash lookups as the renderers used to, against the linear ObjectStore
+// walk they do now. Both produce the same draws, a mismatch fails the run. No window or GPU.
+//
+// usage: TR_EXE_BENCH_OBJECTS [--objects N] [--frames N]
+//
+
+#include "camera/frustum.h"
+#include "render/objectStore.h"
+#include "scene/scene.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <glm/gtc/matrix_transform.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+struct Draw {
+    glm::mat4 model;
+    MeshRange range;
+    uint32_t material;
+};
+
+Shape cubeShape(float size, int material) {
+    static const glm::vec3 corners[8] = {
+        {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}, {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}
+    };
+    static const int faces[12][3] = {
+        {0, 2, 1}, {0, 3, 2}, {4, 5, 6}, {4, 6, 7}, {0, 1, 5}, {0, 5, 4},
+        {3, 6, 2}, {3, 7, 6}, {0, 4, 7}, {0, 7, 3}, {1, 2, 6}, {1, 6, 5}
+    };
+    Shape shape;
+    for (const auto& face : faces) {
+        for (int corner : face) {
+            shape.vertices.push_back(corners[corner] * size);
+            shape.normals.emplace_back(0.0f, 1.0f, 0.0f);
+        }
+    }
+    shape.material.diffuseTexture = "texture" + std::to_string(material) + ".png";
+    return shape;
+}
+
+// What the renderers kept per model before the store
+struct LegacyResources {
+    std::vector<uint32_t> materials;
+    std::vector<uint8_t> occluded;
+};
+
+void legacyFrame(const std::vector<std::shared_ptr<Object>>& models,
+                 const std::unordered_map<std::shared_ptr<Object>, LegacyResources>& resources,
+                 const GeometryPool::ShapeTable& table, const Frustum& frustum, std::vector<Draw>& draws) {
+    draws.clear();
+    for (const auto& model : models) {
+        const glm::mat4 modelMatrix = model->getModelMatrix();
+        AABB bounds = model->getBounds().transformed(modelMatrix);
+        if (!frustum.intersectsAABB(bounds.center(), bounds.extent())) continue;
+        for (size_t j = 0; j < model->getShapeCount(); ++j) {
+            AABB world = model->getShapeBounds(j).transformed(modelMatrix);
+            if (!frustum.intersectsAABB(world.center(), world.extent())) continue;
+            const LegacyResources& shapeResources = resources.at(model);
+            if (shapeResources.occluded[j]) continue;
+            const MeshRange& range = table.at(model->getModelKey())[j].lods[0];
+            draws.push_back({model->getModelMatrix(), range, shapeResources.materials[j]});
+        }
+    }
+}
+
+void storeFrame(ObjectStore& store, const Frustum& frustum, std::vector<Draw>& draws) {
+    draws.clear();
+    store.syncTransforms();
+    for (uint32_t i = 0; i < store.objectCount(); ++i) {
+        const glm::mat4& modelMatrix = store.world(i);
+        AABB bounds = store.objectBounds(i).transformed(modelMatrix);
+        if (!frustum.intersectsAABB(bounds.center(), bounds.extent())) continue;
+        for (uint32_t s = store.firstShape(i); s < store.firstShape(i) + store.shapeCount(i); ++s) {
+            AABB world = store.shapeBounds(s).transformed(modelMatrix);
+            if (!frustum.intersectsAABB(world.center(), world.extent())) continue;
+            if (store.occluded(s)) continue;
+            draws.push_back({modelMatrix, store.range(s, 0), store.material(s)});
+        }
+    }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    size_t objectCount = 100000;
+    int frames = 60;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--objects") == 0 && i + 1 < argc)
+            objectCount = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frames = std::max(1, std::atoi(argv[++i]));
+    }
+
+    // Assemblies of 100 parts on a grid, one to four shapes per part
+    Scene scene;
+    const int side = static_cast<int>(std::ceil(std::sqrt(objectCount / 100.0)));
+    SceneGraph::NodeId assembly = SceneGraph::none;
+    for (size_t i = 0; i < objectCount; ++i) {
+        if (i % 100 == 0) {
+            Transform local;
+            size_t a = i / 100;
+            local.translation = glm::vec3(static_cast<float>(a % side) * 12.0f, 0.0f, static_cast<float>(a / side) * 12.0f);
+            assembly = scene.addGroup(local);
+        }
+
+        auto model = std::make_shared<Object>();
+        for (size_t j = 0; j < 1 + i % 4; ++j)
+            model->addShape(cubeShape(0.5f + 0.1f * static_cast<float>(j), static_cast<int>((i + j) % 16)));
+        model->setModelMatrix(glm::vec3(static_cast<float>(i % 10), 0.0f, static_cast<float>(i / 10 % 10)));
+        scene.addObject(model, assembly);
+    }
+    scene.updateTransforms();
+    const auto models = scene.getModels();
+
+    // Ranges as the pool would hand them out, one level per shape
+    GeometryPool::ShapeTable table;
+    uint32_t firstIndex = 0;
+    for (const auto& model : models) {
+        auto& shapes = table[model->getModelKey()];
+        for (size_t j = 0; j < model->getShapeCount(); ++j) {
+            ShapeGeometry shape;
+            shape.lods.push_back({firstIndex, 36, 0});
+            firstIndex += 36;
+            shapes.push_back(shape);
+        }
+    }
+
+    std::unordered_map<std::shared_ptr<Object>, LegacyResources> resources;
+    ObjectStore store;
+    for (const auto& model : models) {
+        LegacyResources& shapeResources = resources[model];
+        uint32_t index = store.objectIndex(store.add(model));
+        for (uint32_t j = 0; j < model->getShapeCount(); ++j) {
+            auto material = static_cast<uint32_t>(std::hash<std::string>{}(model->getTexturePath(j)) % 64);
+            shapeResources.materials.push_back(material);
+            shapeResources.occluded.push_back(0);
+            store.material(store.firstShape(index) + j) = material;
+        }
+    }
+    store.setGeometry(table);
+
+    std::printf("%zu objects, %zu shapes\n", store.objectCount(), store.shapeCount());
+
+    using clock = std::chrono::steady_clock;
+    double legacyMs = 0.0, storeMs = 0.0;
+    size_t drawn = 0, mismatches = 0;
+    std::vector<Draw> legacyDraws, storeDraws;
+    glm::vec3 center(side * 6.0f, 0.0f, side * 6.0f);
+    const glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, side * 20.0f);
+    for (int frame = 0; frame < frames; ++frame) {
+        // Circle the grid, and move one part in a hundred so the graph has dirty nodes every frame
+        float angle = glm::radians(360.0f * static_cast<float>(frame) / static_cast<float>(frames));
+        glm::vec3 eye = center + glm::vec3(std::cos(angle), 0.4f, std::sin(angle)) * (side * 8.0f);
+        const Frustum frustum(proj * glm::lookAt(eye, center, glm::vec3(0.0f, 1.0f, 0.0f)));
+        for (size_t i = frame % 100; i < models.size(); i += 100)
+            models[i]->rotate(1.0f, glm::vec3(0.0f, 1.0f, 0.0f));
+        scene.updateTransforms();
+
+        auto start = clock::now();
+        legacyFrame(models, resources, table, frustum, legacyDraws);
+        auto middle = clock::now();
+        storeFrame(store, frustum, storeDraws);
+        auto end = clock::now();
+        legacyMs += std::chrono::duration<double, std::milli>(middle - start).count();
+        storeMs += std::chrono::duration<double, std::milli>(end - middle).count();
+
+        drawn += storeDraws.size();
+        if (legacyDraws.size() != storeDraws.size()) {
+            ++mismatches;
+            continue;
+        }
+        for (size_t k = 0; k < storeDraws.size(); ++k) {
+            if (storeDraws[k].range.firstIndex != legacyDraws[k].range.firstIndex ||
+                storeDraws[k].material != legacyDraws[k].material) {
+                ++mismatches;
+                break;
+            }
+        }
+    }
+
+    std::printf("%d frames, %.0f draws per frame\n", frames, static_cast<double>(drawn) / frames);
+    std::printf("  shared_ptr and lookups  %8.3f ms per frame\n", legacyMs / frames);
+    std::printf("  ObjectStore             %8.3f ms per frame (%.2fx)\n", storeMs / frames, legacyMs / std::max(storeMs, 1e-9));
+    std::printf("  %zu frames with mismatched draws\n", mismatches);
+    return mismatches ? 1 : 0;
+}
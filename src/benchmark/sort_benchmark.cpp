@@ -0,0 +1,83 @@
+//
+// Created by clx on 26-10-19.
+//
+// CPU cost of ordering a frame's draws at high draw counts: building the render queue's keys from shape
+// centroids, a tenth of them blended and ordered far to near, then sorting them with std::stable_sort,
+// the radix sort on one thread and the radix sort split across every core. The sorts must agree,
+// a mismatch fails the run. No window or GPU.
+//
+// usage: TR_EXE_BENCH_SORT [--sizes draws,...] [--filter name] [--repetitions N] [--json report.json]
+//
+
+#include "harness.h"
+#include "render/render.h"
+#include <algorithm>
+#include <random>
+
+namespace {
+
+struct Draw {
+    glm::vec3 center;
+    uint32_t material;
+    bool blended;
+};
+
+std::vector<Draw> randomDraws(size_t count) {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_int_distribution<uint32_t> material(0, 63);
+    std::uniform_int_distribution<uint32_t> blend(0, 9);
+    std::vector<Draw> draws(count);
+    for (Draw& draw : draws) draw = {{position(rng), position(rng), position(rng)}, material(rng), blend(rng) == 0};
+    return draws;
+}
+
+// The keys the renderers push for the material shader
+void fillQueue(RenderQueue& queue, const std::vector<Draw>& draws, const glm::vec3& camera) {
+    const auto shader = static_cast<uint32_t>(SHADER_TYPE::MATERIAL);
+    queue.clear();
+    for (size_t i = 0; i < draws.size(); ++i) {
+        const Draw& draw = draws[i];
+        glm::vec3 d = draw.center - camera;
+        const uint32_t order = RenderQueue::depthOrder(glm::dot(d, d));
+        if (draw.blended)
+            queue.push(RenderQueue::makeKey((static_cast<uint32_t>(AlphaMode::Blend) << 4) | shader, 0, ~order), static_cast<uint32_t>(i));
+        else
+            queue.push(RenderQueue::makeKey(shader, draw.material, order), static_cast<uint32_t>(i));
+    }
+}
+
+bool sameOrder(const std::vector<RenderQueue::Entry>& a, const std::vector<RenderQueue::Entry>& b) {
+    return std::ranges::equal(a, b, [](const auto& x, const auto& y) { return x.key == y.key && x.item == y.item; });
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Bench::Suite suite("sort", argc, argv, {1000, 10000, 100000, 1000000});
+    const glm::vec3 camera(20.0f, 5.0f, -30.0f);
+    bool agree = true;
+
+    for (size_t count : suite.sizes()) {
+        const std::vector<Draw> draws = randomDraws(count);
+        RenderQueue queue;
+        suite.run("build_keys", count, count, [&] { fillQueue(queue, draws, camera); });
+
+        std::vector<RenderQueue::Entry> expected;
+        suite.run("std_stable_sort", count, count, [&] { expected = queue.entries(); }, [&] {
+            std::ranges::stable_sort(expected, {}, &RenderQueue::Entry::key);
+        });
+
+        auto refill = [&] { fillQueue(queue, draws, camera); };
+        suite.run("radix_serial", count, count, refill, [&] { queue.sort(SIZE_MAX); });
+        agree = agree && sameOrder(queue.entries(), expected);
+        suite.run("radix_parallel", count, count, refill, [&] { queue.sort(0); });
+        agree = agree && sameOrder(queue.entries(), expected);
+    }
+    if (!agree) {
+        std::fprintf(stderr, "radix sort order differs from std::stable_sort\n");
+        return 1;
+    }
+    return suite.finish();
+}
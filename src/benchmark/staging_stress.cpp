@@ -0,0 +1,130 @@
+//
+// Created by clx on 26-10-19.
+//
+// Many threads upload into one device-local buffer through a shared stagingPool while the main
+// thread records and submits whatever has been queued, as the renderer does. Every thread fills
+// its own slice with sizes that straddle chunk boundaries, and sometimes asks for more than a chunk.
+// The buffer is read back and checked byte by byte. Runs headless, no window or surface.
+//
+// usage: TR_EXE_BENCH_STAGING [--threads N] [--megabytes M]
+//
+
+#include "EasyVulkan/easyVulkan.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <random>
+#include <thread>
+
+namespace {
+
+uint8_t pattern(uint32_t thread, VkDeviceSize offset) {
+    return static_cast<uint8_t>((offset * 2654435761u >> 13) ^ thread * 97u);
+}
+
+bool createDevice() {
+    graphicsBase::Base().UseLatestApiVersion();
+    return !(graphicsBase::Base().CreateInstance() ||
+             graphicsBase::Base().GetPhysicalDevices() ||
+             graphicsBase::Base().DeterminePhysicalDevice(0, true, false) ||
+             graphicsBase::Base().CreateDevice());
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t threadCount = std::max(2u, std::thread::hardware_concurrency());
+    VkDeviceSize megabytes = 8;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threadCount = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--megabytes") == 0 && i + 1 < argc)
+            megabytes = std::max(1, std::atoi(argv[++i]));
+    }
+    if (!createDevice()) {
+        std::fprintf(stderr, "failed to create a Vulkan device\n");
+        return 1;
+    }
+
+    {
+        const VkDeviceSize slice = megabytes << 20;
+        storageBuffer target(slice * threadCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+        stagingPool pool(1 << 20, 16 << 20);
+
+        std::atomic<uint32_t> running{threadCount};
+        std::atomic<uint64_t> uploads{0};
+        auto uploader = [&](uint32_t thread) {
+            stagingPool::writer writer(pool);
+            std::mt19937 random(thread);
+            std::uniform_int_distribution<VkDeviceSize> small(1, 64 << 10);
+            VkDeviceSize base = slice * thread;
+            for (VkDeviceSize offset = 0; offset < slice;) {
+                // One in sixteen is bigger than a chunk
+                VkDeviceSize size = random() % 16 ? small(random) : pool.ChunkSize() + small(random);
+                size = std::min(size, slice - offset);
+                writer.Upload(target, size, base + offset, [&](void* pData) {
+                    auto* bytes = static_cast<uint8_t*>(pData);
+                    for (VkDeviceSize i = 0; i < size; ++i) bytes[i] = pattern(thread, offset + i);
+                });
+                offset += size;
+                ++uploads;
+            }
+            --running;
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::future<void>> workers;
+        for (uint32_t i = 0; i < threadCount; ++i) {
+            workers.push_back(std::async(std::launch::async, uploader, i));
+        }
+
+        // Submissions complete in order, the submission count is the completed value
+        auto& commandBuffer = graphicsBase::Plus().CommandBuffer_Transfer();
+        uint64_t submissions = 0;
+        size_t copies = 0;
+        while (running || pool.Pending()) {
+            if (!pool.Pending()) {
+                std::this_thread::yield();
+                continue;
+            }
+            commandBuffer.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+            copies += pool.CmdCopy(commandBuffer, submissions + 1).size();
+            commandBuffer.End();
+            graphicsBase::Plus().ExecuteCommandBuffer_Graphics(commandBuffer);
+            pool.Recycle(++submissions);
+        }
+        for (auto& w : workers) w.get();
+        double uploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        // Read back through a host-visible buffer
+        VkBufferCreateInfo readbackCreateInfo = {
+            .size = target.AllocationSize(),
+            .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT
+        };
+        bufferMemory readback(readbackCreateInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        commandBuffer.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        VkBufferCopy region = { 0, 0, slice * threadCount };
+        vkCmdCopyBuffer(commandBuffer, target, readback.Buffer(), 1, &region);
+        commandBuffer.End();
+        graphicsBase::Plus().ExecuteCommandBuffer_Graphics(commandBuffer);
+        std::vector<uint8_t> bytes(slice * threadCount);
+        readback.RetrieveData(bytes.data(), bytes.size());
+
+        size_t mismatches = 0;
+        for (uint32_t thread = 0; thread < threadCount; ++thread)
+            for (VkDeviceSize offset = 0; offset < slice; ++offset)
+                mismatches += bytes[slice * thread + offset] != pattern(thread, offset);
+
+        std::printf("%u threads, %llu MB each\n", threadCount, static_cast<unsigned long long>(megabytes));
+        std::printf("  %llu uploads in %zu copies over %llu submissions\n",
+                    static_cast<unsigned long long>(uploads.load()), copies, static_cast<unsigned long long>(submissions));
+        std::printf("  %.1f ms, %.1f MB/s\n", uploadMs, megabytes * threadCount * 1000.0 / uploadMs);
+        std::printf("  %zu mismatched bytes\n", mismatches);
+        if (mismatches) return 1;
+    }
+    graphicsBase::Base().WaitIdle();
+    return 0;
+}
@@ -0,0 +1,128 @@
+//
+// Created by clx on 26-10-19.
+//
+// Generated inputs for the benchmarks, so a sweep needs no assets and scales to any size.
+//
+
+#ifndef TOY_RENDERER_BENCH_SYNTHETIC_H
+#define TOY_RENDERER_BENCH_SYNTHETIC_H
+
+#include "scene/object.h"
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace Synthetic {
+
+// Rows and columns of a height field grid with about this many triangles
+inline size_t gridSide(size_t triangles) {
+    return std::max<size_t>(1, static_cast<size_t>(std::sqrt(static_cast<double>(triangles) / 2.0)));
+}
+
+inline glm::vec3 gridPoint(size_t x, size_t z, size_t side) {
+    float u = static_cast<float>(x) / static_cast<float>(side);
+    float v = static_cast<float>(z) / static_cast<float>(side);
+    return {u, 0.05f * std::sin(u * 25.0f) * std::cos(v * 17.0f), v};
+}
+
+// Triangle soup as the loaders produce it, with normals and texture coordinates
+inline Shape gridShape(size_t triangles) {
+    const size_t side = gridSide(triangles);
+    Shape shape;
+    shape.name = "grid";
+    auto corner = [&](size_t x, size_t z) {
+        shape.vertices.push_back(gridPoint(x, z, side));
+        shape.normals.emplace_back(0.0f, 1.0f, 0.0f);
+        shape.texCoords.emplace_back(static_cast<float>(x) / side, static_cast<float>(z) / side);
+    };
+    for (size_t z = 0; z < side; ++z) {
+        for (size_t x = 0; x < side; ++x) {
+            corner(x, z); corner(x, z + 1); corner(x + 1, z);
+            corner(x + 1, z); corner(x, z + 1); corner(x + 1, z + 1);
+        }
+    }
+    return shape;
+}
+
+// Shared vertices and triangular faces, normals only when asked so the loader has to generate them otherwise
+inline void writeOBJ(const std::filesystem::path& path, size_t triangles, bool normals) {
+    const size_t side = gridSide(triangles);
+    std::ofstream file(path);
+    for (size_t z = 0; z <= side; ++z) {
+        for (size_t x = 0; x <= side; ++x) {
+            glm::vec3 p = gridPoint(x, z, side);
+            file << "v " << p.x << ' ' << p.y << ' ' << p.z << '\n';
+            file << "vt " << static_cast<float>(x) / side << ' ' << static_cast<float>(z) / side << '\n';
+            if (normals) file << "vn 0 1 0\n";
+        }
+    }
+    auto vertex = [&](size_t x, size_t z) {
+        size_t i = z * (side + 1) + x + 1;
+        file << ' ' << i << '/' << i;
+        if (normals) file << '/' << i;
+    };
+    for (size_t z = 0; z < side; ++z) {
+        for (size_t x = 0; x < side; ++x) {
+            file << 'f'; vertex(x, z); vertex(x, z + 1); vertex(x + 1, z); file << '\n';
+            file << 'f'; vertex(x + 1, z); vertex(x, z + 1); vertex(x + 1, z + 1); file << '\n';
+        }
+    }
+}
+
+inline void writePLY(const std::filesystem::path& path, size_t triangles) {
+    const size_t side = gridSide(triangles);
+    std::ofstream file(path);
+    file << "ply\nformat ascii 1.0\n"
+         << "element vertex " << (side + 1) * (side + 1) << "\nproperty float x\nproperty float y\nproperty float z\n"
+         << "element face " << side * side * 2 << "\nproperty list uchar int vertex_indices\nend_header\n";
+    for (size_t z = 0; z <= side; ++z) {
+        for (size_t x = 0; x <= side; ++x) {
+            glm::vec3 p = gridPoint(x, z, side);
+            file << p.x << ' ' << p.y << ' ' << p.z << '\n';
+        }
+    }
+    for (size_t z = 0; z < side; ++z) {
+        for (size_t x = 0; x < side; ++x) {
+            size_t i = z * (side + 1) + x;
+            file << "3 " << i << ' ' << i + side + 1 << ' ' << i + 1 << '\n';
+            file << "3 " << i + 1 << ' ' << i + side + 1 << ' ' << i + side + 2 << '\n';
+        }
+    }
+}
+
+// Uncompressed 32 bit TGA, stb_image decodes it without a compressed format's cost dominating
+inline void writeTGA(const std::filesystem::path& path, uint32_t width, uint32_t height) {
+    std::ofstream file(path, std::ios::binary);
+    const uint8_t header[18] = {
+        0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        static_cast<uint8_t>(width), static_cast<uint8_t>(width >> 8),
+        static_cast<uint8_t>(height), static_cast<uint8_t>(height >> 8), 32, 8
+    };
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    std::vector<uint8_t> row(size_t(width) * 4);
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            row[x * 4 + 0] = static_cast<uint8_t>(x);
+            row[x * 4 + 1] = static_cast<uint8_t>(y);
+            row[x * 4 + 2] = static_cast<uint8_t>(x ^ y);
+            row[x * 4 + 3] = 255;
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size()));
+    }
+}
+
+// One model placed count times on a square grid through an inline instance array
+inline void writeInstancedScene(const std::filesystem::path& path, const std::string& model, size_t count) {
+    const size_t side = std::max<size_t>(1, static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(count)))));
+    std::ofstream file(path);
+    file << "{\"objects\": [{\"file\": \"" << model << "\", \"instances\": {\"layout\": \"t\", \"data\": [";
+    for (size_t i = 0; i < count; ++i)
+        file << (i ? "," : "") << '[' << (i % side) * 2 << ",0," << (i / side) * 2 << ']';
+    file << "]}}]}\n";
+}
+
+}
+
+#endif //TOY_RENDERER_BENCH_SYNTHETIC_H
@@ -12,6 +12,12 @@ enum CameraType {
     ORTHOGRAPHIC
 };
 
+// Clip space the projection is built for. OpenGL has y up and depth -1 to 1, Vulkan y down and depth 0 to 1
+enum ClipConvention {
+    CLIP_OPENGL,
+    CLIP_VULKAN
+};
+
 class Camera {
 public:
     Camera() = default;
@@ -28,6 +34,8 @@ public:
             mNear = other.mNear;
             mFar = other.mFar;
             mAspectRatio = other.mAspectRatio;
+            mClip = other.mClip;
+            mReverseZ = other.mReverseZ;
         }
         return *this;
     }
@@ -55,7 +63,16 @@ public:
     void setFov(float fov) {mFov = fov;}
     void setYaw(float yaw) {mYaw = yaw;}
     void setPitch(float pitch) {mPitch = pitch;}
+    // Both at once, keeping the right and up vectors in step like mouse rotation does
+    void setRotation(float yaw, float pitch) {mYaw = yaw; mPitch = pitch; updateCameraVectors();}
     virtual CameraType getType() = 0;
+    // Takes effect with the next update()
+    void setClipConvention(ClipConvention clip) {mClip = clip;}
+    ClipConvention getClipConvention() const {return mClip;}
+    // Depth 1 at the near plane falling to 0 at infinity, for a float depth buffer cleared to 0 and
+    // tested with GREATER. Perspective has no far plane then. Takes effect with the next update()
+    void setReverseZ(bool reverseZ) {mReverseZ = reverseZ;}
+    bool getReverseZ() const {return mReverseZ;}
 
     // Movement controls
     void moveForward(float deltaTime, float speed);
@@ -90,8 +107,13 @@ protected:
 
     int mwidth, mheight;
     float mAspectRatio;
+    ClipConvention mClip = CLIP_OPENGL;
+    bool mReverseZ = false;
 
     void updateCameraVectors();
+    // Projections are written for OpenGL clip space, this maps one to mClip's.
+    // Reverse-Z ones already have depth 0 to 1 (glClipControl on OpenGL), only y is flipped
+    glm::mat4 toClipSpace(const glm::mat4& projection) const;
 };
 
 
@@ -0,0 +1,46 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#ifndef TOY_RENDERER_CAMERAPATH_H
+#define TOY_RENDERER_CAMERAPATH_H
+
+#include "camera/camera.h"
+#include <filesystem>
+#include <vector>
+
+struct CameraKey {
+    float time;     // seconds from the start of the path
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+    float fov;
+};
+
+// Camera poses over time, for walkthroughs that replay the same way on every run. Linear between
+// keys, yaw the shorter way round. Stored as text, one "time x y z yaw pitch fov" line per key,
+// # starts a comment
+class CameraPath {
+public:
+    // Keys come in time order, one before the last key is dropped
+    void add(const CameraKey& key);
+    void record(float time, const Camera& camera);
+    void clear() { mKeys.clear(); }
+
+    bool empty() const { return mKeys.empty(); }
+    size_t size() const { return mKeys.size(); }
+    float duration() const { return mKeys.empty() ? 0.0f : mKeys.back().time; }
+    const std::vector<CameraKey>& keys() const { return mKeys; }
+
+    // Clamped to the first and last key
+    CameraKey sample(float time) const;
+    void apply(float time, Camera& camera) const;
+
+    bool load(const std::filesystem::path& path);
+    bool save(const std::filesystem::path& path) const;
+
+private:
+    std::vector<CameraKey> mKeys;
+};
+
+#endif //TOY_RENDERER_CAMERAPATH_H
@@ -0,0 +1,33 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#ifndef TOY_RENDERER_FRUSTUM_H
+#define TOY_RENDERER_FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// Six clip planes extracted from a view-projection matrix (Gribb-Hartmann).
+// Planes are kept SoA and padded to 8 so one box is tested against four planes per SSE op.
+class Frustum {
+public:
+    Frustum() = default;
+    explicit Frustum(const glm::mat4& viewProjection) { update(viewProjection); }
+
+    void update(const glm::mat4& viewProjection);
+
+    // Both tests are conservative: false means fully outside, true may still be outside near a corner
+    bool intersectsAABB(const glm::vec3& center, const glm::vec3& extent) const;
+    bool intersectsSphere(const glm::vec3& center, float radius) const;
+
+    // (normal, d) with dot(normal, p) + d >= 0 inside, for uploading to shaders
+    glm::vec4 plane(int i) const { return {mNx[i], mNy[i], mNz[i], mD[i]}; }
+
+private:
+    alignas(16) float mNx[8]{};
+    alignas(16) float mNy[8]{};
+    alignas(16) float mNz[8]{};
+    alignas(16) float mD[8]{1, 1, 1, 1, 1, 1, 1, 1};
+};
+
+#endif //TOY_RENDERER_FRUSTUM_H
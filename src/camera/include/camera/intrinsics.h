@@ -0,0 +1,75 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#ifndef TOY_RENDERER_INTRINSICS_H
+#define TOY_RENDERER_INTRINSICS_H
+
+#include "camera/perspective.h"
+#include <cmath>
+
+// Pinhole camera from calibrated intrinsics: focal lengths and principal point in pixels of a
+// reference resolution, image origin top left and y down as in OpenCV. The projection is built
+// from them directly, so at the reference resolution every pixel lands where the calibrated
+// image has it. Other sizes scale the intrinsics along. Changing the FOV zooms by scaling fx and fy.
+class IntrinsicsCamera : public PerspectiveCamera {
+public:
+    IntrinsicsCamera(float fx, float fy, float cx, float cy, int width, int height)
+            : mFx(fx), mFy(fy), mCx(cx), mCy(cy), mReferenceWidth(width), mReferenceHeight(height) {
+        mFov = mAppliedFov = verticalFov();
+    }
+
+    void update(int w, int h) override {
+        mwidth = w, mheight = h;
+        if (mFov != mAppliedFov) {
+            float zoom = std::tan(glm::radians(mAppliedFov) * 0.5f) / std::tan(glm::radians(mFov) * 0.5f);
+            mFx *= zoom;
+            mFy *= zoom;
+            mFov = mAppliedFov = verticalFov();
+        }
+        glm::vec3 front;
+        front.x = static_cast<float>(cos(glm::radians(mYaw)) * cos(glm::radians(mPitch)));
+        front.y = static_cast<float>(sin(glm::radians(mPitch)));
+        front.z = static_cast<float>(sin(glm::radians(mYaw)) * cos(glm::radians(mPitch)));
+        mFront = glm::normalize(front);
+        mAspectRatio = static_cast<float>(mwidth) / static_cast<float>(mheight);
+        mViewMatrix = glm::lookAt(mPosition, mPosition + mFront, mUp);
+
+        // Intrinsics in pixels of the window
+        const float sx = static_cast<float>(w) / static_cast<float>(mReferenceWidth);
+        const float sy = static_cast<float>(h) / static_cast<float>(mReferenceHeight);
+        const float fx = mFx * sx, fy = mFy * sy, cx = mCx * sx, cy = mCy * sy;
+        const auto width = static_cast<float>(w), height = static_cast<float>(h);
+        glm::mat4 projection(0.0f);
+        projection[0][0] = 2.0f * fx / width;
+        projection[1][1] = 2.0f * fy / height;
+        projection[2][0] = 1.0f - 2.0f * cx / width;
+        projection[2][1] = 2.0f * cy / height - 1.0f;
+        projection[2][3] = -1.0f;
+        if (mReverseZ) {
+            projection[3][2] = mNear;
+        } else {
+            projection[2][2] = -(mFar + mNear) / (mFar - mNear);
+            projection[3][2] = -2.0f * mFar * mNear / (mFar - mNear);
+        }
+        mProjectionMatrix = toClipSpace(projection);
+    }
+
+    float getFx() const {return mFx;}
+    float getFy() const {return mFy;}
+    float getCx() const {return mCx;}
+    float getCy() const {return mCy;}
+    int getReferenceWidth() const {return mReferenceWidth;}
+    int getReferenceHeight() const {return mReferenceHeight;}
+
+private:
+    float verticalFov() const {
+        return glm::degrees(2.0f * std::atan(static_cast<float>(mReferenceHeight) * 0.5f / mFy));
+    }
+
+    float mFx, mFy, mCx, mCy;
+    int mReferenceWidth, mReferenceHeight;
+    float mAppliedFov;  // the FOV fx and fy currently give
+};
+
+#endif //TOY_RENDERER_INTRINSICS_H
@@ -30,7 +30,13 @@ public:
         float bottom = -orthoScale;
         float top = orthoScale;
 
-        mProjectionMatrix = glm::ortho(left, right, bottom, top, mNear, mFar);
+        glm::mat4 projection = glm::ortho(left, right, bottom, top, mNear, mFar);
+        if (mReverseZ) {
+            // Linear either way, the far plane stays: 1 at near, 0 at far
+            projection[2][2] = 1.0f / (mFar - mNear);
+            projection[3][2] = mFar / (mFar - mNear);
+        }
+        mProjectionMatrix = toClipSpace(projection);
     }
 
     CameraType getType() override {return ORTHOGRAPHIC;}
@@ -15,24 +15,6 @@ public:
     PerspectiveCamera() = default;
     explicit PerspectiveCamera(const Camera& other) : Camera(other) {}
 
-//    void setFromIntrinsics(float fx, float fy, float cx, float cy, float near = 0.1f, float far = 100.0f) {
-//        mAspectRatio = static_cast<float>(mwidth) / static_cast<float>(mheight);
-//        mNear = near;
-//        mFar = far;
-//
-//        mProjectionMatrix = glm::mat4(1.0f);
-//        mProjectionMatrix[0][0] = 2.0f * fx / mwidth;
-//        mProjectionMatrix[1][1] = 2.0f * fy / mheight;
-//        mProjectionMatrix[2][0] = 1.0f - 2.0f * cx / mwidth;
-//        mProjectionMatrix[2][1] = 2.0f * cy / mheight - 1.0f;
-//        mProjectionMatrix[2][2] = -(far + near) / (far - near);
-//        mProjectionMatrix[2][3] = -1.0f;
-//        mProjectionMatrix[3][2] = -2.0f * far * near / (far - near);
-//        mProjectionMatrix[3][3] = 0.0f;
-//        mFov = 2.0f * atan2(mheight / 2.0f, fy) * 180.0f / M_PI;
-//        mViewMatrix = glm::lookAt(mPosition, mPosition + mFront, mUp);
-//    }
-
     void update(int w, int h) override {
         mwidth = w, mheight = h;
         glm::vec3 front;
@@ -42,7 +24,13 @@ public:
         mFront = glm::normalize(front);
         mAspectRatio = static_cast<float>(mwidth) / static_cast<float>(mheight);
         mViewMatrix = glm::lookAt(mPosition, mPosition + mFront, mUp);
-        mProjectionMatrix = glm::perspective(glm::radians(mFov), mAspectRatio, mNear, mFar);
+        glm::mat4 projection = glm::perspective(glm::radians(mFov), mAspectRatio, mNear, mFar);
+        if (mReverseZ) {
+            // Depth near / -z: 1 at the near plane, 0 at infinity
+            projection[2][2] = 0.0f;
+            projection[3][2] = mNear;
+        }
+        mProjectionMatrix = toClipSpace(projection);
     }
 
     CameraType getType() override {return PERSPECTIVE;}
@@ -66,4 +66,15 @@ void Camera::updateCameraVectors() {
     mFront = glm::normalize(front);
     mRight = glm::normalize(glm::cross(mFront, glm::vec3(0.0f, 1.0f, 0.0f)));
     mUp = glm::normalize(glm::cross(mRight, mFront));
-}
\ No newline at end of file
+}
+
+glm::mat4 Camera::toClipSpace(const glm::mat4& projection) const {
+    if (mClip == CLIP_OPENGL) return projection;
+    glm::mat4 convert(1.0f);
+    convert[1][1] = -1.0f;
+    if (mReverseZ) return convert * projection;
+    // Flip y, and z' = (z + w) / 2 takes depth from [-1, 1] to [0, 1]
+    convert[2][2] = 0.5f;
+    convert[3][2] = 0.5f;
+    return convert * projection;
+}
@@ -0,0 +1,88 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#include "camera/cameraPath.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+void CameraPath::add(const CameraKey& key) {
+    if (!mKeys.empty() && key.time < mKeys.back().time) return;
+    mKeys.push_back(key);
+}
+
+void CameraPath::record(float time, const Camera& camera) {
+    add({time, camera.getPosition(), camera.getYaw(), camera.getPitch(), camera.getFov()});
+}
+
+CameraKey CameraPath::sample(float time) const {
+    if (mKeys.empty()) return {time, glm::vec3(0.0f), -90.0f, 0.0f, 45.0f};
+    if (time <= mKeys.front().time) return mKeys.front();
+    if (time >= mKeys.back().time) return mKeys.back();
+
+    auto next = std::upper_bound(mKeys.begin(), mKeys.end(), time,
+                                 [](float t, const CameraKey& key) { return t < key.time; });
+    const CameraKey& b = *next;
+    const CameraKey& a = *(next - 1);
+    float span = b.time - a.time;
+    float t = span > 0.0f ? (time - a.time) / span : 1.0f;
+
+    float yawDelta = b.yaw - a.yaw;
+    if (yawDelta > 180.0f) yawDelta -= 360.0f;
+    if (yawDelta < -180.0f) yawDelta += 360.0f;
+    float yaw = a.yaw + yawDelta * t;
+    if (yaw > 180.0f) yaw -= 360.0f;
+    if (yaw < -180.0f) yaw += 360.0f;
+    return {time, glm::mix(a.position, b.position, t), yaw, a.pitch + (b.pitch - a.pitch) * t, a.fov + (b.fov - a.fov) * t};
+}
+
+void CameraPath::apply(float time, Camera& camera) const {
+    CameraKey key = sample(time);
+    camera.setPosition(key.position);
+    camera.setRotation(key.yaw, key.pitch);
+    camera.setFov(key.fov);
+}
+
+bool CameraPath::load(const std::filesystem::path& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open camera path " << path << std::endl;
+        return false;
+    }
+    std::vector<CameraKey> keys;
+    std::string line;
+    for (size_t number = 1; std::getline(file, line); ++number) {
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        std::istringstream fields(line);
+        CameraKey key{};
+        if (!(fields >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch >> key.fov)) {
+            std::cerr << path << ":" << number << ": expected time x y z yaw pitch fov" << std::endl;
+            return false;
+        }
+        if (!keys.empty() && key.time < keys.back().time) {
+            std::cerr << path << ":" << number << ": keys must be in time order" << std::endl;
+            return false;
+        }
+        keys.push_back(key);
+    }
+    mKeys = std::move(keys);
+    return true;
+}
+
+bool CameraPath::save(const std::filesystem::path& path) const {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    file << "# time x y z yaw pitch fov\n";
+    // Round trips a float exactly
+    file.precision(9);
+    for (const CameraKey& key : mKeys)
+        file << key.time << ' ' << key.position.x << ' ' << key.position.y << ' ' << key.position.z << ' '
+             << key.yaw << ' ' << key.pitch << ' ' << key.fov << '\n';
+    return true;
+}
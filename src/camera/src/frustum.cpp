@@ -0,0 +1,74 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#include "camera/frustum.h"
+
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TR_FRUSTUM_SSE 1
+#endif
+
+void Frustum::update(const glm::mat4& m) {
+    // glm is column-major, row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    auto row = [&m](int i) { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+    const glm::vec4 r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+    // The near plane uses the OpenGL form (z >= -w). For Vulkan's [0, 1] depth this is
+    // slightly looser than z >= 0, which only keeps a few extra objects, never drops one.
+    const glm::vec4 planes[6] = {r3 + r0, r3 - r0, r3 + r1, r3 - r1, r3 + r2, r3 - r2};
+    for (int i = 0; i < 8; ++i) {
+        glm::vec4 p = i < 6 ? planes[i] : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        float len = glm::length(glm::vec3(p));
+        if (len > 0.0f) p /= len;
+        mNx[i] = p.x;
+        mNy[i] = p.y;
+        mNz[i] = p.z;
+        mD[i] = p.w;
+    }
+}
+
+bool Frustum::intersectsAABB(const glm::vec3& center, const glm::vec3& extent) const {
+#ifdef TR_FRUSTUM_SSE
+    const __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+    const __m128 ex = _mm_set1_ps(extent.x), ey = _mm_set1_ps(extent.y), ez = _mm_set1_ps(extent.z);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    for (int i = 0; i < 8; i += 4) {
+        __m128 nx = _mm_load_ps(mNx + i), ny = _mm_load_ps(mNy + i), nz = _mm_load_ps(mNz + i);
+        // distance of the box center, and the box's projected radius onto the plane normal
+        __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+                                 _mm_add_ps(_mm_mul_ps(nz, cz), _mm_load_ps(mD + i)));
+        __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex),
+                                              _mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)),
+                                   _mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+        if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(dist, radius), _mm_setzero_ps()))) return false;
+    }
+    return true;
+#else
+    for (int i = 0; i < 6; ++i) {
+        float dist = mNx[i] * center.x + mNy[i] * center.y + mNz[i] * center.z + mD[i];
+        float radius = std::abs(mNx[i]) * extent.x + std::abs(mNy[i]) * extent.y + std::abs(mNz[i]) * extent.z;
+        if (dist + radius < 0.0f) return false;
+    }
+    return true;
+#endif
+}
+
+bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const {
+#ifdef TR_FRUSTUM_SSE
+    const __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+    const __m128 r = _mm_set1_ps(radius);
+    for (int i = 0; i < 8; i += 4) {
+        __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(mNx + i), cx), _mm_mul_ps(_mm_load_ps(mNy + i), cy)),
+                                 _mm_add_ps(_mm_mul_ps(_mm_load_ps(mNz + i), cz), _mm_load_ps(mD + i)));
+        if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(dist, r), _mm_setzero_ps()))) return false;
+    }
+    return true;
+#else
+    for (int i = 0; i < 6; ++i) {
+        if (mNx[i] * center.x + mNy[i] * center.y + mNz[i] * center.z + mD[i] < -radius) return false;
+    }
+    return true;
+#endif
+}
@@ -1,6 +1,9 @@
 #include "scene/scene.h"
 #include "viewer/viewer.h"
 #include "camera/perspective.h"
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
 #include <memory>
 #include "render/render_OpenGL.h"
 #include "render/render_Vulkan.h"
@@ -9,26 +12,73 @@
 #include "viewer/ui/shaderUI.h"
 #include "viewer/ui/cameraUI.h"
 #include "viewer/ui/renderUI.h"
+#include "viewer/ui/profilerUI.h"
+#include "viewer/ui/statsUI.h"
 
-int main()
+// usage: TR_EXE_MAIN [--scene model.obj|scene.json] [--reverse-z on|off]
+//                    [--replay path.txt [--timestep s] [--warmup frames] [--report report.json]]
+// --replay flies the camera path once with a fixed timestep per frame, prints frame time percentiles and exits.
+// Reverse-Z is on by default, off gives the classic depth mapping with a far plane
+int main(int argc, char** argv)
 {
-    const int WIDTH = 1920, HEIGHT = 1080;
+    int width = 1920, height = 1080;
     const std::string title = "toy renderer";
+    std::filesystem::path scenePath = "./assets/SJTU_east_gate_MC/East_Gate_Voxel.obj";
+    std::filesystem::path replayPath;
+    ReplayOptions replay;
+    replay.exitWhenDone = true;
+    bool reverseZ = true;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 == argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (arg == "--scene") scenePath = value;
+        else if (arg == "--replay") replayPath = value;
+        else if (arg == "--timestep") replay.timestep = std::strtof(value, nullptr);
+        else if (arg == "--warmup") replay.warmupFrames = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (arg == "--report") replay.report = value;
+        else if (arg == "--reverse-z") reverseZ = std::string(value) != "off";
+        else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+
     auto scene = std::make_shared<Scene>();
-    scene->addModel("./assets/SJTU_east_gate_MC/East_Gate_Voxel.obj");
-    auto camera = std::make_shared<PerspectiveCamera>();
-    camera->update(WIDTH, HEIGHT);
+    if (scenePath.extension() == ".json") scene->loadJSON(scenePath);
+    else scene->addModel(scenePath);
+    // A scene file with a calibrated camera renders at its resolution, pixel for pixel
+    if (scene->getResolution().x > 0 && scene->getResolution().y > 0) {
+        width = scene->getResolution().x;
+        height = scene->getResolution().y;
+    }
+    std::shared_ptr<Camera> camera = scene->getCamera();
+    if (!camera) camera = std::make_shared<PerspectiveCamera>();
+    camera->update(width, height);
     auto render = std::make_shared<Render_OpenGL>();
     auto render2 = std::make_shared<Render_Vulkan>();
-    auto viewer = std::make_shared<Viewer>(WIDTH, HEIGHT, render, render2, camera, scene, title);
+    render->setReverseZ(reverseZ);
+    render2->setReverseZ(reverseZ);
+    auto viewer = std::make_shared<Viewer>(width, height, render, render2, camera, scene, title);
     const auto ui_model = std::make_shared<ModelUI>(viewer);
     const auto ui_shader = std::make_shared<ShaderUI>(viewer);
     const auto ui_camera = std::make_shared<CameraUI>(viewer);
     const auto ui_render = std::make_shared<RenderUI>(viewer);
+    const auto ui_profiler = std::make_shared<ProfilerUI>(viewer);
+    const auto ui_stats = std::make_shared<StatsUI>(viewer);
     viewer->addUI(ui_model);
     viewer->addUI(ui_shader);
     viewer->addUI(ui_camera);
     viewer->addUI(ui_render);
+    viewer->addUI(ui_profiler);
+    viewer->addUI(ui_stats);
+    if (!replayPath.empty()) {
+        if (!viewer->getCameraPath().load(replayPath)) return 1;
+        viewer->startReplay(replay);
+    }
     viewer->mainloop();
     return 0;
 }
\ No newline at end of file
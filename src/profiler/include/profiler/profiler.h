@@ -0,0 +1,92 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#ifndef TOY_RENDERER_PROFILER_H
+#define TOY_RENDERER_PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+// Timed region of one frame. CPU zones nest per thread, depth counts the zones open around it.
+// GPU zones come from the renderers' timestamp queries a frame or more late, placed on the frame
+// they belong to with their offset from that frame's first GPU timestamp.
+struct ProfileZone {
+    const char* name;           // a string literal, zones are recorded every frame
+    uint64_t startNs;           // since the profiler was created
+    uint64_t durationNs;
+    uint32_t depth;
+    uint32_t thread;            // small numbers in order of first use, gpuThread for GPU zones
+};
+
+struct ProfileFrame {
+    uint64_t index;
+    uint64_t startNs;
+    uint64_t durationNs = 0;    // 0 while the frame is running
+    std::vector<ProfileZone> zones;
+};
+
+// Records CPU zones from any thread and GPU zones from the renderers, keeps the last frames for the
+// profiler panel and writes them as a Chrome trace (chrome://tracing, ui.perfetto.dev).
+// Zones are coarse, a few dozen per frame, so it is on from the start to catch loading.
+// Switched off, a zone costs one relaxed load.
+class Profiler {
+public:
+    static constexpr uint32_t gpuThread = UINT32_MAX;
+    static constexpr size_t historySize = 240;
+
+    static Profiler& get();
+
+    void setEnabled(bool enable);
+    bool enabled() const { return mEnabled.load(std::memory_order_relaxed); }
+    uint64_t now() const;
+
+    // Closes the running frame and starts the next, call once per frame on the main thread
+    void beginFrame();
+    uint64_t frameIndex() const { return mFrameIndex; }
+
+    void recordCpu(const char* name, uint64_t startNs, uint64_t endNs, uint32_t depth);
+    // Dropped when the frame has already left the history
+    void recordGpu(uint64_t frame, const char* name, uint64_t offsetNs, uint64_t durationNs);
+
+    // Finished frames, oldest first. Zones recorded before the first frame (loading) are kept apart
+    std::vector<ProfileFrame> history() const;
+    std::vector<ProfileZone> startup() const;
+    bool exportChromeTrace(const std::filesystem::path& path) const;
+
+private:
+    Profiler();
+    ProfileFrame* findFrame(uint64_t index);
+    uint32_t threadNumber();
+
+    std::atomic<bool> mEnabled{true};
+    uint64_t mFrameIndex = 0;   // 0 until the first beginFrame()
+    mutable std::mutex mMutex;
+    std::deque<ProfileFrame> mFrames;   // finished frames, then the running one
+    std::vector<ProfileZone> mStartup;
+    uint32_t mThreadCount = 0;
+};
+
+// Times the enclosing scope as a CPU zone when the profiler is on
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name);
+    ~ProfileScope();
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* mName;
+    uint64_t mStart = 0;
+    bool mActive;
+};
+
+#define TR_PROFILE_CONCAT_INNER(a, b) a##b
+#define TR_PROFILE_CONCAT(a, b) TR_PROFILE_CONCAT_INNER(a, b)
+#define TR_PROFILE_ZONE(name) ProfileScope TR_PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+#endif //TOY_RENDERER_PROFILER_H
@@ -0,0 +1,128 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#include "profiler/profiler.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+
+namespace {
+
+const auto processStart = std::chrono::steady_clock::now();
+thread_local uint32_t zoneDepth = 0;
+thread_local uint32_t threadId = UINT32_MAX;
+
+}
+
+Profiler& Profiler::get() {
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler() = default;
+
+void Profiler::setEnabled(bool enable) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!enable) {
+        mFrames.clear();
+        mStartup.clear();
+    }
+    mEnabled.store(enable, std::memory_order_relaxed);
+}
+
+uint64_t Profiler::now() const {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - processStart).count());
+}
+
+void Profiler::beginFrame() {
+    uint64_t time = now();
+    std::lock_guard<std::mutex> lock(mMutex);
+    ++mFrameIndex;
+    if (!enabled()) return;
+    if (!mFrames.empty()) mFrames.back().durationNs = time - mFrames.back().startNs;
+    // One extra for the running frame
+    while (mFrames.size() > historySize) mFrames.pop_front();
+    mFrames.push_back({mFrameIndex, time, 0, {}});
+}
+
+uint32_t Profiler::threadNumber() {
+    if (threadId == UINT32_MAX) threadId = mThreadCount++;
+    return threadId;
+}
+
+void Profiler::recordCpu(const char* name, uint64_t startNs, uint64_t endNs, uint32_t depth) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    ProfileZone zone{name, startNs, endNs - startNs, depth, threadNumber()};
+    if (mFrames.empty()) mStartup.push_back(zone);
+    else mFrames.back().zones.push_back(zone);
+}
+
+ProfileFrame* Profiler::findFrame(uint64_t index) {
+    if (mFrames.empty() || index < mFrames.front().index || index > mFrames.back().index) return nullptr;
+    return &mFrames[index - mFrames.front().index];
+}
+
+void Profiler::recordGpu(uint64_t frame, const char* name, uint64_t offsetNs, uint64_t durationNs) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (ProfileFrame* target = findFrame(frame))
+        target->zones.push_back({name, target->startNs + offsetNs, durationNs, 0, gpuThread});
+}
+
+std::vector<ProfileFrame> Profiler::history() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mFrames.size() < 2) return {};
+    return {mFrames.begin(), mFrames.end() - 1};
+}
+
+std::vector<ProfileZone> Profiler::startup() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStartup;
+}
+
+bool Profiler::exportChromeTrace(const std::filesystem::path& path) const {
+    nlohmann::json events = nlohmann::json::array();
+    auto add = [&](const ProfileZone& zone) {
+        bool gpu = zone.thread == gpuThread;
+        // Trace times are microseconds
+        events.push_back({
+            {"name", zone.name}, {"cat", gpu ? "gpu" : "cpu"}, {"ph", "X"},
+            {"ts", static_cast<double>(zone.startNs) * 1e-3}, {"dur", static_cast<double>(zone.durationNs) * 1e-3},
+            {"pid", 1}, {"tid", gpu ? 0 : zone.thread + 1}
+        });
+    };
+    for (const ProfileZone& zone : startup()) add(zone);
+    for (const ProfileFrame& frame : history()) {
+        events.push_back({
+            {"name", "frame " + std::to_string(frame.index)}, {"cat", "frame"}, {"ph", "X"},
+            {"ts", static_cast<double>(frame.startNs) * 1e-3}, {"dur", static_cast<double>(frame.durationNs) * 1e-3},
+            {"pid", 1}, {"tid", -1}
+        });
+        for (const ProfileZone& zone : frame.zones) add(zone);
+    }
+    nlohmann::json trace;
+    trace["traceEvents"] = std::move(events);
+    trace["displayTimeUnit"] = "ms";
+
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    file << trace.dump();
+    return true;
+}
+
+ProfileScope::ProfileScope(const char* name) : mName(name), mActive(Profiler::get().enabled()) {
+    if (!mActive) return;
+    ++zoneDepth;
+    mStart = Profiler::get().now();
+}
+
+ProfileScope::~ProfileScope() {
+    if (!mActive) return;
+    --zoneDepth;
+    Profiler::get().recordCpu(mName, mStart, Profiler::get().now(), zoneDepth);
+}
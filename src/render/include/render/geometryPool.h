@@ -0,0 +1,89 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#ifndef TOY_RENDERER_GEOMETRYPOOL_H
+#define TOY_RENDERER_GEOMETRYPOOL_H
+
+#include "scene/object.h"
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Interleaved layout shared by both backends, same as shaderVulkan::material
+struct GeometryVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoord;
+};
+
+// Indexed draw of one LOD inside the pool
+struct MeshRange {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t vertexOffset;
+};
+
+struct ShapeGeometry {
+    std::vector<MeshRange> lods;        // level 0 is the full shape
+    uint32_t meshletOffset = 0;         // into meshlets()
+    uint32_t meshletCount = 0;          // 0 when the shape is drawn in one piece
+    uint32_t meshletIndexBase = 0;      // Meshlet::firstIndex is relative to this, vertices are lods[0]'s
+};
+
+// One model's shapes welded and packed, offsets relative to its own arrays
+struct WeldedModel {
+    std::vector<GeometryVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<Meshlet> meshlets;
+    std::vector<ShapeGeometry> shapes;
+};
+
+// Every shape and LOD of the scene welded and packed into one vertex and one index array,
+// so a renderer can keep all geometry in a couple of buffers and draw it with indirect commands.
+// Models are packed once when added. Adds and removes only record the change, the arrays are
+// concatenated again once when the renderer next consumes it, so setting up N models copies them once.
+// Objects sharing their shapes share one block, it stays until the last of them is removed.
+class GeometryPool {
+public:
+    using ShapeTable = std::unordered_map<const ModelData*, std::vector<ShapeGeometry>>;
+
+    // Both backends upload images with the top row first, so texture V is flipped here.
+    // Backend neutral, ResourceCache keeps the result for whichever renderer asks next
+    static std::shared_ptr<const WeldedModel> weld(const Object& model);
+
+    void addModel(const std::shared_ptr<Object>& model, std::shared_ptr<const WeldedModel> welded);
+    void removeModel(const std::shared_ptr<Object>& model);
+    void clear();
+
+    const std::vector<ShapeGeometry>& getShapes(const std::shared_ptr<Object>& model) const { return mShapes.at(model->getModelKey()); }
+    bool contains(const ModelData* key) const { return mBlocks.contains(key); }
+    // Every model's ranges, a renderer that uploads in the background keeps a copy matching its buffers
+    const ShapeTable& shapeTable() const { return mShapes; }
+    const std::vector<GeometryVertex>& vertices() const { return mVertices; }
+    const std::vector<uint32_t>& indices() const { return mIndices; }
+    const std::vector<Meshlet>& meshlets() const { return mMeshlets; }
+    // Positions of vertices() alone, the stream of the depth pre-pass. Built on every call
+    std::vector<glm::vec3> positions() const;
+
+    // True once after changes, the arrays and ranges are repacked then and the renderer re-uploads them.
+    // The accessors above reflect the pool as of the last call
+    bool consumeDirty();
+
+private:
+    void rebuild();
+
+    bool mDirty = false;
+    struct Block {
+        std::shared_ptr<const WeldedModel> welded;
+        uint32_t users = 0;
+    };
+    std::vector<const ModelData*> mOrder;
+    std::unordered_map<const ModelData*, Block> mBlocks;
+    ShapeTable mShapes;
+    std::vector<GeometryVertex> mVertices;
+    std::vector<uint32_t> mIndices;
+    std::vector<Meshlet> mMeshlets;
+};
+
+#endif //TOY_RENDERER_GEOMETRYPOOL_H
@@ -0,0 +1,48 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#ifndef TOY_RENDERER_MATERIALTABLE_H
+#define TOY_RENDERER_MATERIALTABLE_H
+
+#include "scene/material.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Every distinct material a renderer draws, stored once and uploaded whole into one storage buffer.
+// Shapes keep an index into it, which the shaders read per draw. Equal materials share an entry,
+// so a scene of many models repeating a few MTL materials stays a few entries.
+class MaterialTable {
+public:
+    // std430 layout, as the material shaders declare it
+    struct Entry {
+        glm::vec4 diffuse{0.0f};    // alpha in w
+        glm::vec4 specular{0.0f};   // shininess in w
+        glm::vec4 emissive{0.0f};
+        // The backend's reference to the diffuse texture, zero for none: a bindless handle on OpenGL,
+        // the texture array element plus one on Vulkan
+        glm::uvec2 texture{0u};
+        uint32_t alphaMode = 0;     // AlphaMode, masked shapes discard below one half
+        uint32_t padding = 0;
+    };
+
+    uint32_t add(const Material& material, uint64_t texture);
+    // Entries nobody uses any more are reused by the next new material
+    void release(uint32_t index);
+    void clear();
+
+    const std::vector<Entry>& entries() const { return mEntries; }
+    // Changed since the last call, the renderer uploads the table again
+    bool consumeDirty();
+
+private:
+    std::vector<Entry> mEntries;
+    std::vector<uint32_t> mUsers;
+    std::vector<uint32_t> mFree;
+    std::unordered_map<std::string, uint32_t> mLookup;  // an entry's bytes, it has no padding the compiler adds
+    bool mDirty = false;
+};
+
+#endif //TOY_RENDERER_MATERIALTABLE_H
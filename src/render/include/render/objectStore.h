@@ -0,0 +1,114 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#ifndef TOY_RENDERER_OBJECTSTORE_H
+#define TOY_RENDERER_OBJECTSTORE_H
+
+#include "render/geometryPool.h"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Generational, so a handle kept past its object's removal stops resolving instead of naming a newcomer
+struct ObjectHandle {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+    bool operator==(const ObjectHandle&) const = default;
+};
+
+// Where a shape's levels sit in the geometry buffers
+struct ShapeDraw {
+    uint32_t firstRange = UINT32_MAX;   // into the store's ranges, one per level, none until resident
+    uint32_t meshletOffset = 0;
+    uint32_t meshletCount = 0;
+    uint32_t meshletIndexBase = 0;
+};
+
+// What a renderer reads per frame about the scene's objects and shapes, in flat arrays walked front to back.
+// Objects keep the order they were added in and their shapes are contiguous, so an object is a range of
+// shape indices. Removing one shifts the rest down, which is rare next to the per-frame reads.
+// Object stays the interface for everything else, the store only copies what drawing needs.
+class ObjectStore {
+public:
+    static constexpr uint32_t none = UINT32_MAX;
+
+    ObjectHandle add(const std::shared_ptr<Object>& model);
+    void remove(ObjectHandle handle);
+    void clear();
+    // Invalid handle when the model was never added
+    ObjectHandle find(const Object* model) const;
+    bool valid(ObjectHandle handle) const {
+        return handle.index < mSlots.size() && mSlots[handle.index].generation == handle.generation &&
+               mSlots[handle.index].object != none;
+    }
+    uint32_t objectIndex(ObjectHandle handle) const { return mSlots[handle.index].object; }
+
+    // Copies every world matrix from the scene graph, once per frame before culling
+    void syncTransforms();
+    // Points every shape at its ranges in the table, shapes missing from it are not resident
+    void setGeometry(const GeometryPool::ShapeTable& table);
+    // Objects were added since the last setGeometry(). An instance of shapes already in the pool
+    // changes no buffer, but still needs its ranges
+    bool needsGeometry() const { return mNeedsGeometry; }
+
+    // Per object
+    size_t objectCount() const { return mObjects.size(); }
+    const std::shared_ptr<Object>& object(uint32_t i) const { return mObjects[i]; }
+    const glm::mat4& world(uint32_t i) const { return mWorld[i]; }
+    const AABB& objectBounds(uint32_t i) const { return mObjectBounds[i]; }
+    uint32_t firstShape(uint32_t i) const { return mFirstShape[i]; }
+    uint32_t shapeCount(uint32_t i) const { return mShapeCount[i]; }
+
+    // Per shape, an object's shapes are firstShape(i) .. firstShape(i) + shapeCount(i)
+    size_t shapeCount() const { return mOwner.size(); }
+    uint32_t owner(uint32_t s) const { return mOwner[s]; }
+    const AABB& shapeBounds(uint32_t s) const { return mShapeBounds[s]; }
+    const BoundingSphere& shapeSphere(uint32_t s) const { return mShapeSpheres[s]; }
+    uint32_t lodCount(uint32_t s) const { return mLODCount[s]; }
+    AlphaMode alphaMode(uint32_t s) const { return mAlphaMode[s]; }
+    bool resident(uint32_t s) const { return mDraws[s].firstRange != none; }
+    const ShapeDraw& draw(uint32_t s) const { return mDraws[s]; }
+    const MeshRange& range(uint32_t s, uint32_t lod) const { return mRanges[mDraws[s].firstRange + lod]; }
+
+    // Backend state per shape, the renderer decides what the numbers mean: a texture or texture slot,
+    // an entry of its material table, an occlusion query object or index
+    uint32_t& texture(uint32_t s) { return mTexture[s]; }
+    uint32_t& material(uint32_t s) { return mMaterial[s]; }
+    uint32_t& query(uint32_t s) { return mQuery[s]; }
+    uint8_t& queryPending(uint32_t s) { return mQueryPending[s]; }
+    uint8_t& occluded(uint32_t s) { return mOccluded[s]; }
+
+private:
+    struct Slot {
+        uint32_t object = none;     // dense index, none while free
+        uint32_t generation = 0;
+    };
+    std::vector<Slot> mSlots;
+    std::vector<uint32_t> mFreeSlots;
+    std::unordered_map<const Object*, ObjectHandle> mLookup;    // add and remove only
+
+    std::vector<std::shared_ptr<Object>> mObjects;
+    std::vector<uint32_t> mSlotOf;
+    std::vector<glm::mat4> mWorld;
+    std::vector<AABB> mObjectBounds;
+    std::vector<uint32_t> mFirstShape;
+    std::vector<uint32_t> mShapeCount;
+
+    std::vector<uint32_t> mOwner;
+    std::vector<AABB> mShapeBounds;
+    std::vector<BoundingSphere> mShapeSpheres;
+    std::vector<uint32_t> mLODCount;
+    std::vector<AlphaMode> mAlphaMode;
+    std::vector<ShapeDraw> mDraws;
+    std::vector<MeshRange> mRanges;
+    std::vector<uint32_t> mTexture;
+    std::vector<uint32_t> mMaterial;
+    std::vector<uint32_t> mQuery;
+    std::vector<uint8_t> mQueryPending;
+    std::vector<uint8_t> mOccluded;
+    bool mNeedsGeometry = false;
+};
+
+#endif //TOY_RENDERER_OBJECTSTORE_H
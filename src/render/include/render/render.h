@@ -6,10 +6,70 @@
 #define TOY_RENDERER_UPDATE_RENDER_H
 
 #include "camera/camera.h"
+#include "camera/frustum.h"
+#include "render/materialTable.h"
+#include "render/objectStore.h"
+#include "render/renderQueue.h"
+#include "render/resourceCache.h"
 #include "scene/scene.h"
 #include "scene/object.h"
 #include "shader/shader.h"
 
+struct CullingStats {
+    uint32_t drawnObjects = 0;
+    uint32_t culledObjects = 0;
+    uint32_t drawnShapes = 0;
+    uint32_t culledShapes = 0;
+    uint32_t occludedShapes = 0;    // draws skipped because last frame's query found no samples
+    uint32_t occlusionQueries = 0;
+    uint32_t meshletShapes = 0;     // shapes whose clusters were culled on the GPU
+    uint32_t meshletsTested = 0;
+    uint32_t drawCalls = 0;         // API draw calls, one indirect call may cover many shapes
+    uint32_t instancedShapes = 0;   // drawn as one more instance of the previous shape's command
+    uint64_t drawnTriangles = 0;
+    uint64_t drawnVertices = 0;     // indices submitted, before the post-transform cache
+};
+
+// API work of one frame, counted by the backends where they issue it. Uploads made between frames,
+// like the textures of an added model, land in the next frame
+struct RenderStats {
+    uint32_t pipelineBinds = 0;     // programs on OpenGL
+    uint32_t descriptorBinds = 0;   // descriptor sets, storage buffer bindings on OpenGL
+    uint32_t textureBinds = 0;      // a texture switched for the next batch, never with bindless textures
+    uint32_t bufferUploads = 0;     // texture uploads included
+    uint64_t uploadBytes = 0;
+    // Samples that passed the depth test in the shading pass over the pixels of the target, from a query
+    // read a frame or more late. 1 means every pixel shaded once, more is overdraw, less uncovered background
+    uint64_t shadedSamples = 0;
+    uint64_t targetPixels = 0;
+    double overdraw() const { return targetPixels ? static_cast<double>(shadedSamples) / targetPixels : 0.0; }
+    // Pipeline or texture switches the shading pass's draws would need in the order culling hands them over,
+    // and the ones left after the render queue sorted them. Blended draws keep far to near order, each
+    // texture switch between them counts
+    uint32_t unsortedStateChanges = 0;
+    uint32_t sortedStateChanges = 0;
+    // Shapes the material shader drew alpha tested, and blended after everything else
+    uint32_t maskedShapes = 0;
+    uint32_t blendedShapes = 0;
+};
+
+// GPU memory a renderer allocated, as requested from the API, driver padding and the swapchain not included
+struct MemoryStats {
+    uint64_t geometry = 0;      // vertices, indices, meshlets
+    uint64_t drawData = 0;      // per draw matrices, texture indices and indirect commands
+    uint64_t textures = 0;      // mip chains included
+    uint64_t total() const { return geometry + drawData + textures; }
+};
+
+// A shape that survived frustum culling this frame
+struct DrawItem {
+    uint32_t object;    // indices into the renderer's ObjectStore
+    uint32_t shape;
+    AABB bounds;        // world space
+    float distance;     // squared, from the camera to the box
+    uint32_t lod;
+};
+
 class Render {
 public:
     virtual ~Render() = default;
@@ -38,7 +98,96 @@ public:
         return mShaders;
     }
 
+    void setFrustumCulling(bool enable) { mFrustumCulling = enable; }
+    bool getFrustumCulling() const { return mFrustumCulling; }
+    void setOcclusionCulling(bool enable) { mOcclusionCulling = enable; }
+    bool getOcclusionCulling() const { return mOcclusionCulling; }
+    void setLODEnabled(bool enable) { mLODEnabled = enable; }
+    bool getLODEnabled() const { return mLODEnabled; }
+    // Above 1 keeps full detail further away, below 1 drops it sooner
+    void setLODBias(float bias) { mLODBias = bias; }
+    float getLODBias() const { return mLODBias; }
+    // Per-cluster culling in a compute pass, Vulkan only
+    void setMeshletCulling(bool enable) { mMeshletCulling = enable; }
+    bool getMeshletCulling() const { return mMeshletCulling; }
+    // Needs consistently wound meshes, the pipelines themselves draw both faces
+    void setClusterConeCulling(bool enable) { mClusterConeCulling = enable; }
+    bool getClusterConeCulling() const { return mClusterConeCulling; }
+    // All textures in one descriptor array (Vulkan) or as resident handles (OpenGL), picked per draw,
+    // so the material shader merges into one draw instead of one per texture.
+    // Ignored where the device lacks the extension
+    void setBindlessTextures(bool enable) { mBindlessTextures = enable; }
+    bool getBindlessTextures() const { return mBindlessTextures; }
+    bool bindlessTexturesSupported() const { return mBindlessSupported; }
+    // Depth cleared to 0 and tested with GREATER into a 32-bit float buffer, for cameras with reverse-Z on.
+    // OpenGL draws the scene into its own framebuffer for it and copies the color to the window
+    void setReverseZ(bool enable) { mReverseZ = enable; }
+    bool getReverseZ() const { return mReverseZ; }
+    // Draws the opaque shapes into depth alone first, from a position-only vertex stream, then shades with
+    // an EQUAL depth test, so every pixel runs the fragment shader once. Not for the wireframe shader
+    void setDepthPrepass(bool enable) { mDepthPrepass = enable; }
+    bool getDepthPrepass() const { return mDepthPrepass; }
+    // Near to far order of the shapes, so early-Z rejects hidden fragments. Batches keep their texture,
+    // ordered by their nearest shape, but repeated meshes are no longer merged into instanced commands
+    void setFrontToBack(bool enable) { mFrontToBack = enable; }
+    bool getFrontToBack() const { return mFrontToBack; }
+    const CullingStats& getCullingStats() const { return mCullingStats; }
+    // Of the last finished render()
+    const RenderStats& getRenderStats() const { return mFrameStats; }
+    const MemoryStats& getMemoryStats() const { return mMemoryStats; }
+    // Give both renderers the same cache so a backend switch reuses what the other one decoded
+    void setResourceCache(std::shared_ptr<ResourceCache> cache) { mResources = std::move(cache); }
+    const std::shared_ptr<ResourceCache>& getResourceCache() const { return mResources; }
+
 protected:
+    // Frustum culls objects then shapes, and fills the culling counters.
+    // With occlusion culling or front to back on, items are sorted near to far so big occluders land in depth first.
+    // Walks mStore in order, refreshing its world matrices first.
+    std::vector<DrawItem> collectDrawItems(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
+    // Proxy boxes that contain the camera get clipped by the near plane and would read as hidden
+    bool cameraInside(const AABB& bounds) const;
+    // Picks a level from the sphere's projected diameter as a fraction of the screen height
+    uint32_t selectLOD(const BoundingSphere& worldSphere, size_t lodCount, const glm::mat4& projectionMatrix) const;
+    // The queue's pipeline field of a shading pass draw: the alpha mode above the shader, so opaque shapes
+    // come first, then alpha-tested ones, then blended ones. Counts the shapes of the last two
+    uint32_t drawPipeline(uint32_t shader, AlphaMode mode);
+    // Blended shapes draw farthest first, by their box centers. The box distance the other orders use
+    // is zero for every box around the camera
+    uint32_t blendOrder(const AABB& bounds) const {
+        glm::vec3 d = bounds.center() - mCameraPosition;
+        return ~RenderQueue::depthOrder(glm::dot(d, d));
+    }
+    void countUpload(uint64_t bytes) {
+        ++mRenderStats.bufferUploads;
+        mRenderStats.uploadBytes += bytes;
+    }
+    // Called at the end of render()
+    void finishFrameStats() {
+        mFrameStats = mRenderStats;
+        mRenderStats = {};
+    }
+
+    bool mFrustumCulling = true;
+    bool mOcclusionCulling = false;
+    bool mLODEnabled = true;
+    float mLODBias = 1.0f;
+    bool mMeshletCulling = true;
+    bool mClusterConeCulling = false;
+    bool mBindlessTextures = true;
+    bool mBindlessSupported = false;    // set by init()
+    bool mReverseZ = false;
+    bool mDepthPrepass = false;
+    bool mFrontToBack = false;
+    std::shared_ptr<ResourceCache> mResources = std::make_shared<ResourceCache>();
+    ObjectStore mStore;     // the models added to this renderer
+    MaterialTable mMaterials;   // indexed by the store's material per shape
+    RenderQueue mQueue;     // the shading pass's draws, rebuilt every frame
+    Frustum mFrustum;
+    glm::vec3 mCameraPosition{0.0f};
+    CullingStats mCullingStats;
+    RenderStats mRenderStats;   // the running frame
+    RenderStats mFrameStats;
+    MemoryStats mMemoryStats;
     std::unordered_map<SHADER_TYPE, std::shared_ptr<Shader>> mShaders;
     std::pair<SHADER_TYPE, std::shared_ptr<Shader>> mCurrentShader;
 };
@@ -0,0 +1,48 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#ifndef TOY_RENDERER_RENDERQUEUE_H
+#define TOY_RENDERER_RENDERQUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One frame's draws ordered by a 64-bit key, so state switches only where the key's state part changes.
+// From the top: 8 bits pipeline (with the alpha mode), 24 bits material, 32 bits order inside a material
+// (depth or mesh).
+// Keys are radix sorted, stable, so equal keys keep the order they were pushed in.
+class RenderQueue {
+public:
+    struct Entry {
+        uint64_t key;
+        uint32_t item;      // the caller's index
+    };
+
+    static uint64_t makeKey(uint32_t pipeline, uint32_t material, uint32_t order) {
+        return (static_cast<uint64_t>(pipeline & 0xffu) << 56) | (static_cast<uint64_t>(material & 0xffffffu) << 32) | order;
+    }
+    // A non-negative float's bits sort like the float does
+    static uint32_t depthOrder(float distance);
+    static uint64_t state(uint64_t key) { return key >> 32; }
+
+    void clear();
+    void push(uint64_t key, uint32_t item);
+    // Queues this long sort on every core, shorter ones aren't worth the threads
+    static constexpr size_t parallelThreshold = 1 << 15;
+    void sort(size_t parallelFrom = parallelThreshold);
+    const std::vector<Entry>& entries() const { return mEntries; }
+
+    // Pipeline or material switches between consecutive draws, in the order pushed and in the order sorted
+    uint32_t unsortedStateChanges() const { return mUnsortedChanges; }
+    uint32_t sortedStateChanges() const { return mSortedChanges; }
+
+private:
+    std::vector<Entry> mEntries;
+    std::vector<Entry> mScratch;    // kept across frames, like the entries
+    uint32_t mUnsortedChanges = 0;
+    uint32_t mSortedChanges = 0;
+};
+
+#endif //TOY_RENDERER_RENDERQUEUE_H
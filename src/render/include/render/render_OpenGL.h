@@ -6,6 +6,7 @@
 #define TOY_RENDERER_UPDATE_RENDER_OPENGL_H
 
 #include "render.h"
+#include "render/geometryPool.h"
 #include "shader/shaderOpenGL.h"
 
 
@@ -30,15 +31,85 @@ public:
     }
 
 private:
-    struct OpenGLModelResources {
-        std::vector<GLuint> VAOs;
-        std::vector<GLuint> VBOs;
-        std::vector<GLuint> textures;
-        std::vector<size_t> vertexCounts;
+    // Layout glMultiDrawElementsIndirect reads
+    struct DrawElementsIndirectCommand {
+        uint32_t count;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        int32_t baseVertex;
+        uint32_t baseInstance;
+    };
+    // Draws are batched by texture and alpha mode, every batch is one multi draw
+    struct DrawBatch {
+        GLuint texture;
+        AlphaMode alphaMode;
+        uint32_t firstCommand;
+        uint32_t commandCount;
     };
     void cleanup() override;
-    std::unordered_map<std::shared_ptr<Object>, OpenGLModelResources> mModelResources;
-    void loadTexture(const std::string& path, GLuint& textureID);
+    void deleteQueries(uint32_t firstShape, uint32_t shapeCount);
+    void readOcclusionResults();
+    void renderOcclusionProxies(const std::vector<DrawItem>& items, const glm::mat4& viewProjection);
+    void uploadGeometry();
+    void reserveDraws(size_t drawCount);
+    void uploadMaterials();
+    void buildDrawList(const std::vector<DrawItem>& items);
+    GLuint textureFor(const Material& material);
+    GLuint64 textureHandle(GLuint texture);
+    // Float depth target while reverse-Z is on, the default framebuffer only has fixed point depth
+    void beginSceneTarget();
+    void endSceneTarget();
+    void deleteSceneTarget();
+    GLuint mProxyVAO = 0;
+    GLuint mSceneFramebuffer = 0;
+    GLuint mSceneTargets[2] = {};   // color, depth renderbuffers
+    GLint mSceneSize[2] = {};
+    bool mHasOcclusionState = false;
+    void loadTexture(const Material& material, GLuint& textureID);
+    // GPU zones for the profiler. GL_TIME_ELAPSED queries can't nest, so the zones run back to back
+    // and are laid out one after another. Read a few frames late, the CPU never waits on them
+    enum GpuZone : uint32_t { GPU_ZONE_PREPASS, GPU_ZONE_SCENE, GPU_ZONE_OCCLUSION, GPU_ZONE_COUNT };
+    static constexpr uint32_t gpuTimerFrames = 4;
+    struct GpuTimers {
+        GLuint queries[GPU_ZONE_COUNT] = {};
+        uint64_t frame = 0;     // profiler frame that issued them, 0 when nothing is pending
+        uint32_t issued = 0;    // bit per zone
+        GLuint samples = 0;     // GL_SAMPLES_PASSED of the shading pass, for the overdraw stats
+        uint64_t pixels = 0;    // of the target it ran on, 0 when nothing is pending
+    };
+    void beginGpuZone(GpuZone zone);
+    void endGpuZone();
+    void readGpuTimers();
+    GpuTimers mGpuTimers[gpuTimerFrames];
+    uint32_t mGpuTimerSlot = 0;
+    bool mGpuTiming = false;    // the profiler was on when this frame started
+
+    // Scene geometry in one vertex and one index buffer, rebuilt when models are added or removed
+    GeometryPool mGeometry;
+    GLuint mVAO = 0;
+    GLuint mVBO = 0;
+    GLuint mEBO = 0;
+    // Depth pre-pass: positions alone, same indices and draw IDs
+    GLuint mDepthVAO = 0;
+    GLuint mPositionVBO = 0;
+    // Per frame: one model matrix per draw and the indirect commands.
+    // mDrawIDs holds 0..capacity as an instanced attribute so baseInstance picks the matrix
+    GLuint mDrawIDs = 0;
+    GLuint mDrawData = 0;
+    GLuint mDrawCommands = 0;
+    GLuint mDrawMaterialData = 0;   // material table entry per draw, read by the material shaders
+    size_t mDrawCapacity = 0;
+    std::vector<glm::mat4> mDrawModels;
+    std::vector<uint32_t> mDrawMaterials;
+    // mMaterials whole, uploaded again when it changes
+    GLuint mMaterialData = 0;
+    size_t mMaterialCapacity = 0;
+    std::vector<DrawElementsIndirectCommand> mCommands;
+    std::vector<DrawBatch> mBatches;
+    // mStore's texture is the shape's texture from here, 0 for none, its query an occlusion query object
+    std::unordered_map<std::string, GLuint> mTextureCache;
+    std::unordered_map<GLuint, GLuint64> mTextureHandles;   // made resident when a material first refers to them
+    bool mBindless = false;                                 // this frame draws with them
 };
 
 
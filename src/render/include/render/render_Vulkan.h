@@ -6,7 +6,9 @@
 #define RENDER_VULKAN_H
 
 #include "render.h"
+#include "render/geometryPool.h"
 #include "shader/shaderVulkan.h"
+#include "shader/computeVulkan.h"
 
 
 
@@ -33,17 +35,118 @@ public:
 private:
     void cleanup() override;
     void loadTexture(const std::string& path, GLuint& textureID);
-    struct VulkanModelResources {
-        std::vector<uint32_t> vertexCounts;
-        std::vector<vertexBuffer> vertexBuffers_Material;
-        std::vector<descriptorSet> descriptorSets;
-        std::vector<texture2d> textures;
-        std::vector<sampler> samplers;
-        std::vector<uniformBuffer> uniformBuffers;
-        std::vector<uniformBuffer> hasTextureBuffers;
-        std::vector<descriptorPool> descriptorPools;
+    void readOcclusionResults();
+    void initFrameResources();
+    void initMeshletCulling();
+    void uploadGeometry();
+    struct GeometryBuffers;
+    void makeResident(std::unique_ptr<GeometryBuffers> geometry);
+    void reserveDraws(size_t drawCount, size_t commandCount);
+    void uploadMaterials();
+    uint32_t textureSlot(const Material& material, bool hasTexCoords);
+    void releaseTextureSlot(uint32_t slot);
+    void buildDrawList(const std::vector<DrawItem>& items);
+    void recordMeshletCulling();
+
+    // Draws are batched by texture, every batch binds one of these and issues one indirect draw.
+    // Shared by all shapes with the same texture, freed with the last of them
+    struct TextureSet {
+        texture2d texture;
+        descriptorSet set;
+        std::string key;
+        uint32_t users = 0;
+        uint64_t bytes = 0;     // of the image, for the memory stats
+    };
+    struct MeshletCullConstants {
+        glm::mat4 model;
+        uint32_t meshletOffset;
+        uint32_t meshletCount;
+        uint32_t commandOffset;
+        uint32_t drawIndex;
+        uint32_t indexBase;
+        int32_t vertexOffset;
+        uint32_t flags;
+    };
+    struct MeshletCullData {
+        glm::vec4 planes[6];
+        glm::vec4 cameraPosition;
+    };
+    struct DrawBatch {
+        uint32_t textureSlot;
+        AlphaMode alphaMode;
+        uint32_t firstCommand;
+        uint32_t commandCount;
+    };
+
+    // Scene geometry, rebuilt when models are added or removed.
+    // A new upload runs on the transfer queue while the resident buffers keep drawing, shapes of
+    // models that are not in the resident table yet are skipped until it lands
+    struct GeometryBuffers {
+        std::optional<vertexBuffer> vertices;
+        std::optional<vertexBuffer> positions;  // the depth pre-pass stream
+        std::optional<indexBuffer> indices;
+        std::optional<storageBuffer> meshlets;
+        GeometryPool::ShapeTable shapes;    // handed to mStore once resident
+        uint64_t ticket = 0;    // transfer semaphore value once uploaded
+        VkDeviceSize bytes = 0;
     };
-    std::unordered_map<std::shared_ptr<Object>, VulkanModelResources> mModelResources;
+    void updateGeometryMemory();
+    GeometryPool mGeometry;
+    std::unique_ptr<GeometryBuffers> mResidentGeometry;
+    std::unique_ptr<GeometryBuffers> mPendingGeometry;
+    std::optional<asyncTransfer> mTransfer;     // empty without timeline semaphores, uploads then block
+    std::optional<stagingPool> mStaging;        // filled by worker threads, recorded by mTransfer
+    uint64_t mAcquireTicket = 0;                // ownership still to be taken by this frame's command buffer
+
+    // Per frame: camera, one model matrix and material table entry per draw, and the indirect commands
+    std::optional<uniformBuffer> mFrameData;
+    std::optional<storageBuffer> mDrawData;
+    std::optional<storageBuffer> mDrawMaterialData;
+    std::optional<storageBuffer> mDrawCommands;
+    uint32_t mDrawCapacity = 0;
+    uint32_t mCommandCapacity = 0;
+    std::vector<glm::mat4> mDrawModels;
+    std::vector<uint32_t> mDrawMaterials;       // read by the material shaders
+    // mMaterials whole, uploaded again when it changes
+    std::optional<storageBuffer> mMaterialData;
+    uint32_t mMaterialCapacity = 0;
+    std::vector<VkDrawIndexedIndirectCommand> mCommands;
+    std::vector<DrawBatch> mBatches;
+    std::vector<MeshletCullConstants> mDispatches;
+
+    // mStore's texture is the shape's slot here, its query the one issued in the frame in flight or none
+    std::vector<std::unique_ptr<TextureSet>> mTextureSets;     // null for free slots
+    std::unordered_map<std::string, uint32_t> mTextureSlots;
+    descriptorAllocator mTextureDescriptors;
+    samplerCache mSamplers;
+    std::optional<uniformBuffer> mTextureFlags[2];              // hasTexture of the material shader, 0 and 1
+
+    // Bindless: one set whose texture array holds every TextureSet's texture at its slot
+    uint32_t mBindlessCapacity = 0;
+    std::optional<descriptorPool> mBindlessPool;
+    descriptorSet mBindlessSet;
+    bool mBindless = false;                                     // this frame draws with it
+
+    std::optional<occlusionQueries> mOcclusionQueries;
+    uint32_t mQueryCount = 0;
+    bool mHasOcclusionState = false;
+    // Samples passed by the shading pass for the overdraw stats, read by the next render()
+    void readOverdraw();
+    std::optional<occlusionQueries> mOverdrawQuery;
+    uint64_t mOverdrawPixels = 0;       // of the frame that issued it, 0 for none
+    bool mPreciseOcclusion = false;
+    // GPU zones for the profiler, timestamps at the top of the frame, after the culling dispatches, after
+    // the scene and after the proxies. The viewer waits on the frame's fence, the next render() reads them
+    std::optional<timestampQueries> mTimestamps;
+    uint64_t mTimestampFrame = 0;       // profiler frame that wrote them, 0 for none
+    bool mTimestampOcclusion = false;
+    void readTimestamps();
+    std::optional<computeShaderVulkan> mMeshletCull;
+    std::optional<uniformBuffer> mMeshletCullData;
+    std::optional<descriptorPool> mMeshletPool;
+    descriptorSet mMeshletSet;
+    bool mMultiDrawIndirect = false;
+    bool mIndirectFirstInstance = false;
 };
 
 #endif //RENDER_VULKAN_H
@@ -0,0 +1,52 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#ifndef TOY_RENDERER_RESOURCECACHE_H
+#define TOY_RENDERER_RESOURCECACHE_H
+
+#include "render/geometryPool.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// RGBA8, the first row is the top of the image
+struct DecodedImage {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+// Decoded images and welded geometry in a form neither backend owns.
+// The renderers share one cache, so switching backends or re-running setup() uploads from memory
+// instead of reading, decoding and welding the scene again.
+class ResourceCache {
+public:
+    // Null when the file can't be read, failures are remembered too
+    std::shared_ptr<const DecodedImage> image(const std::string& path);
+    // The diffuse map with an MTL alpha map's first channel as its alpha, white where there is no diffuse map.
+    // Just the diffuse map without an alpha map
+    std::shared_ptr<const DecodedImage> image(const std::string& path, const std::string& alphaPath);
+    // What the backends key a material's texture by, empty for none
+    static std::string textureKey(const std::string& path, const std::string& alphaPath);
+    // Welded on first use, once for all Objects sharing the shapes, dropped once the last of them is destroyed
+    std::shared_ptr<const WeldedModel> geometry(const std::shared_ptr<Object>& model);
+    void clear();
+
+    size_t imageCount() const;
+    size_t modelCount() const;
+
+private:
+    struct CachedModel {
+        std::weak_ptr<const ModelData> owner;   // the address may be reused by a new model once this expires
+        std::shared_ptr<const WeldedModel> welded;
+    };
+
+    mutable std::mutex mMutex;
+    std::unordered_map<std::string, std::shared_ptr<const DecodedImage>> mImages;
+    std::unordered_map<const ModelData*, CachedModel> mModels;
+};
+
+#endif //TOY_RENDERER_RESOURCECACHE_H
@@ -0,0 +1,32 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#ifndef TOY_RENDERER_STATSRECORDER_H
+#define TOY_RENDERER_STATSRECORDER_H
+
+#include "render/render.h"
+#include <filesystem>
+#include <fstream>
+
+// Writes a renderer's culling, API and memory counters once per frame. A .json path gets an array
+// with an object per frame, closed with the recorder, anything else CSV with a header row
+class StatsRecorder {
+public:
+    explicit StatsRecorder(const std::filesystem::path& path);
+    ~StatsRecorder();
+    StatsRecorder(const StatsRecorder&) = delete;
+    StatsRecorder& operator=(const StatsRecorder&) = delete;
+
+    bool isOpen() const { return mFile.is_open(); }
+    // Call after render(), frameMs is whatever the caller measures the frame with
+    void record(uint64_t frame, double frameMs, const Render& render);
+    size_t frames() const { return mFrames; }
+
+private:
+    std::ofstream mFile;
+    bool mJson;
+    size_t mFrames = 0;
+};
+
+#endif //TOY_RENDERER_STATSRECORDER_H
@@ -0,0 +1,122 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#include "render/geometryPool.h"
+#include "scene/mesh.h"
+#include "profiler/profiler.h"
+#include <algorithm>
+
+std::shared_ptr<const WeldedModel> GeometryPool::weld(const Object& model) {
+    TR_PROFILE_ZONE("weld");
+    auto block = std::make_shared<WeldedModel>();
+    auto appendLevel = [&](const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals,
+                           const std::vector<glm::vec2>& texCoords) {
+        WeldedMesh mesh = Mesh::weld(vertices, normals, texCoords);
+        MeshRange range{static_cast<uint32_t>(block->indices.size()), static_cast<uint32_t>(mesh.indices.size()),
+                        static_cast<int32_t>(block->vertices.size())};
+        for (size_t j = 0; j < mesh.positions.size(); ++j) {
+            glm::vec3 normal = j < mesh.normals.size() ? mesh.normals[j] : glm::vec3(0.0f);
+            glm::vec2 tex = j < mesh.texCoords.size() ? mesh.texCoords[j] : glm::vec2(0.0f);
+            if (j < mesh.texCoords.size()) tex.y = 1.0f - tex.y;
+            block->vertices.push_back({mesh.positions[j], normal, tex});
+        }
+        block->indices.insert(block->indices.end(), mesh.indices.begin(), mesh.indices.end());
+        return range;
+    };
+
+    for (size_t i = 0; i < model.getShapeCount(); ++i) {
+        ShapeGeometry shape;
+        shape.lods.push_back(appendLevel(model.getVertices(i), model.getNormals(i), model.getTexCoords(i)));
+        for (size_t level = 1; level < model.getLODCount(i); ++level) {
+            const LODLevel& lod = model.getLOD(i, level);
+            shape.lods.push_back(appendLevel(lod.vertices, lod.normals, lod.texCoords));
+        }
+        // Meshlet indices refer to the same weld as level 0
+        if (const MeshletData* data = model.getMeshlets(i)) {
+            shape.meshletOffset = static_cast<uint32_t>(block->meshlets.size());
+            shape.meshletCount = static_cast<uint32_t>(data->meshlets.size());
+            shape.meshletIndexBase = static_cast<uint32_t>(block->indices.size());
+            block->meshlets.insert(block->meshlets.end(), data->meshlets.begin(), data->meshlets.end());
+            block->indices.insert(block->indices.end(), data->indices.begin(), data->indices.end());
+        }
+        block->shapes.push_back(std::move(shape));
+    }
+    return block;
+}
+
+void GeometryPool::addModel(const std::shared_ptr<Object>& model, std::shared_ptr<const WeldedModel> welded) {
+    Block& block = mBlocks[model->getModelKey()];
+    if (block.users++) return;
+    block.welded = std::move(welded);
+    mOrder.push_back(model->getModelKey());
+    mDirty = true;
+}
+
+void GeometryPool::removeModel(const std::shared_ptr<Object>& model) {
+    auto it = mBlocks.find(model->getModelKey());
+    if (it == mBlocks.end() || --it->second.users) return;
+    mBlocks.erase(it);
+    mOrder.erase(std::find(mOrder.begin(), mOrder.end(), model->getModelKey()));
+    mDirty = true;
+}
+
+void GeometryPool::clear() {
+    mOrder.clear();
+    mBlocks.clear();
+    mShapes.clear();
+    mVertices.clear();
+    mIndices.clear();
+    mMeshlets.clear();
+    mDirty = true;
+}
+
+bool GeometryPool::consumeDirty() {
+    if (!mDirty) return false;
+    rebuild();
+    mDirty = false;
+    return true;
+}
+
+std::vector<glm::vec3> GeometryPool::positions() const {
+    std::vector<glm::vec3> positions(mVertices.size());
+    for (size_t i = 0; i < mVertices.size(); ++i)
+        positions[i] = mVertices[i].position;
+    return positions;
+}
+
+void GeometryPool::rebuild() {
+    mShapes.clear();
+    mVertices.clear();
+    mIndices.clear();
+    mMeshlets.clear();
+    size_t vertexCount = 0, indexCount = 0, meshletCount = 0;
+    for (const ModelData* key : mOrder) {
+        const WeldedModel& block = *mBlocks.at(key).welded;
+        vertexCount += block.vertices.size();
+        indexCount += block.indices.size();
+        meshletCount += block.meshlets.size();
+    }
+    mVertices.reserve(vertexCount);
+    mIndices.reserve(indexCount);
+    mMeshlets.reserve(meshletCount);
+    for (const ModelData* key : mOrder) {
+        const WeldedModel& block = *mBlocks.at(key).welded;
+        auto vertexBase = static_cast<int32_t>(mVertices.size());
+        auto indexBase = static_cast<uint32_t>(mIndices.size());
+        auto meshletBase = static_cast<uint32_t>(mMeshlets.size());
+        std::vector<ShapeGeometry>& shapes = mShapes[key];
+        shapes = block.shapes;
+        for (ShapeGeometry& shape : shapes) {
+            for (MeshRange& range : shape.lods) {
+                range.firstIndex += indexBase;
+                range.vertexOffset += vertexBase;
+            }
+            shape.meshletOffset += meshletBase;
+            shape.meshletIndexBase += indexBase;
+        }
+        mVertices.insert(mVertices.end(), block.vertices.begin(), block.vertices.end());
+        mIndices.insert(mIndices.end(), block.indices.begin(), block.indices.end());
+        mMeshlets.insert(mMeshlets.end(), block.meshlets.begin(), block.meshlets.end());
+    }
+}
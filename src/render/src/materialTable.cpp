@@ -0,0 +1,60 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#include "render/materialTable.h"
+
+namespace {
+
+std::string keyOf(const MaterialTable::Entry& entry) {
+    return {reinterpret_cast<const char*>(&entry), sizeof(entry)};
+}
+
+}
+
+uint32_t MaterialTable::add(const Material& material, uint64_t texture) {
+    Entry entry;
+    entry.diffuse = glm::vec4(material.diffuse, material.alpha);
+    entry.specular = glm::vec4(material.specular, material.shininess);
+    entry.emissive = glm::vec4(material.emissive, 0.0f);
+    entry.texture = glm::uvec2(static_cast<uint32_t>(texture), static_cast<uint32_t>(texture >> 32));
+    entry.alphaMode = static_cast<uint32_t>(material.alphaMode);
+
+    auto [it, inserted] = mLookup.try_emplace(keyOf(entry), 0);
+    if (!inserted) {
+        ++mUsers[it->second];
+        return it->second;
+    }
+    if (mFree.empty()) {
+        it->second = static_cast<uint32_t>(mEntries.size());
+        mEntries.push_back(entry);
+        mUsers.push_back(1);
+    } else {
+        it->second = mFree.back();
+        mFree.pop_back();
+        mEntries[it->second] = entry;
+        mUsers[it->second] = 1;
+    }
+    mDirty = true;
+    return it->second;
+}
+
+void MaterialTable::release(uint32_t index) {
+    if (--mUsers[index]) return;
+    mLookup.erase(keyOf(mEntries[index]));
+    mFree.push_back(index);
+}
+
+void MaterialTable::clear() {
+    mEntries.clear();
+    mUsers.clear();
+    mFree.clear();
+    mLookup.clear();
+    mDirty = true;
+}
+
+bool MaterialTable::consumeDirty() {
+    bool dirty = mDirty;
+    mDirty = false;
+    return dirty;
+}
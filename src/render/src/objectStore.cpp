@@ -0,0 +1,155 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#include "render/objectStore.h"
+
+namespace {
+
+template<typename T>
+void eraseRange(std::vector<T>& column, size_t first, size_t count) {
+    column.erase(column.begin() + first, column.begin() + first + count);
+}
+
+}
+
+ObjectHandle ObjectStore::add(const std::shared_ptr<Object>& model) {
+    if (ObjectHandle existing = find(model.get()); valid(existing)) return existing;
+
+    uint32_t slot;
+    if (!mFreeSlots.empty()) {
+        slot = mFreeSlots.back();
+        mFreeSlots.pop_back();
+    } else {
+        slot = static_cast<uint32_t>(mSlots.size());
+        mSlots.emplace_back();
+    }
+    auto index = static_cast<uint32_t>(mObjects.size());
+    mSlots[slot].object = index;
+    ObjectHandle handle{slot, mSlots[slot].generation};
+    mLookup[model.get()] = handle;
+
+    auto firstShape = static_cast<uint32_t>(mOwner.size());
+    auto shapeCount = static_cast<uint32_t>(model->getShapeCount());
+    mObjects.push_back(model);
+    mSlotOf.push_back(slot);
+    mWorld.push_back(model->getModelMatrix());
+    mObjectBounds.push_back(model->getBounds());
+    mFirstShape.push_back(firstShape);
+    mShapeCount.push_back(shapeCount);
+
+    for (uint32_t i = 0; i < shapeCount; ++i) {
+        mOwner.push_back(index);
+        mShapeBounds.push_back(model->getShapeBounds(i));
+        mShapeSpheres.push_back(model->getShapeBoundingSphere(i));
+        mLODCount.push_back(static_cast<uint32_t>(model->getLODCount(i)));
+        mAlphaMode.push_back(model->getMaterial(i).alphaMode);
+        mDraws.emplace_back();
+        mTexture.push_back(0);
+        mMaterial.push_back(0);
+        mQuery.push_back(none);
+        mQueryPending.push_back(0);
+        mOccluded.push_back(0);
+    }
+    mNeedsGeometry = true;
+    return handle;
+}
+
+void ObjectStore::remove(ObjectHandle handle) {
+    if (!valid(handle)) return;
+    uint32_t index = mSlots[handle.index].object;
+    uint32_t firstShape = mFirstShape[index];
+    uint32_t shapeCount = mShapeCount[index];
+
+    mLookup.erase(mObjects[index].get());
+    mSlots[handle.index].object = none;
+    ++mSlots[handle.index].generation;
+    mFreeSlots.push_back(handle.index);
+
+    eraseRange(mObjects, index, 1);
+    eraseRange(mSlotOf, index, 1);
+    eraseRange(mWorld, index, 1);
+    eraseRange(mObjectBounds, index, 1);
+    eraseRange(mFirstShape, index, 1);
+    eraseRange(mShapeCount, index, 1);
+    for (uint32_t i = index; i < mObjects.size(); ++i) {
+        --mSlots[mSlotOf[i]].object;
+        mFirstShape[i] -= shapeCount;
+    }
+
+    eraseRange(mOwner, firstShape, shapeCount);
+    eraseRange(mShapeBounds, firstShape, shapeCount);
+    eraseRange(mShapeSpheres, firstShape, shapeCount);
+    eraseRange(mLODCount, firstShape, shapeCount);
+    eraseRange(mAlphaMode, firstShape, shapeCount);
+    eraseRange(mDraws, firstShape, shapeCount);
+    eraseRange(mTexture, firstShape, shapeCount);
+    eraseRange(mMaterial, firstShape, shapeCount);
+    eraseRange(mQuery, firstShape, shapeCount);
+    eraseRange(mQueryPending, firstShape, shapeCount);
+    eraseRange(mOccluded, firstShape, shapeCount);
+    for (uint32_t s = firstShape; s < mOwner.size(); ++s) --mOwner[s];
+}
+
+void ObjectStore::clear() {
+    // Generations survive, handles from before the clear stay invalid
+    mFreeSlots.clear();
+    for (uint32_t slot = 0; slot < mSlots.size(); ++slot) {
+        if (mSlots[slot].object != none) {
+            mSlots[slot].object = none;
+            ++mSlots[slot].generation;
+        }
+        mFreeSlots.push_back(slot);
+    }
+    mLookup.clear();
+    mObjects.clear();
+    mSlotOf.clear();
+    mWorld.clear();
+    mObjectBounds.clear();
+    mFirstShape.clear();
+    mShapeCount.clear();
+    mOwner.clear();
+    mShapeBounds.clear();
+    mShapeSpheres.clear();
+    mLODCount.clear();
+    mAlphaMode.clear();
+    mDraws.clear();
+    mRanges.clear();
+    mTexture.clear();
+    mMaterial.clear();
+    mQuery.clear();
+    mQueryPending.clear();
+    mOccluded.clear();
+    mNeedsGeometry = false;
+}
+
+ObjectHandle ObjectStore::find(const Object* model) const {
+    auto it = mLookup.find(model);
+    return it == mLookup.end() ? ObjectHandle{} : it->second;
+}
+
+void ObjectStore::syncTransforms() {
+    for (size_t i = 0; i < mObjects.size(); ++i)
+        mWorld[i] = mObjects[i]->getModelMatrix();
+}
+
+void ObjectStore::setGeometry(const GeometryPool::ShapeTable& table) {
+    mNeedsGeometry = false;
+    mRanges.clear();
+    for (uint32_t i = 0; i < mObjects.size(); ++i) {
+        auto it = table.find(mObjects[i]->getModelKey());
+        for (uint32_t j = 0; j < mShapeCount[i]; ++j) {
+            ShapeDraw& draw = mDraws[mFirstShape[i] + j];
+            if (it == table.end() || j >= it->second.size()) {
+                draw = {};
+                continue;
+            }
+            const ShapeGeometry& shape = it->second[j];
+            draw.firstRange = static_cast<uint32_t>(mRanges.size());
+            draw.meshletOffset = shape.meshletOffset;
+            draw.meshletCount = shape.meshletCount;
+            draw.meshletIndexBase = shape.meshletIndexBase;
+            mRanges.insert(mRanges.end(), shape.lods.begin(), shape.lods.end());
+        }
+    }
+}
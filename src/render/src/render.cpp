@@ -0,0 +1,91 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#include "render/render.h"
+#include "profiler/profiler.h"
+#include <algorithm>
+#include <cmath>
+
+std::vector<DrawItem> Render::collectDrawItems(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
+{
+    TR_PROFILE_ZONE("cull");
+    mFrustum.update(projectionMatrix * viewMatrix);
+    mCameraPosition = glm::vec3(glm::inverse(viewMatrix)[3]);
+    mCullingStats = {};
+    mStore.syncTransforms();
+
+    auto visible = [this](const AABB& world) {
+        return !mFrustumCulling || !world.valid() || mFrustum.intersectsAABB(world.center(), world.extent());
+    };
+
+    std::vector<DrawItem> items;
+    items.reserve(mStore.shapeCount());
+    for (uint32_t i = 0; i < mStore.objectCount(); ++i) {
+        const glm::mat4& modelMatrix = mStore.world(i);
+        uint32_t firstShape = mStore.firstShape(i);
+        uint32_t shapeCount = mStore.shapeCount(i);
+        if (!visible(mStore.objectBounds(i).transformed(modelMatrix))) {
+            ++mCullingStats.culledObjects;
+            mCullingStats.culledShapes += shapeCount;
+            continue;
+        }
+        ++mCullingStats.drawnObjects;
+        for (uint32_t s = firstShape; s < firstShape + shapeCount; ++s) {
+            AABB world = mStore.shapeBounds(s).transformed(modelMatrix);
+            if (!visible(world)) {
+                ++mCullingStats.culledShapes;
+                continue;
+            }
+            float distance = 0.0f;
+            if (world.valid()) {
+                glm::vec3 d = glm::max(glm::max(world.min - mCameraPosition, mCameraPosition - world.max), glm::vec3(0.0f));
+                distance = glm::dot(d, d);
+            }
+            uint32_t lod = selectLOD(mStore.shapeSphere(s).transformed(modelMatrix), mStore.lodCount(s), projectionMatrix);
+            items.push_back({i, s, world, distance, lod});
+        }
+    }
+    mCullingStats.drawnShapes = static_cast<uint32_t>(items.size());
+
+    if (mOcclusionCulling || mFrontToBack) {
+        std::sort(items.begin(), items.end(), [](const DrawItem& a, const DrawItem& b) {
+            return a.distance < b.distance;
+        });
+    }
+    return items;
+}
+
+bool Render::cameraInside(const AABB& bounds) const {
+    if (!bounds.valid()) return true;
+    // Grow by a little more than the default near plane so the box is never clipped in front of the camera
+    glm::vec3 margin = bounds.extent() * 0.05f + glm::vec3(0.2f);
+    return glm::all(glm::greaterThanEqual(mCameraPosition, bounds.min - margin)) &&
+           glm::all(glm::lessThanEqual(mCameraPosition, bounds.max + margin));
+}
+
+uint32_t Render::selectLOD(const BoundingSphere& worldSphere, size_t lodCount, const glm::mat4& projectionMatrix) const {
+    if (!mLODEnabled || lodCount <= 1) return 0;
+    // proj[1][1] maps view space y to NDC, an ortho projection has no w from z
+    float scale = std::abs(projectionMatrix[1][1]);
+    float size = worldSphere.radius * scale;
+    if (projectionMatrix[2][3] != 0.0f) {
+        float distance = glm::length(worldSphere.center - mCameraPosition);
+        if (distance <= worldSphere.radius) return 0;
+        size /= distance;
+    }
+    // Each level has about half the triangles of the previous one, so halve the size threshold per level
+    float threshold = 0.25f / std::max(mLODBias, 0.01f);
+    uint32_t level = 0;
+    while (level + 1 < lodCount && size < threshold) {
+        ++level;
+        threshold *= 0.5f;
+    }
+    return level;
+}
+
+uint32_t Render::drawPipeline(uint32_t shader, AlphaMode mode) {
+    if (mode == AlphaMode::Mask) ++mRenderStats.maskedShapes;
+    if (mode == AlphaMode::Blend) ++mRenderStats.blendedShapes;
+    return (static_cast<uint32_t>(mode) << 4) | shader;
+}
@@ -0,0 +1,80 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#include "render/renderQueue.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <future>
+#include <thread>
+
+uint32_t RenderQueue::depthOrder(float distance) {
+    return std::bit_cast<uint32_t>(std::max(distance, 0.0f));
+}
+
+void RenderQueue::clear() {
+    mEntries.clear();
+    mUnsortedChanges = 0;
+    mSortedChanges = 0;
+}
+
+void RenderQueue::push(uint64_t key, uint32_t item) {
+    if (mEntries.empty() || state(mEntries.back().key) != state(key)) ++mUnsortedChanges;
+    mEntries.push_back({key, item});
+}
+
+namespace {
+
+// f(0) .. f(count - 1) each on their own thread, the caller's thread takes the first
+template<typename F>
+void forEachChunk(size_t count, const F& f) {
+    std::vector<std::future<void>> workers;
+    for (size_t c = 1; c < count; ++c) {
+        workers.push_back(std::async(std::launch::async, [&f, c] { f(c); }));
+    }
+    f(0);
+    for (auto& w : workers) w.get();
+}
+
+}
+
+void RenderQueue::sort(size_t parallelFrom) {
+    // Least significant byte first, each pass stable. Bytes every key shares are skipped,
+    // with one pipeline and a few materials most of the top half is.
+    // Large queues split into one contiguous chunk per thread: every chunk counts its own bytes,
+    // then scatters behind the same bucket of the chunks before it, which keeps the pass stable
+    const size_t n = mEntries.size();
+    const size_t chunkCount = n < parallelFrom ? 1 :
+        std::max<size_t>(1, std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), n));
+    auto chunkBegin = [&](size_t c) { return n * c / chunkCount; };
+    std::vector<std::array<uint32_t, 256>> offsets(chunkCount);
+    mScratch.resize(n);
+    for (uint32_t shift = 0; shift < 64; shift += 8) {
+        forEachChunk(chunkCount, [&](size_t c) {
+            offsets[c].fill(0);
+            for (size_t i = chunkBegin(c); i < chunkBegin(c + 1); ++i) ++offsets[c][(mEntries[i].key >> shift) & 0xffu];
+        });
+        bool shared = false;
+        uint32_t sum = 0;
+        for (uint32_t bucket = 0; bucket < 256 && !shared; ++bucket) {
+            const uint32_t bucketBegin = sum;
+            for (auto& chunk : offsets) {
+                uint32_t count = chunk[bucket];
+                chunk[bucket] = sum;
+                sum += count;
+            }
+            shared = sum - bucketBegin == n;
+        }
+        if (shared) continue;
+        forEachChunk(chunkCount, [&](size_t c) {
+            for (size_t i = chunkBegin(c); i < chunkBegin(c + 1); ++i)
+                mScratch[offsets[c][(mEntries[i].key >> shift) & 0xffu]++] = mEntries[i];
+        });
+        mEntries.swap(mScratch);
+    }
+
+    mSortedChanges = 0;
+    for (size_t i = 0; i < mEntries.size(); ++i)
+        if (i == 0 || state(mEntries[i - 1].key) != state(mEntries[i].key)) ++mSortedChanges;
+}
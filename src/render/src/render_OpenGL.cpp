@@ -3,9 +3,37 @@
 //
 
 #include "render/render_OpenGL.h"
+#include "profiler/profiler.h"
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+
+// ARB_bindless_texture, loaded by hand so the build does not depend on glad being generated with it
+namespace {
+    using PFNGETTEXTUREHANDLE = GLuint64 (APIENTRY*)(GLuint texture);
+    using PFNMAKETEXTUREHANDLERESIDENT = void (APIENTRY*)(GLuint64 handle);
+    PFNGETTEXTUREHANDLE getTextureHandle = nullptr;
+    PFNMAKETEXTUREHANDLERESIDENT makeTextureHandleResident = nullptr;
+    PFNMAKETEXTUREHANDLERESIDENT makeTextureHandleNonResident = nullptr;
+
+    bool loadBindlessTexture()
+    {
+        GLint extensionCount = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        bool found = false;
+        for (GLint i = 0; i < extensionCount && !found; ++i)
+            found = !std::strcmp(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)), "GL_ARB_bindless_texture");
+        if (!found) return false;
+        getTextureHandle = reinterpret_cast<PFNGETTEXTUREHANDLE>(glfwGetProcAddress("glGetTextureHandleARB"));
+        makeTextureHandleResident = reinterpret_cast<PFNMAKETEXTUREHANDLERESIDENT>(glfwGetProcAddress("glMakeTextureHandleResidentARB"));
+        makeTextureHandleNonResident = reinterpret_cast<PFNMAKETEXTUREHANDLERESIDENT>(glfwGetProcAddress("glMakeTextureHandleNonResidentARB"));
+        return getTextureHandle && makeTextureHandleResident && makeTextureHandleNonResident;
+    }
+}
 
 void Render_OpenGL::init()
 {
@@ -21,6 +49,22 @@ void Render_OpenGL::init()
         "./assets/shaders/Blinn-Phong.vert",
         "./assets/shaders/Blinn-Phong.frag"
         );
+    mShaders[SHADER_TYPE::OCCLUSION_PROXY] = std::make_shared<shaderOpenGL>(
+        "./assets/shaders/occlusion.vert",
+        "./assets/shaders/occlusion.frag"
+        );
+    mShaders[SHADER_TYPE::DEPTH_PREPASS] = std::make_shared<shaderOpenGL>(
+        "./assets/shaders/depth_prepass.vert",
+        "./assets/shaders/depth_prepass.frag"
+        );
+    // Without the extension draws stay batched by texture
+    mBindlessSupported = loadBindlessTexture();
+    if (mBindlessSupported) {
+        mShaders[SHADER_TYPE::MATERIAL_BINDLESS] = std::make_shared<shaderOpenGL>(
+            "./assets/shaders/material_bindless.vert",
+            "./assets/shaders/material_bindless.frag"
+            );
+    }
     for(auto & shader : mShaders)
     {
         shader.second->init();
@@ -31,164 +75,577 @@ void Render_OpenGL::init()
 
 void Render_OpenGL::render(const std::shared_ptr<Scene>& scene, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
 {
+    beginSceneTarget();
     glClearColor(0.00f, 0.00f, 0.00f, 1.00f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glPolygonMode(GL_FRONT_AND_BACK, mCurrentShader.first == SHADER_TYPE::WIREFRAME ? GL_LINE : GL_FILL);
     glLineWidth(1.0f);
+    readGpuTimers();
 
-    auto shader = mCurrentShader.second;
-    shader->use();
-
-    shader->setMat4("view", viewMatrix);
-    shader->setMat4("projection", projectionMatrix);
-
-    auto models = scene->getModels();
-    for (const auto& model : models) {
-        shader->setMat4("model", model->getModelMatrix());
-        const OpenGLModelResources& resources = mModelResources.at(model);
-        size_t shapeCount = model->getShapeCount();
-        for (size_t i = 0; i < shapeCount; ++i) {
-            glBindVertexArray(resources.VAOs[i]);
-            shader->setBool("hasTexture", resources.textures[i] != 0);
-            if (resources.textures[i]) {
-                // Use GL_TETURE0 all the time
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, resources.textures[i]);
-                shader->setInt("textureDiffuse", 0);
-            }
+    std::vector<DrawItem> items = collectDrawItems(viewMatrix, projectionMatrix);
+
+    readOcclusionResults();
+    if (!mOcclusionCulling && mHasOcclusionState) {
+        for (uint32_t s = 0; s < mStore.shapeCount(); ++s)
+            mStore.occluded(s) = 0;
+        mHasOcclusionState = false;
+    }
+
+    uploadGeometry();
+    buildDrawList(items);
 
-            glDrawArrays(GL_TRIANGLES, 0, resources.vertexCounts[i]);
-            glBindVertexArray(0);
+    auto shader = mBindless ? mShaders[SHADER_TYPE::MATERIAL_BINDLESS] : mCurrentShader.second;
+    if (!mBatches.empty()) {
+        TR_PROFILE_ZONE("draw");
+        reserveDraws(mDrawModels.size());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, mDrawData);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, mDrawModels.size() * sizeof(glm::mat4), mDrawModels.data());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mDrawData);
+        countUpload(mDrawModels.size() * sizeof(glm::mat4));
+        ++mRenderStats.descriptorBinds;
+        if (!mDrawMaterials.empty()) {
+            uploadMaterials();
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, mDrawMaterialData);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, mDrawMaterials.size() * sizeof(uint32_t), mDrawMaterials.data());
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mDrawMaterialData);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mMaterialData);
+            countUpload(mDrawMaterials.size() * sizeof(uint32_t));
+            mRenderStats.descriptorBinds += 2;
         }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mDrawCommands);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, mCommands.size() * sizeof(DrawElementsIndirectCommand), mCommands.data());
+        countUpload(mCommands.size() * sizeof(DrawElementsIndirectCommand));
+
+        // Lines don't hide anything. Alpha-tested and blended shapes have holes, they keep out of it
+        GLsizei opaqueCommands = 0;
+        for (const auto& batch : mBatches)
+            if (batch.alphaMode == AlphaMode::Opaque) opaqueCommands += static_cast<GLsizei>(batch.commandCount);
+        const bool prepass = mDepthPrepass && mCurrentShader.first != SHADER_TYPE::WIREFRAME && opaqueCommands;
+        if (prepass) {
+            beginGpuZone(GPU_ZONE_PREPASS);
+            auto depth = mShaders[SHADER_TYPE::DEPTH_PREPASS];
+            depth->use();
+            ++mRenderStats.pipelineBinds;
+            depth->setMat4("view", viewMatrix);
+            depth->setMat4("projection", projectionMatrix);
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            // Batches are consecutive commands, all the opaque ones go in one call
+            glBindVertexArray(mDepthVAO);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, opaqueCommands, 0);
+            ++mCullingStats.drawCalls;
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            // Only the nearest surface passes, its depth is already in
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(GL_FALSE);
+            endGpuZone();
+        }
+
+        beginGpuZone(GPU_ZONE_SCENE);
+        shader->use();
+        ++mRenderStats.pipelineBinds;
+        shader->setMat4("view", viewMatrix);
+        shader->setMat4("projection", projectionMatrix);
+        GpuTimers& slot = mGpuTimers[mGpuTimerSlot];
+        if (!slot.samples) glGenQueries(1, &slot.samples);
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        slot.pixels = static_cast<uint64_t>(viewport[2]) * static_cast<uint64_t>(viewport[3]);
+        glBeginQuery(GL_SAMPLES_PASSED, slot.samples);
+        glBindVertexArray(mVAO);
+        // Use GL_TETURE0 all the time, uniforms only change between batches that differ in them
+        shader->setInt("textureDiffuse", 0);
+        glActiveTexture(GL_TEXTURE0);
+        int hasTexture = -1;
+        AlphaMode mode = AlphaMode::Opaque;
+        for (const auto& batch : mBatches) {
+            if (mode != batch.alphaMode) {
+                // Past the pre-pass's shapes, the rest test depth as usual. Blended ones only test it
+                if (prepass && mode == AlphaMode::Opaque) {
+                    glDepthFunc(mReverseZ ? GL_GREATER : GL_LESS);
+                    glDepthMask(GL_TRUE);
+                }
+                if (batch.alphaMode == AlphaMode::Blend) {
+                    glEnable(GL_BLEND);
+                    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                    glDepthMask(GL_FALSE);
+                }
+                mode = batch.alphaMode;
+            }
+            if (hasTexture != (batch.texture != 0)) {
+                hasTexture = batch.texture != 0;
+                shader->setBool("hasTexture", hasTexture);
+            }
+            if (batch.texture) {
+                glBindTexture(GL_TEXTURE_2D, batch.texture);
+                ++mRenderStats.textureBinds;
+            }
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                        reinterpret_cast<const void*>(batch.firstCommand * sizeof(DrawElementsIndirectCommand)),
+                                        batch.commandCount, 0);
+            ++mCullingStats.drawCalls;
+        }
+        glEndQuery(GL_SAMPLES_PASSED);
+        glBindVertexArray(0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        if (prepass && mode == AlphaMode::Opaque) glDepthFunc(mReverseZ ? GL_GREATER : GL_LESS);
+        if (mode == AlphaMode::Blend) glDisable(GL_BLEND);
+        if (prepass || mode == AlphaMode::Blend) glDepthMask(GL_TRUE);
+        endGpuZone();
     }
+
+    if (mOcclusionCulling) {
+        beginGpuZone(GPU_ZONE_OCCLUSION);
+        renderOcclusionProxies(items, projectionMatrix * viewMatrix);
+        endGpuZone();
+        mHasOcclusionState = true;
+    }
+    endSceneTarget();
+    mGpuTimerSlot = (mGpuTimerSlot + 1) % gpuTimerFrames;
+    finishFrameStats();
 }
 
-Render_OpenGL::~Render_OpenGL() {
-    Render_OpenGL::cleanup();
-    for (auto& shader : mShaders) {
-        shader.second->cleanup();
+void Render_OpenGL::beginSceneTarget()
+{
+    if (!mReverseZ) {
+        if (mSceneFramebuffer) deleteSceneTarget();
+        return;
+    }
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    const GLint width = std::max(1, viewport[2]), height = std::max(1, viewport[3]);
+    if (!mSceneFramebuffer || width != mSceneSize[0] || height != mSceneSize[1]) {
+        deleteSceneTarget();
+        mSceneSize[0] = width;
+        mSceneSize[1] = height;
+        glGenFramebuffers(1, &mSceneFramebuffer);
+        glGenRenderbuffers(2, mSceneTargets);
+        glBindRenderbuffer(GL_RENDERBUFFER, mSceneTargets[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, mSceneTargets[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, mSceneFramebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mSceneTargets[0]);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mSceneTargets[1]);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "Reverse-Z framebuffer incomplete" << std::endl;
     }
+    glBindFramebuffer(GL_FRAMEBUFFER, mSceneFramebuffer);
+    // Depth 0 to 1 straight from the projection, so the float keeps its precision far away
+    glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+    glClearDepth(0.0);
+    glDepthFunc(GL_GREATER);
 }
 
-void Render_OpenGL::cleanup() {
-    for (auto& model : mModelResources) {
-        auto& resources = model.second;
-        for (auto& vao : resources.VAOs) {
-            glDeleteVertexArrays(1, &vao);
+void Render_OpenGL::endSceneTarget()
+{
+    if (!mSceneFramebuffer) return;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, mSceneFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, mSceneSize[0], mSceneSize[1], 0, 0, mSceneSize[0], mSceneSize[1],
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // Defaults again for whatever draws to the window next
+    glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+    glClearDepth(1.0);
+    glDepthFunc(GL_LESS);
+}
+
+void Render_OpenGL::deleteSceneTarget()
+{
+    if (!mSceneFramebuffer) return;
+    glDeleteFramebuffers(1, &mSceneFramebuffer);
+    glDeleteRenderbuffers(2, mSceneTargets);
+    mSceneFramebuffer = 0;
+    mSceneTargets[0] = mSceneTargets[1] = 0;
+}
+
+void Render_OpenGL::beginGpuZone(GpuZone zone)
+{
+    if (!mGpuTiming) return;
+    GpuTimers& timers = mGpuTimers[mGpuTimerSlot];
+    if (!timers.queries[0]) glGenQueries(GPU_ZONE_COUNT, timers.queries);
+    timers.frame = Profiler::get().frameIndex();
+    timers.issued |= 1u << zone;
+    glBeginQuery(GL_TIME_ELAPSED, timers.queries[zone]);
+}
+
+void Render_OpenGL::endGpuZone()
+{
+    if (mGpuTiming) glEndQuery(GL_TIME_ELAPSED);
+}
+
+void Render_OpenGL::readGpuTimers()
+{
+    static const char* const names[GPU_ZONE_COUNT] = { "depth pre-pass", "scene", "occlusion proxies" };
+    // This slot is about to be reused, whatever it timed gpuTimerFrames ago is done or dropped
+    GpuTimers& timers = mGpuTimers[mGpuTimerSlot];
+    if (timers.pixels) {
+        GLuint available = 0;
+        glGetQueryObjectuiv(timers.samples, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 samples = 0;
+            glGetQueryObjectui64v(timers.samples, GL_QUERY_RESULT, &samples);
+            mRenderStats.shadedSamples = samples;
+            mRenderStats.targetPixels = timers.pixels;
         }
-        for (auto& vbo : resources.VBOs) {
-            glDeleteBuffers(1, &vbo);
+        timers.pixels = 0;
+    }
+    uint64_t offset = 0;
+    for (uint32_t zone = 0; zone < GPU_ZONE_COUNT; ++zone) {
+        if (!(timers.issued & (1u << zone))) continue;
+        GLuint available = 0;
+        glGetQueryObjectuiv(timers.queries[zone], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) break;
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(timers.queries[zone], GL_QUERY_RESULT, &elapsed);
+        Profiler::get().recordGpu(timers.frame, names[zone], offset, elapsed);
+        offset += elapsed;
+    }
+    timers.issued = 0;
+    timers.frame = 0;
+    mGpuTiming = Profiler::get().enabled();
+}
+
+void Render_OpenGL::buildDrawList(const std::vector<DrawItem>& items)
+{
+    TR_PROFILE_ZONE("build draw list");
+    mDrawModels.clear();
+    mDrawMaterials.clear();
+    mCommands.clear();
+    mBatches.clear();
+
+    // Only the material shader samples textures, and it needs one batch per texture unless it reads them bindless.
+    // Every other shader draws the whole scene in one batch
+    mBindless = mBindlessTextures && mBindlessSupported && mCurrentShader.first == SHADER_TYPE::MATERIAL;
+    const bool materials = mCurrentShader.first == SHADER_TYPE::MATERIAL;
+    const bool perTexture = materials && !mBindless;
+
+    // Keyed by alpha mode and shader, texture, then by distance near to far or by mesh so repeated objects
+    // become instances of one command. Textures are numbered as they first show up, batches then follow their
+    // nearest shape. Blended shapes ignore the texture and go far to near, batches split where it changes
+    const bool nearToFar = mOcclusionCulling || mFrontToBack;
+    const auto pipeline = static_cast<uint32_t>(mBindless ? SHADER_TYPE::MATERIAL_BINDLESS : mCurrentShader.first);
+    mQueue.clear();
+    std::unordered_map<GLuint, uint32_t> groups;
+    // Blended keys leave the texture out, so the queue misses switches between consecutive blended draws
+    uint32_t blendSwitches = 0;
+    std::optional<GLuint> blendTexture;
+    for (size_t k = 0; k < items.size(); ++k) {
+        const DrawItem& item = items[k];
+        if (mOcclusionCulling && mStore.occluded(item.shape)) {
+            if (!cameraInside(item.bounds)) {
+                --mCullingStats.drawnShapes;
+                ++mCullingStats.occludedShapes;
+                continue;
+            }
+            mStore.occluded(item.shape) = 0;
+        }
+        const AlphaMode mode = materials ? mStore.alphaMode(item.shape) : AlphaMode::Opaque;
+        const uint32_t alphaPipeline = drawPipeline(pipeline, mode);
+        GLuint texture = perTexture ? mStore.texture(item.shape) : 0;
+        if (mode == AlphaMode::Blend) {
+            if (blendTexture && *blendTexture != texture) ++blendSwitches;
+            blendTexture = texture;
+            mQueue.push(RenderQueue::makeKey(alphaPipeline, 0, blendOrder(item.bounds)), static_cast<uint32_t>(k));
+            continue;
         }
-        for (auto& texture : resources.textures) {
-            glDeleteTextures(1, &texture);
+        blendTexture.reset();
+        uint32_t group = groups.try_emplace(texture, static_cast<uint32_t>(groups.size())).first->second;
+        uint32_t order = nearToFar ? RenderQueue::depthOrder(item.distance) : mStore.range(item.shape, item.lod).firstIndex;
+        mQueue.push(RenderQueue::makeKey(alphaPipeline, group, order), static_cast<uint32_t>(k));
+    }
+    mQueue.sort();
+    mRenderStats.unsortedStateChanges = mQueue.unsortedStateChanges() + blendSwitches;
+    mRenderStats.sortedStateChanges = mQueue.sortedStateChanges();
+
+    for (const auto& entry : mQueue.entries()) {
+        const DrawItem& item = items[entry.item];
+        GLuint texture = perTexture ? mStore.texture(item.shape) : 0;
+        const AlphaMode mode = materials ? mStore.alphaMode(item.shape) : AlphaMode::Opaque;
+        const MeshRange& range = mStore.range(item.shape, item.lod);
+        if (mBatches.empty() || mBatches.back().texture != texture || mBatches.back().alphaMode != mode) {
+            if (!mBatches.empty() && mBatches.back().alphaMode == AlphaMode::Blend && mode == AlphaMode::Blend)
+                ++mRenderStats.sortedStateChanges;
+            mBatches.push_back({texture, mode, static_cast<uint32_t>(mCommands.size()), 0});
+        }
+        auto drawIndex = static_cast<uint32_t>(mDrawModels.size());
+        mDrawModels.push_back(mStore.world(item.object));
+        if (materials) mDrawMaterials.push_back(mStore.material(item.shape));
+        mCullingStats.drawnTriangles += range.indexCount / 3;
+        mCullingStats.drawnVertices += range.indexCount;
+        // Matrices of one command's instances are consecutive, baseInstance picks the first
+        if (mBatches.back().commandCount) {
+            DrawElementsIndirectCommand& last = mCommands.back();
+            if (last.firstIndex == range.firstIndex && last.count == range.indexCount && last.baseVertex == range.vertexOffset) {
+                ++last.instanceCount;
+                ++mCullingStats.instancedShapes;
+                continue;
+            }
         }
+        mCommands.push_back({range.indexCount, 1, range.firstIndex, range.vertexOffset, drawIndex});
+        ++mBatches.back().commandCount;
     }
-    mModelResources.clear();
 }
 
-void Render_OpenGL::setup(const std::shared_ptr<Scene> &scene) {
-    cleanup();
-    for (const auto& model : scene->getModels()) {
-        addModel(model);
+void Render_OpenGL::uploadGeometry()
+{
+    TR_PROFILE_ZONE("upload geometry");
+    bool dirty = mGeometry.consumeDirty();
+    if (dirty || mStore.needsGeometry()) mStore.setGeometry(mGeometry.shapeTable());
+    if (!dirty) return;
+    if (!mVAO) {
+        glGenVertexArrays(1, &mVAO);
+        glGenBuffers(1, &mVBO);
+        glGenBuffers(1, &mEBO);
+        glGenBuffers(1, &mDrawIDs);
+        glGenBuffers(1, &mDrawData);
+        glGenBuffers(1, &mDrawCommands);
+        glGenBuffers(1, &mDrawMaterialData);
+        glGenBuffers(1, &mMaterialData);
+
+        glBindVertexArray(mVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GeometryVertex), (void*)offsetof(GeometryVertex, position));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(GeometryVertex), (void*)offsetof(GeometryVertex, normal));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(GeometryVertex), (void*)offsetof(GeometryVertex, texCoord));
+        glEnableVertexAttribArray(2);
+        glBindBuffer(GL_ARRAY_BUFFER, mDrawIDs);
+        glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(uint32_t), nullptr);
+        glVertexAttribDivisor(3, 1);
+        glEnableVertexAttribArray(3);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+
+        glGenVertexArrays(1, &mDepthVAO);
+        glGenBuffers(1, &mPositionVBO);
+        glBindVertexArray(mDepthVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, mPositionVBO);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), nullptr);
+        glEnableVertexAttribArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, mDrawIDs);
+        glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(uint32_t), nullptr);
+        glVertexAttribDivisor(3, 1);
+        glEnableVertexAttribArray(3);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
+
+    const auto& vertices = mGeometry.vertices();
+    const auto& indices = mGeometry.indices();
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GeometryVertex), vertices.data(), GL_STATIC_DRAW);
+    const std::vector<glm::vec3> positions = mGeometry.positions();
+    glBindBuffer(GL_ARRAY_BUFFER, mPositionVBO);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // The element binding is VAO state
+    glBindVertexArray(mVAO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    countUpload(vertices.size() * sizeof(GeometryVertex));
+    countUpload(positions.size() * sizeof(glm::vec3));
+    countUpload(indices.size() * sizeof(uint32_t));
+    mMemoryStats.geometry = vertices.size() * sizeof(GeometryVertex) + positions.size() * sizeof(glm::vec3) +
+                            indices.size() * sizeof(uint32_t);
 }
 
-void Render_OpenGL::addModel(const std::shared_ptr<Object> &model) {
-    size_t shapeCount = model->getShapeCount();
-    OpenGLModelResources resources;
-    resources.VAOs.resize(shapeCount);
-    resources.VBOs.resize(shapeCount);
-    resources.textures.resize(shapeCount);
-    resources.vertexCounts.resize(shapeCount);
+void Render_OpenGL::reserveDraws(size_t drawCount)
+{
+    if (drawCount <= mDrawCapacity) return;
+    mDrawCapacity = std::max<size_t>(drawCount, std::max<size_t>(mDrawCapacity * 2, 256));
 
-    glGenVertexArrays(shapeCount, resources.VAOs.data());
-    glGenBuffers(shapeCount, resources.VBOs.data());
+    std::vector<uint32_t> drawIDs(mDrawCapacity);
+    for (uint32_t i = 0; i < drawIDs.size(); ++i) drawIDs[i] = i;
+    glBindBuffer(GL_ARRAY_BUFFER, mDrawIDs);
+    glBufferData(GL_ARRAY_BUFFER, drawIDs.size() * sizeof(uint32_t), drawIDs.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mDrawData);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, mDrawCapacity * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mDrawMaterialData);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, mDrawCapacity * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mDrawCommands);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, mDrawCapacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    countUpload(drawIDs.size() * sizeof(uint32_t));
+    mMemoryStats.drawData = mDrawCapacity * (sizeof(uint32_t) + sizeof(glm::mat4) + sizeof(uint32_t) + sizeof(DrawElementsIndirectCommand)) +
+                            mMaterialCapacity * sizeof(MaterialTable::Entry);
+}
 
-    for(size_t i = 0; i < shapeCount; ++i)
-    {
-        const std::vector<glm::vec3>& vertices = model->getVertices(i);
-        const std::vector<glm::vec3>& normals = model->getNormals(i);
-        const std::vector<glm::vec2>& texCoords = model->getTexCoords(i);
-        const std::string& texturePath = model->getTexturePath(i);
-
-        std::vector<float> buffer;
-        for(size_t j = 0; j < vertices.size(); ++j)
-        {
-            buffer.push_back(vertices[j].x);
-            buffer.push_back(vertices[j].y);
-            buffer.push_back(vertices[j].z);
-
-            if(!normals.empty())
-            {
-                buffer.push_back(normals[j].x);
-                buffer.push_back(normals[j].y);
-                buffer.push_back(normals[j].z);
-            }
+void Render_OpenGL::uploadMaterials()
+{
+    if (!mMaterials.consumeDirty()) return;
+    const auto& entries = mMaterials.entries();
+    if (entries.empty()) return;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mMaterialData);
+    if (entries.size() > mMaterialCapacity) {
+        mMemoryStats.drawData -= mMaterialCapacity * sizeof(MaterialTable::Entry);
+        mMaterialCapacity = std::max<size_t>(entries.size(), std::max<size_t>(mMaterialCapacity * 2, 64));
+        glBufferData(GL_SHADER_STORAGE_BUFFER, mMaterialCapacity * sizeof(MaterialTable::Entry), nullptr, GL_DYNAMIC_DRAW);
+        mMemoryStats.drawData += mMaterialCapacity * sizeof(MaterialTable::Entry);
+    }
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, entries.size() * sizeof(MaterialTable::Entry), entries.data());
+    countUpload(entries.size() * sizeof(MaterialTable::Entry));
+}
 
-            if(!texCoords.empty())
-            {
-                buffer.push_back(texCoords[j].x);
-                buffer.push_back(texCoords[j].y);
-            }
-        }
+GLuint Render_OpenGL::textureFor(const Material& material)
+{
+    std::string key = ResourceCache::textureKey(material.diffuseTexture, material.alphaTexture);
+    if (key.empty()) return 0;
+    auto [it, inserted] = mTextureCache.try_emplace(std::move(key), 0);
+    if (inserted) loadTexture(material, it->second);
+    return it->second;
+}
 
-        glBindVertexArray(resources.VAOs[i]);
+GLuint64 Render_OpenGL::textureHandle(GLuint texture)
+{
+    // A texture with a handle can no longer change its parameters, ours never do after loading
+    auto [it, inserted] = mTextureHandles.try_emplace(texture, 0);
+    if (inserted) {
+        it->second = getTextureHandle(texture);
+        makeTextureHandleResident(it->second);
+    }
+    return it->second;
+}
 
-        glBindBuffer(GL_ARRAY_BUFFER, resources.VBOs[i]);
-        glBufferData(GL_ARRAY_BUFFER, buffer.size() * sizeof(float), buffer.data(), GL_STATIC_DRAW);
+void Render_OpenGL::readOcclusionResults()
+{
+    // Never stall on the GPU, a query that is not back yet keeps the previous answer
+    for (uint32_t s = 0; s < mStore.shapeCount(); ++s) {
+        if (!mStore.queryPending(s)) continue;
+        GLuint available = 0;
+        glGetQueryObjectuiv(mStore.query(s), GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+        GLuint anySamples = 0;
+        glGetQueryObjectuiv(mStore.query(s), GL_QUERY_RESULT, &anySamples);
+        mStore.occluded(s) = anySamples == 0;
+        mStore.queryPending(s) = 0;
+    }
+}
 
-        size_t stride = 3;
-        if (!normals.empty()) stride += 3;
-        if (!texCoords.empty()) stride += 2;
+void Render_OpenGL::renderOcclusionProxies(const std::vector<DrawItem>& items, const glm::mat4& viewProjection)
+{
+    if (!mProxyVAO) glGenVertexArrays(1, &mProxyVAO);
+    auto proxy = mShaders[SHADER_TYPE::OCCLUSION_PROXY];
+    proxy->use();
+    ++mRenderStats.pipelineBinds;
+    proxy->setMat4("viewProjection", viewProjection);
 
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride * sizeof(float), (void*)nullptr);
-        glEnableVertexAttribArray(0);
-        size_t offset = 3 * sizeof(float);
-        resources.vertexCounts[i] = vertices.size();
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    glDepthFunc(mReverseZ ? GL_GEQUAL : GL_LEQUAL);
+    glBindVertexArray(mProxyVAO);
 
-        if (!normals.empty()) {
-            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride * sizeof(float), (void*)offset);
-            glEnableVertexAttribArray(1);
-            offset += 3 * sizeof(float);
-        }
+    for (const auto& item : items) {
+        if (mStore.queryPending(item.shape) || cameraInside(item.bounds)) continue;
+        proxy->setVec3("boxMin", item.bounds.min);
+        proxy->setVec3("boxMax", item.bounds.max);
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, mStore.query(item.shape));
+        glDrawArrays(GL_TRIANGLES, 0, 36);
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+        mStore.queryPending(item.shape) = 1;
+        ++mCullingStats.occlusionQueries;
+    }
 
-        if (!texCoords.empty()) {
-            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride * sizeof(float), (void*)offset);
-            glEnableVertexAttribArray(2);
-        }
+    glBindVertexArray(0);
+    glDepthFunc(mReverseZ ? GL_GREATER : GL_LESS);
+    glDepthMask(GL_TRUE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
 
-        // Load texture
-        if (!texturePath.empty()) {
-            loadTexture(texturePath, resources.textures[i]);
-        }
+Render_OpenGL::~Render_OpenGL() {
+    Render_OpenGL::cleanup();
+    for (auto& shader : mShaders) {
+        shader.second->cleanup();
+    }
+}
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+void Render_OpenGL::deleteQueries(uint32_t firstShape, uint32_t shapeCount) {
+    for (uint32_t s = firstShape; s < firstShape + shapeCount; ++s) {
+        glDeleteQueries(1, &mStore.query(s));
+    }
+}
+
+void Render_OpenGL::cleanup() {
+    deleteQueries(0, static_cast<uint32_t>(mStore.shapeCount()));
+    mStore.clear();
+    mMaterials.clear();
+    // Textures are shared between models and kept until here
+    for (auto& [texture, handle] : mTextureHandles) {
+        makeTextureHandleNonResident(handle);
+    }
+    mTextureHandles.clear();
+    for (auto& [path, texture] : mTextureCache) {
+        glDeleteTextures(1, &texture);
+    }
+    mTextureCache.clear();
+    mGeometry.clear();
+    if (mVAO) {
+        GLuint arrays[] = { mVAO, mDepthVAO };
+        glDeleteVertexArrays(2, arrays);
+        GLuint buffers[] = { mVBO, mPositionVBO, mEBO, mDrawIDs, mDrawData, mDrawCommands, mDrawMaterialData, mMaterialData };
+        glDeleteBuffers(8, buffers);
+        mVAO = mDepthVAO = 0;
+        mVBO = mPositionVBO = mEBO = mDrawIDs = mDrawData = mDrawCommands = mDrawMaterialData = mMaterialData = 0;
+        mDrawCapacity = 0;
+        mMaterialCapacity = 0;
+    }
+    if (mProxyVAO) {
+        glDeleteVertexArrays(1, &mProxyVAO);
+        mProxyVAO = 0;
+    }
+    deleteSceneTarget();
+    for (auto& timers : mGpuTimers) {
+        if (timers.queries[0]) glDeleteQueries(GPU_ZONE_COUNT, timers.queries);
+        if (timers.samples) glDeleteQueries(1, &timers.samples);
+        timers = {};
     }
+    mHasOcclusionState = false;
+    mMemoryStats = {};
+}
 
-    mModelResources[model] = resources;
+void Render_OpenGL::setup(const std::shared_ptr<Scene> &scene) {
+    TR_PROFILE_ZONE("renderer setup");
+    cleanup();
+    for (const auto& model : scene->getModels()) {
+        addModel(model);
+    }
+}
+
+void Render_OpenGL::addModel(const std::shared_ptr<Object> &model) {
+    if (mStore.valid(mStore.find(model.get()))) return;
+    uint32_t index = mStore.objectIndex(mStore.add(model));
+    uint32_t firstShape = mStore.firstShape(index);
+    for(uint32_t i = 0; i < mStore.shapeCount(index); ++i)
+    {
+        glGenQueries(1, &mStore.query(firstShape + i));
+        GLuint texture = textureFor(model->getMaterial(i));
+        mStore.texture(firstShape + i) = texture;
+        // The bindless material finds its texture through the table, the batched one binds it per batch
+        mStore.material(firstShape + i) = mMaterials.add(model->getMaterial(i), texture && mBindlessSupported ? textureHandle(texture) : 0);
+    }
+
+    // Uploaded with the rest of the scene before the next frame
+    mGeometry.addModel(model, mResources->geometry(model));
 }
 
 void Render_OpenGL::removeModel(const std::shared_ptr<Object> &model) {
-    auto it = mModelResources.find(model);
-    if (it != mModelResources.end()) {
-        auto& resources = it->second;
-        for (auto& vao : resources.VAOs) {
-            glDeleteVertexArrays(1, &vao);
-        }
-        for (auto& vbo : resources.VBOs) {
-            glDeleteBuffers(1, &vbo);
-        }
-        for (auto& texture : resources.textures) {
-            glDeleteTextures(1, &texture);
-        }
-        mModelResources.erase(it);
+    ObjectHandle handle = mStore.find(model.get());
+    if (mStore.valid(handle)) {
+        uint32_t index = mStore.objectIndex(handle);
+        deleteQueries(mStore.firstShape(index), mStore.shapeCount(index));
+        for (uint32_t s = mStore.firstShape(index); s < mStore.firstShape(index) + mStore.shapeCount(index); ++s)
+            mMaterials.release(mStore.material(s));
+        mStore.remove(handle);
+        mGeometry.removeModel(model);
     }
 }
 
-void Render_OpenGL::loadTexture(const std::string& path, GLuint& textureID) {
+void Render_OpenGL::loadTexture(const Material& material, GLuint& textureID) {
 
-    stbi_set_flip_vertically_on_load(true);
     glGenTextures(1, &textureID);
     glBindTexture(GL_TEXTURE_2D, textureID);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -196,23 +653,15 @@ void Render_OpenGL::loadTexture(const std::string& path, GLuint& textureID) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+    // Top row first like Vulkan, the pool flips texture V for both backends
+    if (auto image = mResources->image(material.diffuseTexture, material.alphaTexture)) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image->width, image->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image->pixels.data());
         glGenerateMipmap(GL_TEXTURE_2D);
-    } else {
-        std::cerr << "Failed to load texture: " << path << std::endl;
+        uint64_t bytes = uint64_t(image->width) * image->height * 4;
+        countUpload(bytes);
+        // The mip chain adds a third
+        mMemoryStats.textures += bytes * 4 / 3;
     }
 
-    stbi_image_free(data);
     glBindTexture(GL_TEXTURE_2D, 0);
 }
\ No newline at end of file
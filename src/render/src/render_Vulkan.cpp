@@ -3,14 +3,22 @@
 //
 
 #include "render/render_Vulkan.h"
+#include "profiler/profiler.h"
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <optional>
+#include <thread>
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 #include <imgui_impl_vulkan.h>
 
+static_assert(sizeof(GeometryVertex) == sizeof(shaderVulkan::material), "pool vertices are read with the material layout");
+
 void Render_Vulkan::init() {
     mShaders[SHADER_TYPE::Blinn_Phong] = std::make_shared<shaderVulkan>(
             "./assets/shaders/Blinn-Phong_v.vert",
@@ -24,199 +32,799 @@ void Render_Vulkan::init() {
             "./assets/shaders/wireframe_v.vert",
             "./assets/shaders/wireframe_v.frag"
     );
+    mShaders[SHADER_TYPE::OCCLUSION_PROXY] = std::make_shared<shaderVulkan>(
+            "./assets/shaders/occlusion_v.vert",
+            "./assets/shaders/occlusion_v.frag"
+    );
     mShaders[SHADER_TYPE::Blinn_Phong]->setShaderType(SHADER_TYPE::Blinn_Phong);
     mShaders[SHADER_TYPE::MATERIAL]->setShaderType(SHADER_TYPE::MATERIAL);
     mShaders[SHADER_TYPE::WIREFRAME]->setShaderType(SHADER_TYPE::WIREFRAME);
+    mShaders[SHADER_TYPE::OCCLUSION_PROXY]->setShaderType(SHADER_TYPE::OCCLUSION_PROXY);
+    mShaders[SHADER_TYPE::DEPTH_PREPASS] = std::make_shared<shaderVulkan>(
+            "./assets/shaders/depth_prepass_v.vert",
+            "./assets/shaders/depth_prepass_v.frag"
+    );
+    mShaders[SHADER_TYPE::DEPTH_PREPASS]->setShaderType(SHADER_TYPE::DEPTH_PREPASS);
+    // Only where the device can index a partially bound texture array, otherwise draws stay batched by texture
+    mBindlessCapacity = shaderVulkan::BindlessTextureCapacity();
+    mBindlessSupported = mBindlessCapacity > 0;
+    if (mBindlessSupported) {
+        mShaders[SHADER_TYPE::MATERIAL_BINDLESS] = std::make_shared<shaderVulkan>(
+                "./assets/shaders/material_bindless_v.vert",
+                "./assets/shaders/material_bindless_v.frag"
+        );
+        mShaders[SHADER_TYPE::MATERIAL_BINDLESS]->setShaderType(SHADER_TYPE::MATERIAL_BINDLESS);
+    }
 
     for(auto & shader : mShaders)
     {
+        shader.second->setReverseZ(mReverseZ);
         shader.second->init();
     }
     mCurrentShader = { SHADER_TYPE::MATERIAL, mShaders[SHADER_TYPE::MATERIAL] };
+
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(graphicsBase::Base().PhysicalDevice(), &features);
+    mMultiDrawIndirect = features.multiDrawIndirect;
+    mIndirectFirstInstance = features.drawIndirectFirstInstance;
+    // Without precise queries the count may be any non-zero value, no overdraw stats then
+    mPreciseOcclusion = features.occlusionQueryPrecise;
 }
 
 void Render_Vulkan::cleanup() {
     if(getType() != VULKAN) return;
     graphicsBase::Base().WaitIdle();
 
-    for (auto& model : mModelResources) {
-        auto& resources = model.second;
-        resources.descriptorSets.clear();
-        for (auto& pool : resources.descriptorPools) {
-            pool.~descriptorPool();
-        }
-        resources.descriptorPools.clear();
-        for (auto& sampler : resources.samplers) {
-            sampler.~sampler();
+    mStore.clear();
+    mMaterials.clear();
+    mGeometry.clear();
+    mResidentGeometry.reset();
+    mPendingGeometry.reset();
+    mTransfer.reset();
+    mStaging.reset();
+    mAcquireTicket = 0;
+    mTextureSets.clear();
+    mTextureSlots.clear();
+    mTextureDescriptors.Clear();
+    mSamplers.Clear();
+    mTextureFlags[0].reset();
+    mTextureFlags[1].reset();
+    mBindlessPool.reset();
+    mDrawMaterialData.reset();
+    mMaterialData.reset();
+    mMaterialCapacity = 0;
+    mDrawData.reset();
+    mDrawCommands.reset();
+    mFrameData.reset();
+    mDrawCapacity = 0;
+    mCommandCapacity = 0;
+    mMemoryStats = {};
+    mMeshletPool.reset();
+    mMeshletCull.reset();
+    mMeshletCullData.reset();
+    mOcclusionQueries.reset();
+    mQueryCount = 0;
+    mHasOcclusionState = false;
+    mTimestamps.reset();
+    mTimestampFrame = 0;
+    mOverdrawQuery.reset();
+    mOverdrawPixels = 0;
+}
+
+Render_Vulkan::~Render_Vulkan() {
+    cleanup();
+}
+
+void Render_Vulkan::initFrameResources()
+{
+    if (mFrameData) return;
+    mFrameData.emplace(sizeof(shaderVulkan::uniformBufferObject));
+    for (int flag = 0; flag < 2; ++flag) {
+        mTextureFlags[flag].emplace(sizeof(int));
+        mTextureFlags[flag]->TransferData(flag);
+    }
+    VkDescriptorPoolSize setSizes[] = {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 }
+    };
+    mTextureDescriptors.Create(setSizes);
+    // Grows in uploadMaterials(), every set written before then gets the buffer from textureSlot()
+    mMaterialCapacity = 64;
+    mMaterialData.emplace(mMaterialCapacity * sizeof(MaterialTable::Entry));
+    // The pre-pass reads the camera and the draw matrices through its own set
+    VkDescriptorBufferInfo cameraInfo = { *mFrameData, 0, sizeof(shaderVulkan::uniformBufferObject) };
+    mShaders[SHADER_TYPE::DEPTH_PREPASS]->getDescriptorSet().Write(cameraInfo, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0);
+    if (mBindlessSupported) {
+        VkDescriptorPoolSize bindlessSizes[] = {
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, mBindlessCapacity },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 }
+        };
+        mBindlessPool.emplace(1, bindlessSizes);
+        mBindlessPool->AllocateSets(mBindlessSet, mShaders[SHADER_TYPE::MATERIAL_BINDLESS]->getDescriptorSetLayout());
+        VkDescriptorBufferInfo frameInfo = { *mFrameData, 0, sizeof(shaderVulkan::uniformBufferObject) };
+        VkDescriptorBufferInfo materialInfo = { *mMaterialData, 0, VK_WHOLE_SIZE };
+        mBindlessSet.Write(frameInfo, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0);
+        mBindlessSet.Write(materialInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6);
+    }
+    // Writes the draw buffers into the bindless set as well
+    reserveDraws(256, 1024);
+}
+
+void Render_Vulkan::reserveDraws(size_t drawCount, size_t commandCount)
+{
+    if (drawCount > mDrawCapacity) {
+        mDrawCapacity = std::max<uint32_t>(static_cast<uint32_t>(drawCount), mDrawCapacity * 2);
+        if (mDrawData)
+            mDrawData->Recreate(mDrawCapacity * sizeof(glm::mat4));
+        else
+            mDrawData.emplace(mDrawCapacity * sizeof(glm::mat4));
+        if (mDrawMaterialData)
+            mDrawMaterialData->Recreate(mDrawCapacity * sizeof(uint32_t));
+        else
+            mDrawMaterialData.emplace(mDrawCapacity * sizeof(uint32_t));
+        VkDescriptorBufferInfo drawInfo = { *mDrawData, 0, VK_WHOLE_SIZE };
+        VkDescriptorBufferInfo drawMaterialInfo = { *mDrawMaterialData, 0, VK_WHOLE_SIZE };
+        for (auto& textureSet : mTextureSets)
+            if (textureSet) {
+                textureSet->set.Write(drawInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3);
+                textureSet->set.Write(drawMaterialInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5);
+            }
+        mShaders[SHADER_TYPE::DEPTH_PREPASS]->getDescriptorSet().Write(drawInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3);
+        if (mBindlessPool) {
+            mBindlessSet.Write(drawInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3);
+            mBindlessSet.Write(drawMaterialInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5);
         }
-        resources.samplers.clear();
-        for (auto& tex : resources.textures) {
-            tex.~texture2d();
+    }
+    if (commandCount > mCommandCapacity) {
+        mCommandCapacity = std::max<uint32_t>(static_cast<uint32_t>(commandCount), mCommandCapacity * 2);
+        VkDeviceSize size = mCommandCapacity * sizeof(VkDrawIndexedIndirectCommand);
+        if (mDrawCommands)
+            mDrawCommands->Recreate(size, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+        else
+            mDrawCommands.emplace(size, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+        if (mMeshletCull) {
+            VkDescriptorBufferInfo commandInfo = { *mDrawCommands, 0, VK_WHOLE_SIZE };
+            mMeshletSet.Write(commandInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2);
         }
-        resources.textures.clear();
-        for (auto& buffer : resources.uniformBuffers) {
-            buffer.~uniformBuffer();
+    }
+    mMemoryStats.drawData = mDrawCapacity * (sizeof(glm::mat4) + sizeof(uint32_t)) +
+                            mCommandCapacity * sizeof(VkDrawIndexedIndirectCommand) +
+                            mMaterialCapacity * sizeof(MaterialTable::Entry);
+}
+
+void Render_Vulkan::uploadMaterials()
+{
+    if (!mMaterials.consumeDirty()) return;
+    const auto& entries = mMaterials.entries();
+    if (entries.empty()) return;
+    if (entries.size() > mMaterialCapacity) {
+        mMemoryStats.drawData -= mMaterialCapacity * sizeof(MaterialTable::Entry);
+        mMaterialCapacity = std::max<uint32_t>(static_cast<uint32_t>(entries.size()), mMaterialCapacity * 2);
+        mMaterialData->Recreate(mMaterialCapacity * sizeof(MaterialTable::Entry));
+        mMemoryStats.drawData += mMaterialCapacity * sizeof(MaterialTable::Entry);
+        VkDescriptorBufferInfo materialInfo = { *mMaterialData, 0, VK_WHOLE_SIZE };
+        for (auto& textureSet : mTextureSets)
+            if (textureSet)
+                textureSet->set.Write(materialInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6);
+        if (mBindlessPool)
+            mBindlessSet.Write(materialInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6);
+    }
+    mMaterialData->TransferData(entries.data(), entries.size() * sizeof(MaterialTable::Entry));
+    countUpload(entries.size() * sizeof(MaterialTable::Entry));
+}
+
+uint32_t Render_Vulkan::textureSlot(const Material& material, bool hasTexCoords)
+{
+    // Shapes without texture coordinates or a texture share the untextured set and shade with Kd, as on OpenGL.
+    // An alpha map makes its own texture
+    std::string key = hasTexCoords ? ResourceCache::textureKey(material.diffuseTexture, material.alphaTexture) : std::string();
+    if (auto it = mTextureSlots.find(key); it != mTextureSlots.end()) {
+        ++mTextureSets[it->second]->users;
+        return it->second;
+    }
+
+    auto textureSet = std::make_unique<TextureSet>();
+    // Decoded once for both backends, a missing file samples white
+    auto image = key.empty() ? mResources->image("./assets/textures/white.png") : mResources->image(material.diffuseTexture, material.alphaTexture);
+    if (!image) image = mResources->image("./assets/textures/white.png");
+    if (image) {
+        textureSet->texture.Create(image->pixels.data(), { image->width, image->height }, VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM, true);
+        countUpload(image->pixels.size());
+        // The mip chain adds a third
+        textureSet->bytes = image->pixels.size() * 4 / 3;
+        mMemoryStats.textures += textureSet->bytes;
+    }
+    // Every shader of this backend has the same set layout
+    mTextureDescriptors.Allocate(textureSet->set, getMaterialShader()->getDescriptorSetLayout());
+    VkDescriptorBufferInfo frameInfo = { *mFrameData, 0, sizeof(shaderVulkan::uniformBufferObject) };
+    VkDescriptorBufferInfo hasTextureInfo = { *mTextureFlags[key.empty() ? 0 : 1], 0, sizeof(int) };
+    VkDescriptorBufferInfo drawInfo = { *mDrawData, 0, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo drawMaterialInfo = { *mDrawMaterialData, 0, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo materialInfo = { *mMaterialData, 0, VK_WHOLE_SIZE };
+    VkDescriptorImageInfo imageInfo = textureSet->texture.DescriptorImageInfo(mSamplers.Get(texture::SamplerCreateInfo()));
+    textureSet->set.Write(frameInfo, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0);
+    textureSet->set.Write(hasTextureInfo, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1);
+    textureSet->set.Write(imageInfo, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2);
+    textureSet->set.Write(drawInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3);
+    textureSet->set.Write(drawMaterialInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5);
+    textureSet->set.Write(materialInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6);
+    textureSet->key = key;
+    textureSet->users = 1;
+
+    auto freeSlot = std::find(mTextureSets.begin(), mTextureSets.end(), nullptr);
+    auto slot = static_cast<uint32_t>(freeSlot - mTextureSets.begin());
+    if (freeSlot == mTextureSets.end())
+        mTextureSets.push_back(std::move(textureSet));
+    else
+        *freeSlot = std::move(textureSet);
+    // Untextured shapes never sample the array, slots past its end keep the scene on the batched path
+    if (mBindlessPool && !key.empty() && slot < mBindlessCapacity)
+        mBindlessSet.Write(imageInfo, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, slot);
+    mTextureSlots.emplace(std::move(key), slot);
+    return slot;
+}
+
+void Render_Vulkan::releaseTextureSlot(uint32_t slot)
+{
+    auto& textureSet = mTextureSets[slot];
+    if (--textureSet->users) return;
+    mTextureDescriptors.Free(textureSet->set);
+    mTextureSlots.erase(textureSet->key);
+    mMemoryStats.textures -= textureSet->bytes;
+    textureSet.reset();
+}
+
+void Render_Vulkan::addModel(const std::shared_ptr<Object>& model) {
+    if (mStore.valid(mStore.find(model.get()))) return;
+    initFrameResources();
+    uint32_t index = mStore.objectIndex(mStore.add(model));
+    uint32_t firstShape = mStore.firstShape(index);
+    for (uint32_t i = 0; i < mStore.shapeCount(index); ++i) {
+        uint32_t slot = textureSlot(model->getMaterial(i), !model->getTexCoords(i).empty());
+        mStore.texture(firstShape + i) = slot;
+        // Untextured shapes never sample the array
+        mStore.material(firstShape + i) = mMaterials.add(model->getMaterial(i), mTextureSets[slot]->key.empty() ? 0 : slot + 1);
+    }
+    // Uploaded with the rest of the scene before the next frame
+    mGeometry.addModel(model, mResources->geometry(model));
+}
+
+void Render_Vulkan::setup(const std::shared_ptr<Scene> &scene) {
+    TR_PROFILE_ZONE("renderer setup");
+    cleanup();
+    for (const auto& model : scene->getModels()) {
+        addModel(model);
+    }
+}
+
+void Render_Vulkan::removeModel(const std::shared_ptr<Object>& model)
+{
+    ObjectHandle handle = mStore.find(model.get());
+    if (mStore.valid(handle)) {
+        // The frame in flight may still sample the textures
+        graphicsBase::Base().WaitIdle();
+        uint32_t index = mStore.objectIndex(handle);
+        for (uint32_t s = mStore.firstShape(index); s < mStore.firstShape(index) + mStore.shapeCount(index); ++s) {
+            releaseTextureSlot(mStore.texture(s));
+            mMaterials.release(mStore.material(s));
         }
-        resources.uniformBuffers.clear();
-        for (auto& buffer : resources.hasTextureBuffers) {
-            buffer.~uniformBuffer();
+        mStore.remove(handle);
+        mGeometry.removeModel(model);
+        // Its ranges stay in the buffers until the next upload, but once no instance is left
+        // new shapes may reuse the address
+        if (!mGeometry.contains(model->getModelKey()))
+            for (auto* geometry : { mResidentGeometry.get(), mPendingGeometry.get() })
+                if (geometry) geometry->shapes.erase(model->getModelKey());
+    }
+}
+
+void Render_Vulkan::uploadGeometry()
+{
+    TR_PROFILE_ZONE("upload geometry");
+    // Nothing reads the resident buffers between frames, a finished upload replaces them right away
+    if (mPendingGeometry) {
+        if (!mTransfer->Finished(mPendingGeometry->ticket)) return;
+        mTransfer->Join_Graphics(mPendingGeometry->ticket);
+        mAcquireTicket = mPendingGeometry->ticket;
+        makeResident(std::move(mPendingGeometry));
+    }
+    if (mTransfer) mStaging->Recycle(mTransfer->Completed());
+    // New instances of resident shapes draw right away, others wait for their upload
+    if (mResidentGeometry && mStore.needsGeometry()) mStore.setGeometry(mResidentGeometry->shapes);
+    // One upload at a time, changes made meanwhile go out once it has landed
+    if (!mGeometry.consumeDirty()) return;
+    if (!mTransfer && asyncTransfer::Available()) {
+        // Geometry goes through the staging pool, the ring only takes single uploads
+        mTransfer.emplace(1 << 20);
+        mStaging.emplace();
+    }
+    const auto& vertices = mGeometry.vertices();
+    const auto& indices = mGeometry.indices();
+    const auto& meshlets = mGeometry.meshlets();
+    auto geometry = std::make_unique<GeometryBuffers>();
+    geometry->shapes = mGeometry.shapeTable();
+    if (vertices.empty()) {
+        makeResident(std::move(geometry));
+        return;
+    }
+
+    struct Slice {
+        const deviceLocalBuffer* buffer;
+        const uint8_t* data;
+        VkDeviceSize size;
+        VkDeviceSize offset;
+    };
+    std::vector<Slice> slices;
+    auto upload = [&](const deviceLocalBuffer& buffer, const void* data, VkDeviceSize size) {
+        countUpload(size);
+        if (!mTransfer) {
+            buffer.TransferData(data, size);
+            return;
         }
-        resources.hasTextureBuffers.clear();
-        for (auto& buffer : resources.vertexBuffers_Material) {
-            buffer.Destroy();
+        for (VkDeviceSize offset = 0; offset < size; offset += mStaging->ChunkSize())
+            slices.push_back({ &buffer, static_cast<const uint8_t*>(data) + offset, std::min(mStaging->ChunkSize(), size - offset), offset });
+    };
+    // One spare vertex: the texcoord attribute is fetched as three floats
+    geometry->vertices.emplace((vertices.size() + 1) * sizeof(GeometryVertex));
+    upload(*geometry->vertices, vertices.data(), vertices.size() * sizeof(GeometryVertex));
+    // Kept until the workers below have copied it
+    const std::vector<glm::vec3> positions = mGeometry.positions();
+    geometry->positions.emplace(positions.size() * sizeof(glm::vec3));
+    upload(*geometry->positions, positions.data(), positions.size() * sizeof(glm::vec3));
+    geometry->indices.emplace(indices.size() * sizeof(uint32_t));
+    upload(*geometry->indices, indices.data(), indices.size() * sizeof(uint32_t));
+    if (!meshlets.empty()) {
+        geometry->meshlets.emplace(meshlets.size() * sizeof(Meshlet));
+        upload(*geometry->meshlets, meshlets.data(), meshlets.size() * sizeof(Meshlet));
+    }
+    geometry->bytes = (vertices.size() + 1) * sizeof(GeometryVertex) + positions.size() * sizeof(glm::vec3) +
+                      indices.size() * sizeof(uint32_t) + meshlets.size() * sizeof(Meshlet);
+
+    if (mTransfer) {
+        // Slices are written into staging memory by every thread at once, the copies are recorded here alone
+        std::atomic<size_t> next{0};
+        auto worker = [this, &next, &slices] {
+            stagingPool::writer writer(*mStaging);
+            for (size_t i = next++; i < slices.size(); i = next++)
+                writer.Upload(*slices[i].buffer, slices[i].data, slices[i].size, slices[i].offset);
+        };
+        size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), slices.size());
+        std::vector<std::future<void>> workers;
+        for (size_t i = 1; i < threadCount; ++i) {
+            workers.push_back(std::async(std::launch::async, worker));
         }
-        resources.vertexBuffers_Material.clear();
+        worker();
+        for (auto& w : workers) w.get();
+        mTransfer->Record(*mStaging);
+        mTransfer->Submit(geometry->ticket);
+        mPendingGeometry = std::move(geometry);
+        updateGeometryMemory();
+        return;
     }
-    mModelResources.clear();
+    makeResident(std::move(geometry));
 }
 
-Render_Vulkan::~Render_Vulkan() {
-    cleanup();
+void Render_Vulkan::makeResident(std::unique_ptr<GeometryBuffers> geometry)
+{
+    mResidentGeometry = std::move(geometry);
+    mStore.setGeometry(mResidentGeometry->shapes);
+    updateGeometryMemory();
+    if (!mResidentGeometry->meshlets) return;
+    initMeshletCulling();
+    VkDescriptorBufferInfo meshletInfo = { *mResidentGeometry->meshlets, 0, VK_WHOLE_SIZE };
+    mMeshletSet.Write(meshletInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1);
 }
 
-void Render_Vulkan::addModel(const std::shared_ptr<Object>& model) {
-    VulkanModelResources &resources = mModelResources[model];
+void Render_Vulkan::updateGeometryMemory()
+{
+    // An upload in flight holds its buffers next to the resident ones
+    mMemoryStats.geometry = (mResidentGeometry ? mResidentGeometry->bytes : 0) + (mPendingGeometry ? mPendingGeometry->bytes : 0);
+}
 
-    size_t shapeCount = model->getShapeCount();
-    for (size_t i = 0; i < shapeCount; ++i) {
-        const std::vector<glm::vec3>& vertices = model->getVertices(i);
-        const std::vector<glm::vec3>& normals = model->getNormals(i);
-        const std::vector<glm::vec2>& texCoords = model->getTexCoords(i);
-        const std::string& texturePath = !model->getTexturePath(i).empty() ? model->getTexturePath(i) : "./assets/textures/white.png";
+void Render_Vulkan::initMeshletCulling()
+{
+    if (mMeshletCull) return;
+    VkDescriptorSetLayoutBinding bindings[3] = {
+        { .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT },
+        { .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT },
+        { .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT }
+    };
+    mMeshletCull.emplace("./assets/shaders/meshlet_cull.comp");
+    mMeshletCull->init(bindings, 3, sizeof(MeshletCullConstants));
+    mMeshletCullData.emplace(sizeof(MeshletCullData));
 
+    VkDescriptorPoolSize poolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 }
+    };
+    mMeshletPool.emplace(1, poolSizes);
+    mMeshletPool->AllocateSets(mMeshletSet, mMeshletCull->getDescriptorSetLayout());
+    VkDescriptorBufferInfo cullInfo = { *mMeshletCullData, 0, sizeof(MeshletCullData) };
+    VkDescriptorBufferInfo commandInfo = { *mDrawCommands, 0, VK_WHOLE_SIZE };
+    mMeshletSet.Write(cullInfo, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0);
+    mMeshletSet.Write(commandInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2);
+}
 
-        resources.uniformBuffers.emplace_back(sizeof(shaderVulkan::uniformBufferObject));
-        resources.hasTextureBuffers.emplace_back(sizeof(int));
-        VkDescriptorPoolSize poolSizes[] = {
-            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 },
-            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 }
-        };
-        resources.descriptorPools.emplace_back(1, poolSizes);
-        resources.descriptorSets.emplace_back();
-        resources.descriptorPools.back().AllocateSets(resources.descriptorSets.back(), getMaterialShader()->getDescriptorSetLayout());
-
-        VkDescriptorBufferInfo unifromBufferInfo = {
-            .buffer = resources.uniformBuffers.back(),
-            .offset = 0,
-            .range = sizeof(shaderVulkan::uniformBufferObject)
-        };
-        VkDescriptorBufferInfo intInfo = {
-            .buffer = resources.hasTextureBuffers.back(),
-            .offset = 0,
-            .range = sizeof(int)
-        };
-        VkWriteDescriptorSet writes[] = {
-            {
-                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                .dstSet = resources.descriptorSets.back(),
-                .dstBinding = 0,
-                .dstArrayElement = 0,
-                .descriptorCount = 1,
-                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                .pBufferInfo = &unifromBufferInfo
-        },
-        {
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstSet = resources.descriptorSets.back(),
-            .dstBinding = 1,
-            .dstArrayElement = 0,
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .pBufferInfo = &intInfo
+void Render_Vulkan::buildDrawList(const std::vector<DrawItem>& items)
+{
+    TR_PROFILE_ZONE("build draw list");
+    mDrawModels.clear();
+    mDrawMaterials.clear();
+    mCommands.clear();
+    mBatches.clear();
+    mDispatches.clear();
+
+    // Only the material shader samples textures, and it needs one batch per texture unless it reads them bindless.
+    // Every other shader ignores the texture set and draws the whole scene in one batch
+    mBindless = mBindlessTextures && mBindlessPool && mCurrentShader.first == SHADER_TYPE::MATERIAL &&
+                mTextureSets.size() <= mBindlessCapacity;
+    const bool materials = mCurrentShader.first == SHADER_TYPE::MATERIAL;
+    const bool perTexture = materials && !mBindless;
+
+    // Keyed by alpha mode and shader, texture, then by distance near to far or by mesh so repeated objects
+    // become instances of one command. Textures are numbered as they first show up, batches then follow their
+    // nearest shape. Blended shapes ignore the texture and go far to near, batches split where it changes
+    const bool nearToFar = mOcclusionCulling || mFrontToBack;
+    const auto pipeline = static_cast<uint32_t>(mBindless ? SHADER_TYPE::MATERIAL_BINDLESS : mCurrentShader.first);
+    mQueue.clear();
+    std::unordered_map<uint32_t, uint32_t> groups;
+    // Blended keys leave the texture out, so the queue misses switches between consecutive blended draws
+    uint32_t blendSwitches = 0;
+    std::optional<uint32_t> blendSlot;
+    for (size_t k = 0; k < items.size(); ++k) {
+        const DrawItem& item = items[k];
+        // Still streaming in
+        if (!mStore.resident(item.shape)) {
+            --mCullingStats.drawnShapes;
+            continue;
         }
-        };
-        vkUpdateDescriptorSets(graphicsBase::Base().Device(), 2, writes, 0, nullptr);
-        resources.textures.emplace_back(texturePath.c_str(), VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM, true);
-        VkSamplerCreateInfo samplerInfo = texture::SamplerCreateInfo();
-        resources.samplers.emplace_back(samplerInfo);
-        VkDescriptorImageInfo imageInfo = resources.textures.back().DescriptorImageInfo(resources.samplers.back());
-        resources.descriptorSets.back().Write(imageInfo, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2);
-
-
-        std::vector<shaderVulkan::material> buffer;
-        for (size_t j = 0; j < vertices.size(); ++j) {
-            glm::vec2 tex;
-            if(!texCoords.empty()) {
-                tex = glm::vec2{texCoords[j].x, 1.0f - texCoords[j].y};
+        if (mOcclusionCulling && mStore.occluded(item.shape)) {
+            if (!cameraInside(item.bounds)) {
+                --mCullingStats.drawnShapes;
+                ++mCullingStats.occludedShapes;
+                continue;
             }
-            else {
-                tex = glm::vec2{0.0f, 0.0f};
-            }
-            buffer.push_back({vertices[j], normals[j], tex});
+            mStore.occluded(item.shape) = 0;
+        }
+        const AlphaMode mode = materials ? mStore.alphaMode(item.shape) : AlphaMode::Opaque;
+        const uint32_t alphaPipeline = drawPipeline(pipeline, mode);
+        if (mode == AlphaMode::Blend) {
+            if (perTexture && blendSlot && *blendSlot != mStore.texture(item.shape)) ++blendSwitches;
+            blendSlot = mStore.texture(item.shape);
+            mQueue.push(RenderQueue::makeKey(alphaPipeline, 0, blendOrder(item.bounds)), static_cast<uint32_t>(k));
+            continue;
         }
-        resources.vertexBuffers_Material.emplace_back((buffer.size() + 1) * sizeof(shaderVulkan::material));
-        resources.vertexBuffers_Material.back().TransferData(buffer.data(), buffer.size() * sizeof(shaderVulkan::material));
-        resources.vertexCounts.push_back(static_cast<uint32_t>(vertices.size()));
+        blendSlot.reset();
+        uint32_t group = perTexture ? groups.try_emplace(mStore.texture(item.shape), static_cast<uint32_t>(groups.size())).first->second : 0;
+        uint32_t order = nearToFar ? RenderQueue::depthOrder(item.distance) : mStore.range(item.shape, item.lod).firstIndex;
+        mQueue.push(RenderQueue::makeKey(alphaPipeline, group, order), static_cast<uint32_t>(k));
     }
+    mQueue.sort();
+    mRenderStats.unsortedStateChanges = mQueue.unsortedStateChanges() + blendSwitches;
+    mRenderStats.sortedStateChanges = mQueue.sortedStateChanges();
 
+    // Cluster commands carry the draw index in firstInstance, which indirect draws may not support
+    const bool clusters = mMeshletCulling && mResidentGeometry && mResidentGeometry->meshlets && mIndirectFirstInstance;
+    const uint32_t flags = (mFrustumCulling ? 1u : 0u) | (mClusterConeCulling ? 2u : 0u);
+    bool extendLast = false;    // the last command is a plain draw of this batch, not a cluster
+    for (const auto& entry : mQueue.entries()) {
+        const DrawItem& item = items[entry.item];
+        uint32_t slot = mStore.texture(item.shape);
+        const AlphaMode mode = materials ? mStore.alphaMode(item.shape) : AlphaMode::Opaque;
+        const ShapeDraw& geometry = mStore.draw(item.shape);
+        const MeshRange& range = mStore.range(item.shape, item.lod);
+        if (mBatches.empty() || (perTexture && mBatches.back().textureSlot != slot) || mBatches.back().alphaMode != mode) {
+            if (!mBatches.empty() && mBatches.back().alphaMode == AlphaMode::Blend && mode == AlphaMode::Blend)
+                ++mRenderStats.sortedStateChanges;
+            mBatches.push_back({slot, mode, static_cast<uint32_t>(mCommands.size()), 0});
+            extendLast = false;
+        }
+
+        auto drawIndex = static_cast<uint32_t>(mDrawModels.size());
+        mDrawModels.push_back(mStore.world(item.object));
+        if (materials) mDrawMaterials.push_back(mStore.material(item.shape));
+        // Submitted triangles, the GPU may still drop clusters of a meshlet shape
+        mCullingStats.drawnTriangles += range.indexCount / 3;
+        mCullingStats.drawnVertices += range.indexCount;
+        if (clusters && geometry.meshletCount && item.lod == 0) {
+            // The compute pass fills these slots, culled clusters get zero instances
+            mDispatches.push_back({mStore.world(item.object), geometry.meshletOffset, geometry.meshletCount,
+                                   static_cast<uint32_t>(mCommands.size()), drawIndex, geometry.meshletIndexBase,
+                                   range.vertexOffset, flags});
+            mCommands.resize(mCommands.size() + geometry.meshletCount, VkDrawIndexedIndirectCommand{});
+            ++mCullingStats.meshletShapes;
+            mCullingStats.meshletsTested += geometry.meshletCount;
+            extendLast = false;
+        } else if (extendLast && mCommands.back().firstIndex == range.firstIndex &&
+                   mCommands.back().indexCount == range.indexCount && mCommands.back().vertexOffset == range.vertexOffset) {
+            // Matrices of one command's instances are consecutive, firstInstance picks the first
+            ++mCommands.back().instanceCount;
+            ++mCullingStats.instancedShapes;
+        } else {
+            mCommands.push_back({range.indexCount, 1, range.firstIndex, range.vertexOffset, drawIndex});
+            extendLast = true;
+        }
+        mBatches.back().commandCount = static_cast<uint32_t>(mCommands.size()) - mBatches.back().firstCommand;
+    }
 }
 
-void Render_Vulkan::setup(const std::shared_ptr<Scene> &scene) {
-    cleanup();
-    for (const auto& model : scene->getModels()) {
-        addModel(model);
+void Render_Vulkan::recordMeshletCulling()
+{
+    if (mDispatches.empty()) return;
+
+    commandBuffer &CommandBuffer = mCurrentShader.second->getCommandBuffer();
+    MeshletCullData data{};
+    for (int i = 0; i < 6; ++i) data.planes[i] = mFrustum.plane(i);
+    data.cameraPosition = glm::vec4(mCameraPosition, 1.0f);
+    mMeshletCullData->CmdUpdateBuffer(CommandBuffer, data);
+
+    VkMemoryBarrier uploaded = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_UNIFORM_READ_BIT
+    };
+    vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         1, &uploaded, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mMeshletCull->getPipeline());
+    vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mMeshletCull->getPipelineLayout(),
+                            0, 1, mMeshletSet.Address(), 0, nullptr);
+    ++mRenderStats.pipelineBinds;
+    ++mRenderStats.descriptorBinds;
+    countUpload(sizeof(data));
+    for (const auto& constants : mDispatches) {
+        vkCmdPushConstants(CommandBuffer, mMeshletCull->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+        vkCmdDispatch(CommandBuffer, (constants.meshletCount + 63) / 64, 1, 1);
     }
+
+    VkMemoryBarrier culled = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+    };
+    vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0,
+                         1, &culled, 0, nullptr, 0, nullptr);
 }
 
-void Render_Vulkan::removeModel(const std::shared_ptr<Object>& model)
+void Render_Vulkan::readTimestamps()
 {
-    auto it = mModelResources.find(model);
-    if (it != mModelResources.end()) {
-        auto& resources = it->second;
-        for (auto& buffer : resources.vertexBuffers_Material) {
-            buffer.Destroy();
-        }
-        mModelResources.erase(it);
+    if (!mTimestampFrame) return;
+    const uint64_t frame = mTimestampFrame;
+    mTimestampFrame = 0;
+    // Waited on with the frame's fence like the occlusion queries
+    if (mTimestamps->GetResults() != VK_SUCCESS) return;
+    const double period = graphicsBase::Base().PhysicalDeviceProperties().limits.timestampPeriod;
+    auto record = [&](const char* name, uint32_t first) {
+        // Unsigned differences survive the 32 bit counter wrapping
+        uint32_t offset = mTimestamps->Timestamp(first) - mTimestamps->Timestamp(0);
+        Profiler::get().recordGpu(frame, name, static_cast<uint64_t>(offset * period),
+                                  static_cast<uint64_t>(mTimestamps->Duration(first) * period));
+    };
+    record("meshlet cull", 0);
+    record("scene", 1);
+    if (mTimestampOcclusion) record("occlusion proxies", 2);
+}
+
+void Render_Vulkan::readOcclusionResults()
+{
+    if (!mOcclusionQueries || !mQueryCount) return;
+    // The frame that issued these queries has been waited on, a failure here means it was never submitted
+    bool available = mOcclusionQueries->GetResults(mQueryCount) == VK_SUCCESS;
+    for (uint32_t s = 0; s < mStore.shapeCount(); ++s) {
+        uint32_t query = mStore.query(s);
+        if (query == ObjectStore::none) continue;
+        if (available)
+            mStore.occluded(s) = mOcclusionQueries->PassingSampleCount(query) == 0;
+        mStore.query(s) = ObjectStore::none;
+    }
+    mQueryCount = 0;
+}
+
+void Render_Vulkan::readOverdraw()
+{
+    if (!mOverdrawPixels) return;
+    // Issued by the frame that has been waited on
+    if (mOverdrawQuery->GetResults(1) == VK_SUCCESS) {
+        mRenderStats.shadedSamples = mOverdrawQuery->PassingSampleCount(0);
+        mRenderStats.targetPixels = mOverdrawPixels;
     }
+    mOverdrawPixels = 0;
 }
 
 void Render_Vulkan::render(const std::shared_ptr<Scene>& scene, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
 {
+    // Lines don't hide anything
+    const bool prepass = mDepthPrepass && mCurrentShader.first != SHADER_TYPE::WIREFRAME;
+    // A reverse-Z or pre-pass switch rebuilds the pipelines before anything is recorded, a no-op otherwise
+    for (auto& [type, pipelineShader] : mShaders) {
+        pipelineShader->setReverseZ(mReverseZ);
+        pipelineShader->setDepthEqual(mDepthPrepass && (type == SHADER_TYPE::MATERIAL || type == SHADER_TYPE::MATERIAL_BINDLESS ||
+                                                        type == SHADER_TYPE::Blinn_Phong));
+    }
     auto shader = mCurrentShader.second;
-    auto models = scene->getModels();
+    std::vector<DrawItem> items = collectDrawItems(viewMatrix, projectionMatrix);
 
-    graphicsBase::Base().SwapImage(shader->getSemaphoreImageIsAvailable());
+    readTimestamps();
+    readOcclusionResults();
+    readOverdraw();
+    if (!mOcclusionCulling && mHasOcclusionState) {
+        for (uint32_t s = 0; s < mStore.shapeCount(); ++s)
+            mStore.occluded(s) = 0;
+        mHasOcclusionState = false;
+    }
+    if (mOcclusionCulling && (!mOcclusionQueries || mOcclusionQueries->Capacity() < items.size())) {
+        uint32_t capacity = std::max<uint32_t>(static_cast<uint32_t>(items.size()), mOcclusionQueries ? mOcclusionQueries->Capacity() * 2 : 256);
+        if (mOcclusionQueries)
+            mOcclusionQueries->Recreate(capacity);
+        else
+            mOcclusionQueries.emplace(capacity);
+    }
+
+    uploadGeometry();
+    buildDrawList(items);
+    // The previous frame has been waited on, nothing still reads these
+    if (!mCommands.empty()) {
+        reserveDraws(mDrawModels.size(), mCommands.size());
+        uploadMaterials();
+        mDrawData->TransferData(mDrawModels.data(), mDrawModels.size() * sizeof(glm::mat4));
+        if (!mDrawMaterials.empty())
+            mDrawMaterialData->TransferData(mDrawMaterials.data(), mDrawMaterials.size() * sizeof(uint32_t));
+        mDrawCommands->TransferData(mCommands.data(), mCommands.size() * sizeof(VkDrawIndexedIndirectCommand));
+        countUpload(mDrawModels.size() * sizeof(glm::mat4));
+        if (!mDrawMaterials.empty()) countUpload(mDrawMaterials.size() * sizeof(uint32_t));
+        countUpload(mCommands.size() * sizeof(VkDrawIndexedIndirectCommand));
+    }
+
+    {
+        TR_PROFILE_ZONE("acquire image");
+        graphicsBase::Base().SwapImage(shader->getSemaphoreImageIsAvailable());
+    }
     auto i = graphicsBase::Base().CurrentImageIndex();
+    TR_PROFILE_ZONE("record");
 
     commandBuffer &CommandBuffer = shader->getCommandBuffer();
 
     CommandBuffer.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    // Geometry that just landed changes queue family before anything reads it
+    if (mAcquireTicket) {
+        mTransfer->CmdAcquire(CommandBuffer, mAcquireTicket);
+        mAcquireTicket = 0;
+    }
+    // Queries can only be reset outside a render pass
+    if (mOcclusionCulling)
+        mOcclusionQueries->CmdReset(CommandBuffer);
+    const bool countSamples = mPreciseOcclusion && !mBatches.empty();
+    if (countSamples) {
+        if (!mOverdrawQuery) mOverdrawQuery.emplace(1);
+        mOverdrawQuery->CmdReset(CommandBuffer);
+    }
+    const auto& limits = graphicsBase::Base().PhysicalDeviceProperties().limits;
+    if (Profiler::get().enabled() && limits.timestampComputeAndGraphics) {
+        if (!mTimestamps) mTimestamps.emplace(4);
+        mTimestamps->CmdReset(CommandBuffer);
+        mTimestamps->CmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+        mTimestampFrame = Profiler::get().frameIndex();
+        mTimestampOcclusion = mOcclusionCulling;
+    }
+
+    // Dispatches, buffer updates and their barriers have to be recorded outside the render pass as well
+    if (mFrameData) {
+        shaderVulkan::uniformBufferObject frame{};
+        frame.model = glm::mat4(1.0f);      // per draw matrices come from the draw buffer
+        frame.view = viewMatrix;
+        frame.proj = projectionMatrix;
+        mFrameData->CmdUpdateBuffer(CommandBuffer, frame);
+        countUpload(sizeof(frame));
+        VkMemoryBarrier uploaded = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_UNIFORM_READ_BIT
+        };
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                             1, &uploaded, 0, nullptr, 0, nullptr);
+    }
+    recordMeshletCulling();
+    if (mTimestampFrame)
+        mTimestamps->CmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 1);
 
     VkClearValue clearValues[2];
     std::memcpy(clearValues, shader->getClearValue(), sizeof(clearValues));
     auto &rpwf = shader->RenderPassAndFramebuffers();
     rpwf.pass.CmdBegin(CommandBuffer, rpwf.framebuffers[i], {{}, windowSize}, clearValues);
 
-    for (const auto& model : models) {
-        shaderVulkan::uniformBufferObject ubo{};
-        ubo.model = model->getModelMatrix();
-        ubo.view = viewMatrix;
-        ubo.proj = projectionMatrix;
-
-        shader->getUniformBuffer().TransferData(&ubo, sizeof(ubo));
-//      TODO: Finish material
-        for(size_t idx = 0; idx < mModelResources[model].vertexCounts.size(); ++idx) {
-            mModelResources[model].uniformBuffers[idx].TransferData(&ubo, sizeof(ubo));
-            VkDeviceSize offset = 0;
-            if(shader->getShaderType() == SHADER_TYPE::Blinn_Phong || shader->getShaderType() == SHADER_TYPE::WIREFRAME)
-                vkCmdBindVertexBuffers(CommandBuffer, 0, 1, mModelResources[model].vertexBuffers_Material[idx].Address(), &offset);
-            else if(shader->getShaderType() == SHADER_TYPE::MATERIAL)
-                vkCmdBindVertexBuffers(CommandBuffer, 0, 1, mModelResources[model].vertexBuffers_Material[idx].Address(), &offset);
-            vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shader->getPipeline());
-
-            if(shader->getShaderType() == SHADER_TYPE::MATERIAL && !model->getTexCoords(idx).empty())
-            {
-                uint32_t hasTexture = model->getTexCoords(idx).size();
-                mModelResources[model].hasTextureBuffers[idx].TransferData(&hasTexture, sizeof(uint32_t));
-                vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                        shader->getPipelineLayout(), 0, 1, mModelResources[model].descriptorSets[idx].Address(), 0,
-                                        nullptr);
+    if (!mBatches.empty()) {
+        constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+        auto drawCommands = [&](uint32_t firstCommand, uint32_t commandCount) {
+            if (!mIndirectFirstInstance) {
+                // Direct draws may always set firstInstance
+                for (uint32_t c = firstCommand; c < firstCommand + commandCount; ++c) {
+                    const auto& command = mCommands[c];
+                    vkCmdDrawIndexed(CommandBuffer, command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance);
+                }
+                mCullingStats.drawCalls += commandCount;
+            } else if (mMultiDrawIndirect) {
+                vkCmdDrawIndexedIndirect(CommandBuffer, *mDrawCommands, firstCommand * stride, commandCount, stride);
+                ++mCullingStats.drawCalls;
+            } else {
+                for (uint32_t c = firstCommand; c < firstCommand + commandCount; ++c)
+                    vkCmdDrawIndexedIndirect(CommandBuffer, *mDrawCommands, c * stride, 1, stride);
+                mCullingStats.drawCalls += commandCount;
             }
-            else
-                vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                        shader->getPipelineLayout(), 0, 1, shader->getDescriptorSet().Address(), 0,
-                                        nullptr);
-            vkCmdDraw(CommandBuffer, mModelResources[model].vertexCounts[idx], 1, 0, 0);
+        };
+        VkDeviceSize offset = 0;
+        vkCmdBindIndexBuffer(CommandBuffer, *mResidentGeometry->indices, 0, VK_INDEX_TYPE_UINT32);
+        // Alpha-tested and blended shapes have holes, they keep out of the pre-pass
+        uint32_t opaqueCommands = 0;
+        for (const auto& batch : mBatches)
+            if (batch.alphaMode == AlphaMode::Opaque) opaqueCommands += batch.commandCount;
+        if (prepass && opaqueCommands) {
+            // Batches are consecutive commands, all the opaque ones go at once
+            auto depth = mShaders[SHADER_TYPE::DEPTH_PREPASS];
+            vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depth->getPipeline());
+            ++mRenderStats.pipelineBinds;
+            vkCmdBindVertexBuffers(CommandBuffer, 0, 1, mResidentGeometry->positions->Address(), &offset);
+            vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depth->getPipelineLayout(),
+                                    0, 1, depth->getDescriptorSet().Address(), 0, nullptr);
+            ++mRenderStats.descriptorBinds;
+            drawCommands(0, opaqueCommands);
+        }
+
+        // Sync objects and the command buffer stay the selected shader's
+        auto pipelineShader = mBindless ? mShaders[SHADER_TYPE::MATERIAL_BINDLESS] : shader;
+        vkCmdBindVertexBuffers(CommandBuffer, 0, 1, mResidentGeometry->vertices->Address(), &offset);
+        if (countSamples)
+            mOverdrawQuery->CmdBegin(CommandBuffer, 0, true);
+        std::optional<AlphaMode> mode;
+        for (const auto& batch : mBatches) {
+            // Batches come opaque first, then alpha tested, then blended, one bind per mode
+            if (mode != batch.alphaMode) {
+                mode = batch.alphaMode;
+                pipeline& modePipeline = *mode == AlphaMode::Opaque ? pipelineShader->getPipeline() :
+                                         *mode == AlphaMode::Mask ? pipelineShader->getMaskedPipeline() :
+                                                                     pipelineShader->getBlendPipeline();
+                vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, modePipeline);
+                ++mRenderStats.pipelineBinds;
+            }
+            vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineShader->getPipelineLayout(),
+                                    0, 1, mBindless ? mBindlessSet.Address() : mTextureSets[batch.textureSlot]->set.Address(), 0, nullptr);
+            ++mRenderStats.descriptorBinds;
+            // Outside bindless every set carries its batch's texture
+            if (!mBindless) ++mRenderStats.textureBinds;
+            drawCommands(batch.firstCommand, batch.commandCount);
+        }
+        if (countSamples) {
+            mOverdrawQuery->CmdEnd(CommandBuffer, 0);
+            mOverdrawPixels = static_cast<uint64_t>(windowSize.width) * windowSize.height;
         }
     }
-}
\ No newline at end of file
+
+    if (mTimestampFrame)
+        mTimestamps->CmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 2);
+
+    // Test every candidate's box against the finished depth buffer, the answers drive next frame
+    if (mOcclusionCulling) {
+        auto proxy = mShaders[SHADER_TYPE::OCCLUSION_PROXY];
+        vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, proxy->getPipeline());
+        ++mRenderStats.pipelineBinds;
+        shaderVulkan::occlusionProxyConstants constants{};
+        constants.viewProjection = projectionMatrix * viewMatrix;
+        for (const auto& item : items) {
+            if (cameraInside(item.bounds)) continue;
+            constants.boxMin = glm::vec4(item.bounds.min, 1.0f);
+            constants.boxMax = glm::vec4(item.bounds.max, 1.0f);
+            vkCmdPushConstants(CommandBuffer, proxy->getPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+            mOcclusionQueries->CmdBegin(CommandBuffer, mQueryCount);
+            vkCmdDraw(CommandBuffer, 36, 1, 0, 0);
+            mOcclusionQueries->CmdEnd(CommandBuffer, mQueryCount);
+            mStore.query(item.shape) = mQueryCount++;
+        }
+        mCullingStats.occlusionQueries = mQueryCount;
+        mHasOcclusionState = true;
+    }
+    if (mTimestampFrame)
+        mTimestamps->CmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 3);
+    finishFrameStats();
+}
@@ -0,0 +1,102 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#include "render/resourceCache.h"
+#include "profiler/profiler.h"
+#include "stb_image.h"
+#include <cstring>
+#include <iostream>
+
+std::shared_ptr<const DecodedImage> ResourceCache::image(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (auto it = mImages.find(path); it != mImages.end()) return it->second;
+    }
+
+    TR_PROFILE_ZONE("decode image");
+    std::shared_ptr<DecodedImage> image;
+    int width, height, channelCount;
+    // The flag is global to stb_image, set it on every load
+    stbi_set_flip_vertically_on_load(false);
+    if (unsigned char* data = stbi_load(path.c_str(), &width, &height, &channelCount, 4)) {
+        image = std::make_shared<DecodedImage>();
+        image->width = static_cast<uint32_t>(width);
+        image->height = static_cast<uint32_t>(height);
+        image->pixels.resize(size_t(width) * height * 4);
+        std::memcpy(image->pixels.data(), data, image->pixels.size());
+        stbi_image_free(data);
+    } else {
+        std::cerr << "Failed to load texture: " << path << std::endl;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mImages.try_emplace(path, std::move(image)).first->second;
+}
+
+std::shared_ptr<const DecodedImage> ResourceCache::image(const std::string& path, const std::string& alphaPath) {
+    if (alphaPath.empty()) return image(path);
+    const std::string key = textureKey(path, alphaPath);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (auto it = mImages.find(key); it != mImages.end()) return it->second;
+    }
+
+    auto alpha = image(alphaPath);
+    auto diffuse = path.empty() ? nullptr : image(path);
+    // An unreadable alpha map leaves the diffuse map as it is
+    std::shared_ptr<const DecodedImage> result = diffuse;
+    if (alpha) {
+        TR_PROFILE_ZONE("combine alpha");
+        auto combined = std::make_shared<DecodedImage>();
+        combined->width = diffuse ? diffuse->width : alpha->width;
+        combined->height = diffuse ? diffuse->height : alpha->height;
+        combined->pixels.assign(size_t(combined->width) * combined->height * 4, 255);
+        if (diffuse) combined->pixels = diffuse->pixels;
+        // Nearest sample when the maps differ in size
+        for (uint32_t y = 0; y < combined->height; ++y) {
+            uint32_t alphaY = uint32_t(uint64_t(y) * alpha->height / combined->height);
+            for (uint32_t x = 0; x < combined->width; ++x) {
+                uint32_t alphaX = uint32_t(uint64_t(x) * alpha->width / combined->width);
+                combined->pixels[(size_t(y) * combined->width + x) * 4 + 3] =
+                    alpha->pixels[(size_t(alphaY) * alpha->width + alphaX) * 4];
+            }
+        }
+        result = std::move(combined);
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mImages.try_emplace(key, std::move(result)).first->second;
+}
+
+std::string ResourceCache::textureKey(const std::string& path, const std::string& alphaPath) {
+    return alphaPath.empty() ? path : path + '\n' + alphaPath;
+}
+
+std::shared_ptr<const WeldedModel> ResourceCache::geometry(const std::shared_ptr<Object>& model) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::erase_if(mModels, [](const auto& entry) { return entry.second.owner.expired(); });
+        if (auto it = mModels.find(model->getModelKey()); it != mModels.end()) return it->second.welded;
+    }
+
+    auto welded = GeometryPool::weld(*model);
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mModels.try_emplace(model->getModelKey(), CachedModel{model->getModelData(), std::move(welded)}).first->second.welded;
+}
+
+void ResourceCache::clear() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mImages.clear();
+    mModels.clear();
+}
+
+size_t ResourceCache::imageCount() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mImages.size();
+}
+
+size_t ResourceCache::modelCount() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mModels.size();
+}
@@ -0,0 +1,76 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#include "render/statsRecorder.h"
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+StatsRecorder::StatsRecorder(const std::filesystem::path& path)
+        : mFile(path), mJson(path.extension() == ".json") {
+    if (!mFile.is_open()) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return;
+    }
+    if (mJson) mFile << "[";
+}
+
+StatsRecorder::~StatsRecorder() {
+    if (mJson && mFile.is_open()) mFile << "\n]\n";
+}
+
+void StatsRecorder::record(uint64_t frame, double frameMs, const Render& render) {
+    if (!mFile.is_open()) return;
+    const CullingStats& culling = render.getCullingStats();
+    const RenderStats& work = render.getRenderStats();
+    const MemoryStats& memory = render.getMemoryStats();
+    char ms[32], overdraw[32];
+    std::snprintf(ms, sizeof(ms), "%.4f", frameMs);
+    std::snprintf(overdraw, sizeof(overdraw), "%.4f", work.overdraw());
+    const std::vector<std::pair<const char*, std::string>> fields = {
+        {"frame", std::to_string(frame)},
+        {"frame_ms", ms},
+        {"draw_calls", std::to_string(culling.drawCalls)},
+        {"triangles", std::to_string(culling.drawnTriangles)},
+        {"vertices", std::to_string(culling.drawnVertices)},
+        {"drawn_objects", std::to_string(culling.drawnObjects)},
+        {"culled_objects", std::to_string(culling.culledObjects)},
+        {"drawn_shapes", std::to_string(culling.drawnShapes)},
+        {"culled_shapes", std::to_string(culling.culledShapes)},
+        {"occluded_shapes", std::to_string(culling.occludedShapes)},
+        {"pipeline_binds", std::to_string(work.pipelineBinds)},
+        {"descriptor_binds", std::to_string(work.descriptorBinds)},
+        {"texture_binds", std::to_string(work.textureBinds)},
+        {"sorted_state_changes", std::to_string(work.sortedStateChanges)},
+        {"unsorted_state_changes", std::to_string(work.unsortedStateChanges)},
+        {"masked_shapes", std::to_string(work.maskedShapes)},
+        {"blended_shapes", std::to_string(work.blendedShapes)},
+        {"buffer_uploads", std::to_string(work.bufferUploads)},
+        {"upload_bytes", std::to_string(work.uploadBytes)},
+        {"shaded_samples", std::to_string(work.shadedSamples)},
+        {"overdraw", overdraw},
+        {"geometry_bytes", std::to_string(memory.geometry)},
+        {"draw_data_bytes", std::to_string(memory.drawData)},
+        {"texture_bytes", std::to_string(memory.textures)},
+    };
+
+    if (mJson) {
+        mFile << (mFrames ? ",\n  {" : "\n  {");
+        for (size_t i = 0; i < fields.size(); ++i)
+            mFile << (i ? ", \"" : "\"") << fields[i].first << "\": " << fields[i].second;
+        mFile << "}";
+    } else {
+        if (!mFrames) {
+            for (size_t i = 0; i < fields.size(); ++i)
+                mFile << (i ? "," : "") << fields[i].first;
+            mFile << "\n";
+        }
+        for (size_t i = 0; i < fields.size(); ++i)
+            mFile << (i ? "," : "") << fields[i].second;
+        mFile << "\n";
+    }
+    ++mFrames;
+}
@@ -0,0 +1,85 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#ifndef TOY_RENDERER_BOUNDS_H
+#define TOY_RENDERER_BOUNDS_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+
+struct AABB {
+    glm::vec3 min{ std::numeric_limits<float>::max()};
+    glm::vec3 max{-std::numeric_limits<float>::max()};
+
+    bool valid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extent() const { return (max - min) * 0.5f; }
+
+    void expand(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    void expand(const AABB& other) {
+        if (!other.valid()) return;
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    // Arvo's method: the box of a transformed box, without touching its 8 corners
+    AABB transformed(const glm::mat4& matrix) const {
+        if (!valid()) return *this;
+        glm::vec3 c = glm::vec3(matrix * glm::vec4(center(), 1.0f));
+        glm::vec3 e = extent();
+        glm::vec3 r{
+            std::abs(matrix[0][0]) * e.x + std::abs(matrix[1][0]) * e.y + std::abs(matrix[2][0]) * e.z,
+            std::abs(matrix[0][1]) * e.x + std::abs(matrix[1][1]) * e.y + std::abs(matrix[2][1]) * e.z,
+            std::abs(matrix[0][2]) * e.x + std::abs(matrix[1][2]) * e.y + std::abs(matrix[2][2]) * e.z
+        };
+        return {c - r, c + r};
+    }
+
+    static AABB fromPoints(const std::vector<glm::vec3>& points) {
+        AABB box;
+        for (const auto& p : points) box.expand(p);
+        return box;
+    }
+};
+
+struct BoundingSphere {
+    glm::vec3 center{0.0f};
+    float radius = 0.0f;
+
+    BoundingSphere transformed(const glm::mat4& matrix) const {
+        float scale = std::max({
+            glm::length(glm::vec3(matrix[0])),
+            glm::length(glm::vec3(matrix[1])),
+            glm::length(glm::vec3(matrix[2]))
+        });
+        return {glm::vec3(matrix * glm::vec4(center, 1.0f)), radius * scale};
+    }
+
+    // Centered on the box, radius grown to the farthest point; tighter than the box's circumsphere for most meshes
+    static BoundingSphere fromPoints(const std::vector<glm::vec3>& points, const AABB& box) {
+        BoundingSphere sphere;
+        if (!box.valid()) return sphere;
+        sphere.center = box.center();
+        float radius2 = 0.0f;
+        for (const auto& p : points) {
+            glm::vec3 d = p - sphere.center;
+            radius2 = std::max(radius2, glm::dot(d, d));
+        }
+        sphere.radius = std::sqrt(radius2);
+        return sphere;
+    }
+
+    static BoundingSphere fromBox(const AABB& box) {
+        if (!box.valid()) return {};
+        return {box.center(), glm::length(box.extent())};
+    }
+};
+
+#endif //TOY_RENDERER_BOUNDS_H
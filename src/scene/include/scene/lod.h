@@ -0,0 +1,36 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#ifndef TOY_RENDERER_LOD_H
+#define TOY_RENDERER_LOD_H
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+// One simplified version of a shape, same triangle soup layout as Shape
+struct LODLevel {
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> texCoords;
+    float error = 0.0f;     // quadric cost of the worst collapse, only meaningful relative to other levels
+};
+
+using LODChain = std::shared_ptr<const std::vector<LODLevel>>;
+
+namespace LOD {
+    constexpr size_t MaxLevels = 3;             // on top of the full resolution shape
+    constexpr size_t MinTriangles = 256;        // smaller shapes are not worth simplifying
+
+    // Quadric error metric edge collapse, each level aims at half the triangles of the previous one.
+    // Vertices on open borders and UV/normal seams are locked so the silhouette and texturing hold.
+    // The chain lives with the shape's ModelData, models loaded from the same file share it and it goes with them.
+    LODChain build(
+            const std::vector<glm::vec3>& vertices,
+            const std::vector<glm::vec3>& normals,
+            const std::vector<glm::vec2>& texCoords
+    );
+}
+
+#endif //TOY_RENDERER_LOD_H
@@ -0,0 +1,36 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#ifndef TOY_RENDERER_MATERIAL_H
+#define TOY_RENDERER_MATERIAL_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+
+// How a shape's alpha is used. Masked shapes drop fragments below one half and stay in the opaque
+// depth order, blended ones are drawn after everything else, farthest first
+enum class AlphaMode : uint8_t {
+    Opaque,
+    Mask,
+    Blend
+};
+
+// Surface parameters of a shape, as an MTL file gives them. The defaults are the flat gray
+// shapes without a material have always been drawn in.
+// A diffuse texture replaces the diffuse color, MTL files often leave Kd at zero next to map_Kd.
+struct Material {
+    glm::vec3 diffuse{0.6f};        // Kd
+    glm::vec3 specular{0.0f};       // Ks
+    glm::vec3 emissive{0.0f};       // Ke
+    float shininess = 32.0f;        // Ns
+    float alpha = 1.0f;             // d, or 1 - Tr
+    std::string diffuseTexture;     // map_Kd, a path relative to the working directory
+    std::string alphaTexture;       // map_d, its first channel is the alpha
+    AlphaMode alphaMode = AlphaMode::Opaque;
+
+    bool operator==(const Material&) const = default;
+};
+
+#endif //TOY_RENDERER_MATERIAL_H
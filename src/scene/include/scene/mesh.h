@@ -0,0 +1,30 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#ifndef TOY_RENDERER_MESH_H
+#define TOY_RENDERER_MESH_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Indexed form of a Shape's triangle soup
+struct WeldedMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;     // empty when the soup has none
+    std::vector<glm::vec2> texCoords;   // empty when the soup has none
+    std::vector<uint32_t> indices;
+};
+
+namespace Mesh {
+    // Merges soup vertices whose attributes match exactly. Welded vertices are numbered in order of
+    // first appearance, so the result is deterministic and meshlet indices stay valid on any copy of it.
+    WeldedMesh weld(
+            const std::vector<glm::vec3>& vertices,
+            const std::vector<glm::vec3>& normals,
+            const std::vector<glm::vec2>& texCoords
+    );
+}
+
+#endif //TOY_RENDERER_MESH_H
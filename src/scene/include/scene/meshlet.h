@@ -0,0 +1,49 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#ifndef TOY_RENDERER_MESHLET_H
+#define TOY_RENDERER_MESHLET_H
+
+#include "camera/frustum.h"
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+// Matches the std430 layout read by meshlet_cull.comp
+struct Meshlet {
+    glm::vec3 center;
+    float radius;
+    glm::vec3 coneAxis;
+    float coneCutoff;       // 1 disables the backface test, the triangles face too many ways
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t vertexCount;
+    uint32_t padding = 0;
+};
+static_assert(sizeof(Meshlet) == 48, "Meshlet must match the GPU layout");
+
+struct MeshletData {
+    std::vector<uint32_t> indices;      // into Mesh::weld of the shape, grouped by meshlet
+    std::vector<Meshlet> meshlets;
+};
+
+namespace Meshlets {
+    constexpr uint32_t MaxVertices = 64;
+    constexpr uint32_t MaxTriangles = 124;
+    constexpr size_t MinTriangles = 4096;   // only dense shapes are split
+
+    // Welds the soup with Mesh::weld, then grows each cluster greedily from a seed triangle,
+    // preferring neighbours that add the fewest new vertices so clusters stay compact.
+    std::shared_ptr<const MeshletData> build(
+            const std::vector<glm::vec3>& vertices,
+            const std::vector<glm::vec3>& normals,
+            const std::vector<glm::vec2>& texCoords
+    );
+
+    // Same tests as meshlet_cull.comp, for the CPU benchmark and debugging
+    bool frustumVisible(const Meshlet& meshlet, const glm::mat4& modelMatrix, const Frustum& frustum);
+    bool coneVisible(const Meshlet& meshlet, const glm::mat4& modelMatrix, const glm::vec3& cameraPosition);
+}
+
+#endif //TOY_RENDERER_MESHLET_H
@@ -13,60 +13,146 @@
 #include <string>
 #include <stb_image.h>
 #include <iostream>
+#include "scene/bounds.h"
+#include "scene/lod.h"
+#include "scene/material.h"
+#include "scene/meshlet.h"
+#include "scene/sceneGraph.h"
+#include <memory>
 
 struct Shape {
     std::vector<glm::vec3> vertices;
     std::vector<glm::vec3> normals;
     std::vector<glm::vec2> texCoords;
-    std::string texturePath;// std::filesystem::path
+    Material material;
     std::string name;
     bool visible = true;
+    AABB bounds;
+    BoundingSphere sphere;
+    LODChain lods;      // simplified levels 1..n, null when the shape is too small to simplify
+    std::shared_ptr<const MeshletData> meshlets;    // clusters of the full resolution level, null for small shapes
+
+    void updateBounds() {
+        bounds = AABB::fromPoints(vertices);
+        sphere = BoundingSphere::fromPoints(vertices, bounds);
+    }
+};
+
+// Shapes and their bounds as loaded from one file. Objects placing the same file share one of these,
+// and the renderers keep one copy of its geometry for all of them
+struct ModelData {
+    std::vector<Shape> shapes;
+    AABB bounds;
+    BoundingSphere sphere;
 };
 
 class Object {
 public:
     Object() = default;
+    // Another placement of existing shapes, adding shapes or building LODs changes every sharer
+    explicit Object(std::shared_ptr<ModelData> modelData) : data(std::move(modelData)) {}
     ~Object() = default;
+    // Same shapes and name, not placed in any graph yet
+    std::shared_ptr<Object> instance() const {
+        auto copy = std::make_shared<Object>(data);
+        copy->name = name;
+        return copy;
+    }
 
-    glm::mat4 getModelMatrix() const { return model; }
-    size_t getShapeCount() const { return shapes.size(); }
-    void setModelMatrix(const glm::mat4 &modelMatrix) { model = modelMatrix; }
-    void setModelMatrix(const glm::vec3 pos){ model = glm::translate(model, pos); }
-    void scale(const glm::vec3 &scale) { model = glm::scale(model, scale); }
+    // World matrix once the object is in a scene graph, as of its last update()
+    glm::mat4 getModelMatrix() const { return graph ? graph->world(node) : local.matrix(); }
+    size_t getShapeCount() const { return data->shapes.size(); }
+    const Transform& getLocalTransform() const { return graph ? graph->local(node) : local; }
+    void setLocalTransform(const Transform& transform) {
+        if (graph) graph->setLocal(node, transform);
+        else local = transform;
+    }
+    // Each of these composes on the right of the local transform, like the glm functions
+    void setModelMatrix(const glm::mat4 &modelMatrix) { setLocalTransform(Transform::fromMatrix(modelMatrix)); }
+    void setModelMatrix(const glm::vec3 pos) {
+        Transform t = getLocalTransform();
+        t.translation += t.rotation * (t.scale * pos);
+        setLocalTransform(t);
+    }
+    void scale(const glm::vec3 &scale) {
+        Transform t = getLocalTransform();
+        t.scale *= scale;
+        setLocalTransform(t);
+    }
     void rotate(float angleInDegrees, const glm::vec3& axis) {
-        model = glm::rotate(model, glm::radians(angleInDegrees), glm::normalize(axis));
+        rotateQuaternion(angleInDegrees, axis);
     }
     void rotateEulerXYZ(float angleX, float angleY, float angleZ) {
-        float radX = glm::radians(angleX);
-        float radY = glm::radians(angleY);
-        float radZ = glm::radians(angleZ);
-
-        glm::mat4 rotX = glm::rotate(glm::mat4(1.0f), radX, glm::vec3(1.0f, 0.0f, 0.0f));
-        glm::mat4 rotY = glm::rotate(glm::mat4(1.0f), radY, glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 rotZ = glm::rotate(glm::mat4(1.0f), radZ, glm::vec3(0.0f, 0.0f, 1.0f));
-
-        model = model * rotZ * rotY * rotX;
+        glm::quat rotX = glm::angleAxis(glm::radians(angleX), glm::vec3(1.0f, 0.0f, 0.0f));
+        glm::quat rotY = glm::angleAxis(glm::radians(angleY), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::quat rotZ = glm::angleAxis(glm::radians(angleZ), glm::vec3(0.0f, 0.0f, 1.0f));
+        rotateQuaternion(rotZ * rotY * rotX);
     }
 
     void rotateQuaternion(const glm::quat& quaternion) {
-        glm::mat4 rotationMatrix = glm::mat4_cast(quaternion);
-        model = model * rotationMatrix;
+        Transform t = getLocalTransform();
+        t.rotation = glm::normalize(t.rotation * quaternion);
+        setLocalTransform(t);
     }
     void rotateQuaternion(float angleInDegrees, const glm::vec3& axis) {
         glm::quat quaternion = glm::angleAxis(glm::radians(angleInDegrees), glm::normalize(axis));
         rotateQuaternion(quaternion);
     }
+
+    // Scene moves the local transform into its graph node and back
+    SceneGraph::NodeId getNode() const { return node; }
+    void attach(std::shared_ptr<SceneGraph> sceneGraph, SceneGraph::NodeId sceneNode) {
+        sceneGraph->setLocal(sceneNode, local);
+        graph = std::move(sceneGraph);
+        node = sceneNode;
+    }
+    void detach() {
+        if (!graph) return;
+        if (graph->valid(node)) local = graph->local(node);
+        graph.reset();
+        node = SceneGraph::none;
+    }
     std::string getName() {return name;}
     void setName(const std::string& objectName) { name = objectName; }
-    void addShape(const Shape& shape) { shapes.push_back(shape); }
-    std::vector<glm::vec3> getVertices(size_t shapeIndex) const { return shapes[shapeIndex].vertices; }
-    std::vector<glm::vec3> getNormals(size_t shapeIndex) const { return shapes[shapeIndex].normals; }
-    std::vector<glm::vec2> getTexCoords(size_t shapeIndex) const { return shapes[shapeIndex].texCoords; }
-    std::string getTexturePath(size_t shapeIndex) const { return shapes[shapeIndex].texturePath; }
+    void addShape(const Shape& shape) {
+        data->shapes.push_back(shape);
+        data->shapes.back().updateBounds();
+        data->bounds.expand(data->shapes.back().bounds);
+        data->sphere = BoundingSphere::fromBox(data->bounds);
+    }
+    std::vector<glm::vec3> getVertices(size_t shapeIndex) const { return data->shapes[shapeIndex].vertices; }
+    std::vector<glm::vec3> getNormals(size_t shapeIndex) const { return data->shapes[shapeIndex].normals; }
+    std::vector<glm::vec2> getTexCoords(size_t shapeIndex) const { return data->shapes[shapeIndex].texCoords; }
+    std::string getTexturePath(size_t shapeIndex) const { return data->shapes[shapeIndex].material.diffuseTexture; }
+    const Material& getMaterial(size_t shapeIndex) const { return data->shapes[shapeIndex].material; }
+    // Bounds are in model space, use AABB::transformed / BoundingSphere::transformed with getModelMatrix() for world space
+    const AABB& getBounds() const { return data->bounds; }
+    const BoundingSphere& getBoundingSphere() const { return data->sphere; }
+    const AABB& getShapeBounds(size_t shapeIndex) const { return data->shapes[shapeIndex].bounds; }
+    const BoundingSphere& getShapeBoundingSphere(size_t shapeIndex) const { return data->shapes[shapeIndex].sphere; }
+
+    // Level 0 is the shape itself
+    size_t getLODCount(size_t shapeIndex) const { return data->shapes[shapeIndex].lods ? data->shapes[shapeIndex].lods->size() + 1 : 1; }
+    const LODLevel& getLOD(size_t shapeIndex, size_t level) const { return (*data->shapes[shapeIndex].lods)[level - 1]; }
+    // Simplifies every shape on worker threads, call once after all shapes are added
+    void buildLODs();
+
+    const MeshletData* getMeshlets(size_t shapeIndex) const { return data->shapes[shapeIndex].meshlets.get(); }
+    // Splits dense shapes into clusters for GPU culling, same threading as buildLODs
+    void buildMeshlets();
+
+    // Same pointer for every Object sharing the shapes, the key renderers deduplicate geometry by
+    const ModelData* getModelKey() const { return data.get(); }
+    std::shared_ptr<const ModelData> getModelData() const { return data; }
 
 private:
-    std::vector<Shape> shapes;
-    glm::mat4 model{1.0f};
+    template<typename F>
+    void forEachShapeParallel(F&& f);
+
+    std::shared_ptr<ModelData> data = std::make_shared<ModelData>();
+    Transform local;                        // while not in a graph
+    std::shared_ptr<SceneGraph> graph;
+    SceneGraph::NodeId node = SceneGraph::none;
     std::string name;
 };
 
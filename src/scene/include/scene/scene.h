@@ -18,18 +18,36 @@ public:
     Scene();
     ~Scene() = default;
 
-    void addObject(std::shared_ptr<Object> object);
+    // Parented to another node of the graph when given, a model's node or a group's
+    void addObject(std::shared_ptr<Object> object, SceneGraph::NodeId parent = SceneGraph::none);
+    // Transform-only node for grouping parts that move together
+    SceneGraph::NodeId addGroup(const Transform& local, SceneGraph::NodeId parent = SceneGraph::none);
     void setCamera(std::shared_ptr<Camera> camera);
     std::shared_ptr<Camera> getCamera() const { return mCamera; }
+    // Image size the scene file's camera is calibrated for, 0 x 0 when it gave none
+    void setResolution(int width, int height) { mResolution = {width, height}; }
+    glm::ivec2 getResolution() const { return mResolution; }
     void addModel(const std::filesystem::path& filePath);
     std::vector<std::shared_ptr<Object>> getModels() const { return mObjects; }
-    void removeModel(const std::shared_ptr<Object>& model);
+    // Removes the model with everything parented under it, returns every removed model
+    std::vector<std::shared_ptr<Object>> removeModel(const std::shared_ptr<Object>& model);
+    // Streams the file through SceneLoader, see sceneLoader.h for the format
     void loadJSON(const std::filesystem::path& path);
+    // A file loaded before and still in use is not parsed again, the new Object shares its shapes.
+    // Not added to the scene, nullptr for unsupported formats
+    std::shared_ptr<Object> loadModelFile(const std::filesystem::path& path);
+
+    // Call once per frame before rendering, recomputes world matrices of moved subtrees
+    void updateTransforms() { mGraph->update(); }
+    const SceneGraph& getGraph() const { return *mGraph; }
 
 
 private:
     std::vector<std::shared_ptr<Object>> mObjects;
+    std::shared_ptr<SceneGraph> mGraph;
+    std::unordered_map<std::string, std::weak_ptr<ModelData>> mLoadedFiles;
     std::shared_ptr<Camera> mCamera;
+    glm::ivec2 mResolution{0};
 
     static const std::unordered_map<std::string, std::function<void(const std::filesystem::path&, std::shared_ptr<Object>)>> loadModelFunctions;
     static void loadOBJModel(const std::filesystem::path& path, const std::shared_ptr<Object>& model);
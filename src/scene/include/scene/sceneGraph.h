@@ -0,0 +1,78 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#ifndef TOY_RENDERER_SCENEGRAPH_H
+#define TOY_RENDERER_SCENEGRAPH_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Local transform kept decomposed, the matrix is translation * rotation * scale
+struct Transform {
+    glm::vec3 translation{0.0f};
+    glm::quat rotation{1.0f, 0.0f, 0.0f, 0.0f};
+    glm::vec3 scale{1.0f};
+
+    glm::mat4 matrix() const {
+        glm::mat4 m = glm::mat4_cast(rotation);
+        m[0] *= scale.x;
+        m[1] *= scale.y;
+        m[2] *= scale.z;
+        m[3] = glm::vec4(translation, 1.0f);
+        return m;
+    }
+    // Shear is dropped, a negative determinant is folded into scale.x
+    static Transform fromMatrix(const glm::mat4& m);
+};
+
+// Transform hierarchy of the scene. Nodes are stored parents first in flat arrays, so update() is
+// one pass in index order that recomputes a world matrix only when the node or one of its
+// ancestors changed since the last update. World matrices sit in one contiguous array for upload.
+// Node ids are stable handles, array indices move when update() compacts removed nodes away.
+class SceneGraph {
+public:
+    using NodeId = uint32_t;
+    static constexpr NodeId none = std::numeric_limits<NodeId>::max();
+
+    NodeId create(NodeId parent = none, const Transform& local = {});
+    // Removes the node with its whole subtree, returns every removed id
+    std::vector<NodeId> remove(NodeId node);
+
+    bool valid(NodeId node) const { return node < mIndexOf.size() && mIndexOf[node] != none; }
+    NodeId parent(NodeId node) const;
+    const Transform& local(NodeId node) const { return mLocal[mIndexOf[node]]; }
+    void setLocal(NodeId node, const Transform& local);
+    // Cached, current as of the last update()
+    const glm::mat4& world(NodeId node) const { return mWorld[mIndexOf[node]]; }
+
+    // Recomputes world matrices of changed subtrees
+    void update();
+    bool dirty() const { return mAnyDirty; }
+
+    // Position of the node's matrix in worldMatrices(), may change in update() after a remove()
+    uint32_t index(NodeId node) const { return mIndexOf[node]; }
+    const std::vector<glm::mat4>& worldMatrices() const { return mWorld; }
+    size_t size() const { return mHandle.size() - mRemoved; }
+
+private:
+    void compact();
+
+    // Per index, parents before children
+    std::vector<uint32_t> mParent;      // index, none for roots
+    std::vector<Transform> mLocal;
+    std::vector<glm::mat4> mWorld;
+    std::vector<uint8_t> mDirty;        // local changed since the last update()
+    std::vector<NodeId> mHandle;        // none for removed entries
+
+    std::vector<uint32_t> mIndexOf;     // per handle, none for free handles
+    std::vector<NodeId> mFreeHandles;
+    size_t mRemoved = 0;                // dead entries waiting for compact()
+    bool mAnyDirty = false;
+};
+
+#endif //TOY_RENDERER_SCENEGRAPH_H
@@ -0,0 +1,53 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#ifndef TOY_RENDERER_SCENELOADER_H
+#define TOY_RENDERER_SCENELOADER_H
+
+#include "scene/sceneGraph.h"
+#include <nlohmann/json_fwd.hpp>
+#include <filesystem>
+#include <vector>
+
+class Scene;
+
+// Reads .json scenes into a Scene. The file goes through a SAX parser: each entry of "objects" is
+// built, placed and dropped as soon as its closing brace is read, and the numbers of an
+// "instances" "data" array go straight into a float buffer instead of the DOM.
+// An entry may have, besides "file" and a transform:
+//   "children":  entries placed relative to it
+//   "include":   another scene file loaded under it, relative to this file
+//   "instances": {"layout": "t" | "tr" | "trs" | "matrix", "data": [numbers...]}
+//                or {"layout": ..., "binary": "file.bin", "offset": bytes, "count": records}
+//                one Object per record sharing the entry's mesh, the entry's transform is their parent.
+//                Records are float32, t is a position, r a quaternion w x y z, s a scale,
+//                matrix 16 floats column major. Binary files are little endian
+// At the top level of the file loaded first, "resolution": [width, height] and "camera" set the scene's camera:
+//   "fx", "fy", "cx", "cy": pinhole intrinsics in pixels of the resolution, an IntrinsicsCamera;
+//                           otherwise "type": "perspective" with "fov" in degrees, or "orthographic"
+//   "near", "far"
+//   "position", then "look_at": [x, y, z], or "rotation" like an entry's, or "yaw" and "pitch" in degrees.
+//   The camera looks down -z with y up, roll is dropped
+class SceneLoader {
+public:
+    explicit SceneLoader(Scene& scene) : mScene(scene) {}
+
+    // False when the file can't be read or parsed, entries before the error stay loaded
+    bool load(const std::filesystem::path& path, SceneGraph::NodeId parent = SceneGraph::none);
+
+private:
+    using Streams = std::vector<std::vector<float>>;
+    void loadEntry(const nlohmann::json& entry, SceneGraph::NodeId parent, Streams& streams,
+                   const std::filesystem::path& directory);
+    void loadInstances(const nlohmann::json& instances, const std::filesystem::path& file, SceneGraph::NodeId parent,
+                       Streams& streams, const std::filesystem::path& directory);
+    // Relative paths are tried next to the scene file first, then from the working directory
+    static std::filesystem::path resolve(const std::filesystem::path& directory, const std::filesystem::path& path);
+    void loadCamera(const nlohmann::json& root);
+
+    Scene& mScene;
+    std::vector<std::filesystem::path> mIncludes;   // files being loaded, to refuse include cycles
+};
+
+#endif //TOY_RENDERER_SCENELOADER_H
@@ -0,0 +1,292 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#include "scene/lod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+// Symmetric 4x4 plane quadric, upper triangle only
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+
+    static Quadric fromPlane(const glm::dvec3& n, double d, double weight) {
+        Quadric q;
+        q.a00 = n.x * n.x * weight; q.a01 = n.x * n.y * weight; q.a02 = n.x * n.z * weight; q.a03 = n.x * d * weight;
+        q.a11 = n.y * n.y * weight; q.a12 = n.y * n.z * weight; q.a13 = n.y * d * weight;
+        q.a22 = n.z * n.z * weight; q.a23 = n.z * d * weight;
+        q.a33 = d * d * weight;
+        return q;
+    }
+    Quadric& operator+=(const Quadric& o) {
+        a00 += o.a00; a01 += o.a01; a02 += o.a02; a03 += o.a03;
+        a11 += o.a11; a12 += o.a12; a13 += o.a13;
+        a22 += o.a22; a23 += o.a23;
+        a33 += o.a33;
+        return *this;
+    }
+    double evaluate(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double r = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+                 + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+                 + a22 * z * z + 2 * a23 * z
+                 + a33;
+        return std::max(r, 0.0);
+    }
+};
+
+struct IndexedMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> texCoords;
+    std::vector<uint32_t> indices;
+    std::vector<uint8_t> locked;
+};
+
+template <size_t N>
+struct FloatKey {
+    float v[N];
+    bool operator==(const FloatKey& o) const { return std::memcmp(v, o.v, sizeof(v)) == 0; }
+};
+
+template <size_t N>
+struct FloatKeyHash {
+    size_t operator()(const FloatKey<N>& k) const {
+        uint64_t h = 1469598103934665603ull;
+        const auto* bytes = reinterpret_cast<const unsigned char*>(k.v);
+        for (size_t i = 0; i < sizeof(k.v); ++i) h = (h ^ bytes[i]) * 1099511628211ull;
+        return static_cast<size_t>(h);
+    }
+};
+
+// Weld the soup into indexed vertices (exact attribute match), then lock vertices that must not move
+IndexedMesh weld(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals, const std::vector<glm::vec2>& texCoords) {
+    IndexedMesh mesh;
+    const bool hasNormals = normals.size() == vertices.size();
+    const bool hasTexCoords = texCoords.size() == vertices.size();
+
+    std::unordered_map<FloatKey<8>, uint32_t, FloatKeyHash<8>> vertexMap;
+    std::unordered_map<FloatKey<3>, uint32_t, FloatKeyHash<3>> positionMap;
+    std::vector<uint32_t> positionClass;
+    std::vector<uint32_t> classSize;
+    vertexMap.reserve(vertices.size());
+    mesh.indices.reserve(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        glm::vec3 n = hasNormals ? normals[i] : glm::vec3(0.0f);
+        glm::vec2 t = hasTexCoords ? texCoords[i] : glm::vec2(0.0f);
+        FloatKey<8> key{{vertices[i].x, vertices[i].y, vertices[i].z, n.x, n.y, n.z, t.x, t.y}};
+        auto [it, inserted] = vertexMap.try_emplace(key, static_cast<uint32_t>(mesh.positions.size()));
+        if (inserted) {
+            mesh.positions.push_back(vertices[i]);
+            if (hasNormals) mesh.normals.push_back(n);
+            if (hasTexCoords) mesh.texCoords.push_back(t);
+            FloatKey<3> pkey{{vertices[i].x, vertices[i].y, vertices[i].z}};
+            auto [pit, pinserted] = positionMap.try_emplace(pkey, static_cast<uint32_t>(classSize.size()));
+            if (pinserted) classSize.push_back(0);
+            ++classSize[pit->second];
+            positionClass.push_back(pit->second);
+        }
+        mesh.indices.push_back(it->second);
+    }
+
+    // Count each undirected edge in position space: 1 is an open border, more than 2 is non-manifold
+    std::unordered_map<uint64_t, uint32_t> edgeUse;
+    edgeUse.reserve(mesh.indices.size());
+    for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+        for (int e = 0; e < 3; ++e) {
+            uint32_t a = positionClass[mesh.indices[t + e]];
+            uint32_t b = positionClass[mesh.indices[t + (e + 1) % 3]];
+            if (a > b) std::swap(a, b);
+            ++edgeUse[(uint64_t(a) << 32) | b];
+        }
+    }
+    std::vector<uint8_t> classLocked(classSize.size(), 0);
+    for (const auto& [edge, count] : edgeUse) {
+        if (count == 2) continue;
+        classLocked[edge >> 32] = 1;
+        classLocked[edge & 0xffffffffu] = 1;
+    }
+
+    mesh.locked.resize(mesh.positions.size());
+    for (size_t v = 0; v < mesh.positions.size(); ++v) {
+        uint32_t c = positionClass[v];
+        mesh.locked[v] = classLocked[c] || classSize[c] > 1;
+    }
+    return mesh;
+}
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+};
+
+// Collapses edges onto existing vertices until the target is reached or nothing cheap enough is left.
+// Returns the largest accepted cost. Works in passes: each pass sorts all edges by cost and takes an
+// independent set of collapses, so one-ring checks never see a half-updated neighbourhood.
+double simplify(const IndexedMesh& mesh, std::vector<uint32_t>& indices, size_t targetTriangles, double maxCost) {
+    const size_t vertexCount = mesh.positions.size();
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        const glm::dvec3 p0 = mesh.positions[indices[t]];
+        const glm::dvec3 p1 = mesh.positions[indices[t + 1]];
+        const glm::dvec3 p2 = mesh.positions[indices[t + 2]];
+        glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+        double area2 = glm::length(n);
+        if (area2 <= 0.0) continue;
+        n /= area2;
+        Quadric q = Quadric::fromPlane(n, -glm::dot(n, p0), area2 * 0.5);
+        for (int k = 0; k < 3; ++k) quadrics[indices[t + k]] += q;
+    }
+
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<Collapse> collapses;
+    double maxAccepted = 0.0;
+
+    size_t triangleCount = indices.size() / 3;
+    while (triangleCount > targetTriangles) {
+        // vertex -> triangle adjacency, CSR
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (uint32_t index : indices) ++adjacencyOffsets[index + 1];
+        for (size_t v = 0; v < vertexCount; ++v) adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        adjacency.resize(indices.size());
+        {
+            std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < indices.size(); ++i) adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        collapses.clear();
+        for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+            for (int e = 0; e < 3; ++e) {
+                uint32_t a = indices[t + e];
+                uint32_t b = indices[t + (e + 1) % 3];
+                // an interior edge shows up once in each direction, keep one of them
+                if (a > b || (mesh.locked[a] && mesh.locked[b])) continue;
+                Quadric q = quadrics[a];
+                q += quadrics[b];
+                double costAB = mesh.locked[a] ? -1.0 : q.evaluate(mesh.positions[b]);
+                double costBA = mesh.locked[b] ? -1.0 : q.evaluate(mesh.positions[a]);
+                if (costBA < 0.0 || (costAB >= 0.0 && costAB <= costBA))
+                    collapses.push_back({a, b, costAB});
+                else
+                    collapses.push_back({b, a, costBA});
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+        for (size_t v = 0; v < vertexCount; ++v) remap[v] = static_cast<uint32_t>(v);
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t removed = 0;
+        size_t accepted = 0;
+        const size_t toRemove = triangleCount - targetTriangles;
+
+        for (const Collapse& c : collapses) {
+            if (c.cost > maxCost) break;
+            if (touched[c.from] || touched[c.to]) continue;
+
+            // Reject collapses that flip a surviving triangle
+            bool flips = false;
+            size_t degenerate = 0;
+            const glm::vec3 target = mesh.positions[c.to];
+            for (uint32_t k = adjacencyOffsets[c.from]; k < adjacencyOffsets[c.from + 1] && !flips; ++k) {
+                const uint32_t* tri = &indices[size_t(adjacency[k]) * 3];
+                if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) {
+                    ++degenerate;
+                    continue;
+                }
+                glm::vec3 p[3], q[3];
+                for (int j = 0; j < 3; ++j) {
+                    p[j] = mesh.positions[tri[j]];
+                    q[j] = tri[j] == c.from ? target : p[j];
+                }
+                glm::vec3 n0 = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 n1 = glm::cross(q[1] - q[0], q[2] - q[0]);
+                flips = glm::dot(n0, n1) <= 0.0f;
+            }
+            if (flips) continue;
+
+            remap[c.from] = c.to;
+            quadrics[c.to] += quadrics[c.from];
+            // freeze the whole one-ring of the removed vertex for the rest of this pass
+            for (uint32_t k = adjacencyOffsets[c.from]; k < adjacencyOffsets[c.from + 1]; ++k) {
+                const uint32_t* tri = &indices[size_t(adjacency[k]) * 3];
+                touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+            }
+            maxAccepted = std::max(maxAccepted, c.cost);
+            ++accepted;
+            removed += degenerate;
+            if (removed >= toRemove) break;
+        }
+        if (!accepted) break;
+
+        size_t write = 0;
+        for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+            uint32_t a = remap[indices[t]], b = remap[indices[t + 1]], c = remap[indices[t + 2]];
+            if (a == b || b == c || a == c) continue;
+            indices[write++] = a;
+            indices[write++] = b;
+            indices[write++] = c;
+        }
+        indices.resize(write);
+        triangleCount = write / 3;
+    }
+    return maxAccepted;
+}
+
+LODLevel unweld(const IndexedMesh& mesh, const std::vector<uint32_t>& indices, double cost) {
+    LODLevel level;
+    level.vertices.reserve(indices.size());
+    for (uint32_t index : indices) {
+        level.vertices.push_back(mesh.positions[index]);
+        if (!mesh.normals.empty()) level.normals.push_back(mesh.normals[index]);
+        if (!mesh.texCoords.empty()) level.texCoords.push_back(mesh.texCoords[index]);
+    }
+    level.error = static_cast<float>(cost);
+    return level;
+}
+
+}
+
+namespace LOD {
+
+LODChain build(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals, const std::vector<glm::vec2>& texCoords) {
+    if (vertices.size() / 3 < MinTriangles) return nullptr;
+
+    IndexedMesh mesh = weld(vertices, normals, texCoords);
+    glm::vec3 lo = mesh.positions.empty() ? glm::vec3(0.0f) : mesh.positions[0], hi = lo;
+    for (const auto& p : mesh.positions) {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    // Quadric costs are squared distances weighted by area, cap them relative to the shape's size
+    const double diagonal = glm::length(hi - lo);
+    const double maxCost = (0.05 * diagonal) * (0.05 * diagonal) * (0.05 * diagonal) * (0.05 * diagonal);
+
+    auto levels = std::make_shared<std::vector<LODLevel>>();
+    std::vector<uint32_t> indices = mesh.indices;
+    size_t previous = indices.size() / 3;
+    for (size_t level = 0; level < MaxLevels; ++level) {
+        double cost = simplify(mesh, indices, previous / 2, maxCost);
+        size_t triangles = indices.size() / 3;
+        // Stop once a level barely improves on the one before it
+        if (triangles == 0 || triangles > previous * 4 / 5) break;
+        levels->push_back(unweld(mesh, indices, cost));
+        previous = triangles;
+    }
+
+    return levels->empty() ? nullptr : LODChain(std::move(levels));
+}
+
+}
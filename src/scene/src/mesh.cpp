@@ -0,0 +1,53 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#include "scene/mesh.h"
+
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+struct VertexKey {
+    float v[8];
+    bool operator==(const VertexKey& o) const { return std::memcmp(v, o.v, sizeof(v)) == 0; }
+};
+
+struct VertexKeyHash {
+    size_t operator()(const VertexKey& k) const {
+        uint64_t h = 1469598103934665603ull;
+        const auto* bytes = reinterpret_cast<const unsigned char*>(k.v);
+        for (size_t i = 0; i < sizeof(k.v); ++i) h = (h ^ bytes[i]) * 1099511628211ull;
+        return static_cast<size_t>(h);
+    }
+};
+
+}
+
+namespace Mesh {
+
+WeldedMesh weld(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals, const std::vector<glm::vec2>& texCoords) {
+    WeldedMesh mesh;
+    const bool hasNormals = normals.size() == vertices.size();
+    const bool hasTexCoords = texCoords.size() == vertices.size();
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> vertexMap;
+    vertexMap.reserve(vertices.size());
+    mesh.indices.reserve(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        glm::vec3 n = hasNormals ? normals[i] : glm::vec3(0.0f);
+        glm::vec2 t = hasTexCoords ? texCoords[i] : glm::vec2(0.0f);
+        VertexKey key{{vertices[i].x, vertices[i].y, vertices[i].z, n.x, n.y, n.z, t.x, t.y}};
+        auto [it, inserted] = vertexMap.try_emplace(key, static_cast<uint32_t>(mesh.positions.size()));
+        if (inserted) {
+            mesh.positions.push_back(vertices[i]);
+            if (hasNormals) mesh.normals.push_back(n);
+            if (hasTexCoords) mesh.texCoords.push_back(t);
+        }
+        mesh.indices.push_back(it->second);
+    }
+    return mesh;
+}
+
+}
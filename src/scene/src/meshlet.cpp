@@ -0,0 +1,162 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#include "scene/meshlet.h"
+#include "scene/mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+void computeBounds(Meshlet& meshlet, const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& vertices) {
+    glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+    for (uint32_t k = 0; k < meshlet.indexCount; ++k) {
+        const glm::vec3& p = vertices[indices[meshlet.firstIndex + k]];
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    meshlet.center = (lo + hi) * 0.5f;
+    float radius2 = 0.0f;
+    glm::vec3 normalSum(0.0f);
+    for (uint32_t k = 0; k < meshlet.indexCount; k += 3) {
+        const glm::vec3& p0 = vertices[indices[meshlet.firstIndex + k]];
+        const glm::vec3& p1 = vertices[indices[meshlet.firstIndex + k + 1]];
+        const glm::vec3& p2 = vertices[indices[meshlet.firstIndex + k + 2]];
+        for (const glm::vec3* p : {&p0, &p1, &p2}) {
+            glm::vec3 d = *p - meshlet.center;
+            radius2 = std::max(radius2, glm::dot(d, d));
+        }
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(n);
+        if (length > 0.0f) normalSum += n / length;
+    }
+    meshlet.radius = std::sqrt(radius2);
+
+    // Normal cone: the widest angle between the mean normal and any triangle normal
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+    float sumLength = glm::length(normalSum);
+    if (sumLength <= 0.0f) return;
+    glm::vec3 axis = normalSum / sumLength;
+    float minDot = 1.0f;
+    for (uint32_t k = 0; k < meshlet.indexCount; k += 3) {
+        const glm::vec3& p0 = vertices[indices[meshlet.firstIndex + k]];
+        glm::vec3 n = glm::cross(vertices[indices[meshlet.firstIndex + k + 1]] - p0, vertices[indices[meshlet.firstIndex + k + 2]] - p0);
+        float length = glm::length(n);
+        if (length > 0.0f) minDot = std::min(minDot, glm::dot(n / length, axis));
+    }
+    meshlet.coneAxis = axis;
+    // Past ~84 degrees the cone almost never culls, keep the test off
+    if (minDot > 0.1f) meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+}
+
+namespace Meshlets {
+
+std::shared_ptr<const MeshletData> build(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals, const std::vector<glm::vec2>& texCoords) {
+    const size_t triangleCount = vertices.size() / 3;
+    if (triangleCount < MinTriangles) return nullptr;
+
+    const WeldedMesh mesh = Mesh::weld(vertices, normals, texCoords);
+    const std::vector<uint32_t>& canonical = mesh.indices;
+    const size_t vertexCount = mesh.positions.size();
+
+    // welded vertex -> triangles, CSR
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i) ++offsets[canonical[i] + 1];
+    for (size_t v = 0; v < vertexCount; ++v) offsets[v + 1] += offsets[v];
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i) adjacency[fill[canonical[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    auto data = std::make_shared<MeshletData>();
+    data->indices.reserve(triangleCount * 3);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint8_t> inMeshlet(vertexCount, 0);
+    std::vector<uint32_t> meshletVertices;
+    std::vector<uint32_t> candidates;
+    size_t seed = 0;
+
+    auto newVertexCount = [&](uint32_t triangle) {
+        uint32_t count = 0;
+        for (int k = 0; k < 3; ++k) count += !inMeshlet[canonical[triangle * 3 + k]];
+        return count;
+    };
+
+    while (true) {
+        while (seed < triangleCount && emitted[seed]) ++seed;
+        if (seed == triangleCount) break;
+
+        Meshlet meshlet{};
+        meshlet.firstIndex = static_cast<uint32_t>(data->indices.size());
+        meshletVertices.clear();
+        candidates.clear();
+        uint32_t next = static_cast<uint32_t>(seed);
+
+        while (true) {
+            uint32_t added = newVertexCount(next);
+            if (meshletVertices.size() + added > MaxVertices || meshlet.indexCount / 3 >= MaxTriangles) break;
+
+            emitted[next] = 1;
+            for (int k = 0; k < 3; ++k) {
+                uint32_t v = canonical[next * 3 + k];
+                data->indices.push_back(v);
+                if (!inMeshlet[v]) {
+                    inMeshlet[v] = 1;
+                    meshletVertices.push_back(v);
+                    for (uint32_t a = offsets[v]; a < offsets[v + 1]; ++a) {
+                        if (!emitted[adjacency[a]]) candidates.push_back(adjacency[a]);
+                    }
+                }
+            }
+            meshlet.indexCount += 3;
+
+            // Best neighbour: fewest new vertices, drop candidates emitted in the meantime
+            uint32_t best = UINT32_MAX, bestAdded = 4;
+            size_t write = 0;
+            for (uint32_t candidate : candidates) {
+                if (emitted[candidate]) continue;
+                candidates[write++] = candidate;
+                uint32_t candidateAdded = newVertexCount(candidate);
+                if (candidateAdded < bestAdded) {
+                    best = candidate;
+                    bestAdded = candidateAdded;
+                }
+            }
+            candidates.resize(write);
+            if (best == UINT32_MAX) break;
+            next = best;
+        }
+
+        for (uint32_t v : meshletVertices) inMeshlet[v] = 0;
+        meshlet.vertexCount = static_cast<uint32_t>(meshletVertices.size());
+        computeBounds(meshlet, data->indices, mesh.positions);
+        data->meshlets.push_back(meshlet);
+    }
+    return data;
+}
+
+bool frustumVisible(const Meshlet& meshlet, const glm::mat4& modelMatrix, const Frustum& frustum) {
+    glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(meshlet.center, 1.0f));
+    float scale = std::max({glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))});
+    return frustum.intersectsSphere(center, meshlet.radius * scale);
+}
+
+bool coneVisible(const Meshlet& meshlet, const glm::mat4& modelMatrix, const glm::vec3& cameraPosition) {
+    if (meshlet.coneCutoff >= 1.0f) return true;
+    glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(meshlet.center, 1.0f));
+    float scale = std::max({glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))});
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelMatrix)));
+    glm::vec3 axis = glm::normalize(normalMatrix * meshlet.coneAxis);
+    glm::vec3 d = center - cameraPosition;
+    // Every triangle faces away from every point of the bounding sphere
+    return glm::dot(d, axis) < meshlet.coneCutoff * glm::length(d) + meshlet.radius * scale;
+}
+
+}
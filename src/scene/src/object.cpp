@@ -3,3 +3,39 @@
 //
 
 #include "scene/object.h"
+#include "profiler/profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <thread>
+
+template<typename F>
+void Object::forEachShapeParallel(F&& f) {
+    std::atomic<size_t> next{0};
+    std::vector<Shape>& shapes = data->shapes;
+    auto worker = [&shapes, &next, &f] {
+        for (size_t i = next++; i < shapes.size(); i = next++) f(shapes[i]);
+    };
+
+    size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), shapes.size());
+    std::vector<std::future<void>> workers;
+    for (size_t i = 1; i < threadCount; ++i) {
+        workers.push_back(std::async(std::launch::async, worker));
+    }
+    worker();
+    for (auto& w : workers) w.get();
+}
+
+void Object::buildLODs() {
+    TR_PROFILE_ZONE("build LODs");
+    forEachShapeParallel([](Shape& shape) {
+        shape.lods = LOD::build(shape.vertices, shape.normals, shape.texCoords);
+    });
+}
+
+void Object::buildMeshlets() {
+    TR_PROFILE_ZONE("build meshlets");
+    forEachShapeParallel([](Shape& shape) {
+        shape.meshlets = Meshlets::build(shape.vertices, shape.normals, shape.texCoords);
+    });
+}
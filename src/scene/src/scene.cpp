@@ -3,21 +3,31 @@
 //
 
 #include "scene/scene.h"
+#include "scene/sceneLoader.h"
+#include "profiler/profiler.h"
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 #include "happly.h"
 #include <algorithm>
-#include <nlohmann/json.hpp>
+#include <fstream>
+#include <functional>
+#include <unordered_map>
 namespace fs = std::filesystem;
 
 Scene::Scene() {
     mCamera = nullptr;
+    mGraph = std::make_shared<SceneGraph>();
 }
 
-void Scene::addObject(std::shared_ptr<Object> object) {
+void Scene::addObject(std::shared_ptr<Object> object, SceneGraph::NodeId parent) {
+    object->attach(mGraph, mGraph->create(parent));
     mObjects.push_back(object);
 }
 
+SceneGraph::NodeId Scene::addGroup(const Transform& local, SceneGraph::NodeId parent) {
+    return mGraph->create(parent, local);
+}
+
 void Scene::setCamera(std::shared_ptr<Camera> camera) {
     mCamera = camera;
 }
@@ -47,71 +57,93 @@ void Scene::loadOBJModel(const fs::path &path, const std::shared_ptr<Object> &mo
         throw std::runtime_error("No shapes found in model");
     }
 
-    // load vertices information(pos, normal, texcoord)
+    // One shape per material a face uses, so every shape draws with a single material.
+    // Faces are triangles, tinyobj triangulates while loading
     for (const auto& shape : shapes) {
-        Shape _shape;
-        _shape.name = shape.name;
-        for (const auto& index : shape.mesh.indices) {
-            glm::vec3 vertex = {
-                    attrib.vertices[3 * index.vertex_index + 0],
-                    attrib.vertices[3 * index.vertex_index + 1],
-                    attrib.vertices[3 * index.vertex_index + 2]
-            };
-            _shape.vertices.push_back(vertex);
-
-            if (!attrib.normals.empty()) {
-                glm::vec3 normal = {
-                        attrib.normals[3 * index.normal_index + 0],
-                        attrib.normals[3 * index.normal_index + 1],
-                        attrib.normals[3 * index.normal_index + 2]
+        std::vector<int> used;      // material ids in the order faces first use them
+        std::unordered_map<int, Shape> parts;
+        for (size_t face = 0; face < shape.mesh.material_ids.size(); ++face) {
+            int id = shape.mesh.material_ids[face];
+            if (id >= static_cast<int>(materials.size())) id = -1;
+            auto [it, inserted] = parts.try_emplace(id);
+            Shape& _shape = it->second;
+            if (inserted) used.push_back(id);
+
+            for (size_t corner = 0; corner < 3; ++corner) {
+                const auto& index = shape.mesh.indices[3 * face + corner];
+                glm::vec3 vertex = {
+                        attrib.vertices[3 * index.vertex_index + 0],
+                        attrib.vertices[3 * index.vertex_index + 1],
+                        attrib.vertices[3 * index.vertex_index + 2]
                 };
-                _shape.normals.push_back(normal);
-            }
+                _shape.vertices.push_back(vertex);
+
+                if (!attrib.normals.empty()) {
+                    glm::vec3 normal = {
+                            attrib.normals[3 * index.normal_index + 0],
+                            attrib.normals[3 * index.normal_index + 1],
+                            attrib.normals[3 * index.normal_index + 2]
+                    };
+                    _shape.normals.push_back(normal);
+                }
 
-            if (!attrib.texcoords.empty()) {
-                glm::vec2 texCoord = {
-                        attrib.texcoords[2 * index.texcoord_index + 0],
-                        attrib.texcoords[2 * index.texcoord_index + 1]
-                };
-                _shape.texCoords.push_back(texCoord);
+                if (!attrib.texcoords.empty()) {
+                    glm::vec2 texCoord = {
+                            attrib.texcoords[2 * index.texcoord_index + 0],
+                            attrib.texcoords[2 * index.texcoord_index + 1]
+                    };
+                    _shape.texCoords.push_back(texCoord);
+                }
             }
         }
-        if(attrib.normals.empty())
-        {
-            _shape.normals.resize(_shape.vertices.size(), glm::vec3(0.0f));
-            for (size_t i = 0; i < shape.mesh.indices.size(); i += 3) {
 
-                size_t v0_idx = i;
-                size_t v1_idx = i + 1;
-                size_t v2_idx = i + 2;
-
-                glm::vec3 v0 = _shape.vertices[v0_idx];
-                glm::vec3 v1 = _shape.vertices[v1_idx];
-                glm::vec3 v2 = _shape.vertices[v2_idx];
+        for (int id : used) {
+            Shape& _shape = parts[id];
+            _shape.name = used.size() > 1 && id >= 0 ? shape.name + "/" + materials[id].name : shape.name;
+            if (attrib.normals.empty())
+            {
+                _shape.normals.resize(_shape.vertices.size(), glm::vec3(0.0f));
+                for (size_t i = 0; i < _shape.vertices.size(); i += 3) {
+                    glm::vec3 v0 = _shape.vertices[i];
+                    glm::vec3 v1 = _shape.vertices[i + 1];
+                    glm::vec3 v2 = _shape.vertices[i + 2];
 
-                glm::vec3 faceNormal = glm::cross(v1 - v0, v2 - v0);
+                    glm::vec3 faceNormal = glm::cross(v1 - v0, v2 - v0);
 
-                _shape.normals[v0_idx] += faceNormal;
-                _shape.normals[v1_idx] += faceNormal;
-                _shape.normals[v2_idx] += faceNormal;
-            }
+                    _shape.normals[i] += faceNormal;
+                    _shape.normals[i + 1] += faceNormal;
+                    _shape.normals[i + 2] += faceNormal;
+                }
 
-            for (auto& normal : _shape.normals) {
-                if (glm::length(normal) > 0.0001f) {
-                    normal = glm::normalize(normal);
+                for (auto& normal : _shape.normals) {
+                    if (glm::length(normal) > 0.0001f) {
+                        normal = glm::normalize(normal);
+                    }
                 }
             }
-        }
 
-        if (!materials.empty() && shape.mesh.material_ids[0] >= 0) {
-            size_t material_id = shape.mesh.material_ids[0];
-            if (material_id < materials.size() && !materials[material_id].diffuse_texname.empty()) {
-                std::filesystem::path texture_path = base_dir / materials[material_id].diffuse_texname;
-                _shape.texturePath = texture_path.string();
+            if (id >= 0) {
+                const tinyobj::material_t& mtl = materials[id];
+                _shape.material.diffuse = {mtl.diffuse[0], mtl.diffuse[1], mtl.diffuse[2]};
+                _shape.material.specular = {mtl.specular[0], mtl.specular[1], mtl.specular[2]};
+                _shape.material.emissive = {mtl.emission[0], mtl.emission[1], mtl.emission[2]};
+                _shape.material.shininess = mtl.shininess;
+                _shape.material.alpha = mtl.dissolve;
+                if (!mtl.diffuse_texname.empty())
+                    _shape.material.diffuseTexture = (base_dir / mtl.diffuse_texname).string();
+                if (!mtl.alpha_texname.empty())
+                    _shape.material.alphaTexture = (base_dir / mtl.alpha_texname).string();
+                // An alpha map alone is a cutout, like leaves or fences. A dissolve below one or a
+                // transparency illumination model (glass) blends
+                const bool transparentIllum = mtl.illum == 4 || mtl.illum == 6 || mtl.illum == 7 || mtl.illum == 9;
+                if (mtl.dissolve < 1.0f || (!mtl.alpha_texname.empty() && transparentIllum))
+                    _shape.material.alphaMode = AlphaMode::Blend;
+                else if (!mtl.alpha_texname.empty())
+                    _shape.material.alphaMode = AlphaMode::Mask;
             }
-        }
 
-        model->addShape(_shape);
+            model->addShape(_shape);
+        }
     }
 }
 
@@ -229,63 +261,38 @@ void Scene::loadPLYModel(const std::filesystem::path&path, const std::shared_ptr
     model->addShape(_shape);
 }
 
-void Scene::loadJSON(const std::filesystem::path &path)
-{
-    std::ifstream file(path);
-    if(!file.is_open())
-    {
-        std::cerr << "Failed to open file: " << path << std::endl;
-        return;
+std::shared_ptr<Object> Scene::loadModelFile(const std::filesystem::path& path) {
+    TR_PROFILE_ZONE("load model");
+    std::string extension = path.extension().string();
+    const auto it = loadModelFunctions.find(extension);
+    if (it == loadModelFunctions.end()) {
+        std::cerr << "Unsupported file format: " << extension << std::endl;
+        return nullptr;
     }
-    nlohmann::json config = nlohmann::json::parse(file);
-    if(config.contains("objects"))
-    {
-        auto object = config["objects"];
-        for(auto &obj : object)
-        {
-            if(obj.contains("file"))
-            {
-                const std::filesystem::path &filePath = obj["file"];
-                auto mobject = std::make_shared<Object>();
-                std::string extension = filePath.extension().string();
-                const auto it = loadModelFunctions.find(extension);
-                if (it != loadModelFunctions.end()) {
-                    it->second(filePath, mobject);
-                } else {
-                    std::cerr << "Unsupported file format: " << extension << std::endl;
-                }
-                mobject->setModelMatrix(glm::vec3{0.0f, 0.0f, 0.0f});
-                if(obj.contains("position"))
-                {
-                    glm::vec3 pos = glm::vec3{obj["position"][0], obj["position"][1], obj["position"][2]};
-                    mobject->setModelMatrix(pos);
-                }
-                if(obj.contains("scale"))
-                {
-                    glm::vec3 scale = glm::vec3 {obj["scale"][0], obj["scale"][1], obj["scale"][2]};
-                    mobject->scale(scale);
-                }
-                if(obj.contains("rotation"))
-                {
-                    if(obj["rotation"].contains("type"))
-                    {
-                        if(obj["rotation"]["type"] == "euler_xyz")
-                        {
-                            glm::vec3 rot = glm::vec3{obj["rotation"]["data"][0], obj["rotation"]["data"][1], obj["rotation"]["data"][2]};
-                            mobject->rotateEulerXYZ(rot.x, rot.y, rot.z);
-                        }
-                        if(obj["rotation"]["type"] == "quaternion")
-                        {
-                            glm::quat quaternion = glm::quat(obj["rotation"]["data"][0], obj["rotation"]["data"][1],
-                                                             obj["rotation"]["data"][2], obj["rotation"]["data"][3]);
-                            mobject->rotateQuaternion(quaternion);
-                        }
-                    }
-                }
-                addObject(mobject);
-            }
+    std::error_code error;
+    std::string key = fs::weakly_canonical(path, error).string();
+    if (error) key = path.string();
+    if (auto cached = mLoadedFiles.find(key); cached != mLoadedFiles.end()) {
+        if (auto data = cached->second.lock()) {
+            auto model = std::make_shared<Object>(std::move(data));
+            model->setName(path.stem().string());
+            return model;
         }
     }
+    auto data = std::make_shared<ModelData>();
+    auto model = std::make_shared<Object>(data);
+    it->second(path, model);
+    model->buildLODs();
+    model->buildMeshlets();
+    mLoadedFiles[key] = data;
+    return model;
+}
+
+void Scene::loadJSON(const std::filesystem::path &path)
+{
+    TR_PROFILE_ZONE("load scene");
+    SceneLoader(*this).load(path);
+    mGraph->update();
 }
 
 void Scene::addModel(const std::filesystem::path &filePath) {
@@ -295,19 +302,27 @@ void Scene::addModel(const std::filesystem::path &filePath) {
         loadJSON(filePath);
         return;
     }
-    const auto it = loadModelFunctions.find(extension);
-    if (it != loadModelFunctions.end()) {
-        auto model = std::make_shared<Object>();
-        it->second(filePath, model);
+    if (auto model = loadModelFile(filePath)) {
         addObject(model);
-    } else {
-        std::cerr << "Unsupported file format: " << extension << std::endl;
+        mGraph->update();
     }
 }
 
-void Scene::removeModel(const std::shared_ptr<Object>& model) {
-    auto it = std::find(mObjects.begin(), mObjects.end(), model);
-    if (it != mObjects.end()) {
-        mObjects.erase(it);
-    }
-}
\ No newline at end of file
+std::vector<std::shared_ptr<Object>> Scene::removeModel(const std::shared_ptr<Object>& model) {
+    std::vector<std::shared_ptr<Object>> removed;
+    if (std::find(mObjects.begin(), mObjects.end(), model) == mObjects.end()) return removed;
+    SceneGraph::NodeId root = model->getNode();
+    auto inSubtree = [this, root](SceneGraph::NodeId node) {
+        for (; node != SceneGraph::none; node = mGraph->parent(node))
+            if (node == root) return true;
+        return false;
+    };
+    std::erase_if(mObjects, [&](const std::shared_ptr<Object>& object) {
+        if (!inSubtree(object->getNode())) return false;
+        object->detach();
+        removed.push_back(object);
+        return true;
+    });
+    mGraph->remove(root);
+    return removed;
+}
@@ -0,0 +1,109 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#include "scene/sceneGraph.h"
+#include <algorithm>
+
+Transform Transform::fromMatrix(const glm::mat4& m) {
+    Transform t;
+    glm::mat3 basis(m);
+    t.translation = glm::vec3(m[3]);
+    t.scale = { glm::length(basis[0]), glm::length(basis[1]), glm::length(basis[2]) };
+    if (glm::determinant(basis) < 0.0f) t.scale.x = -t.scale.x;
+    if (t.scale.x != 0.0f && t.scale.y != 0.0f && t.scale.z != 0.0f) {
+        basis[0] /= t.scale.x;
+        basis[1] /= t.scale.y;
+        basis[2] /= t.scale.z;
+        t.rotation = glm::normalize(glm::quat_cast(basis));
+    }
+    return t;
+}
+
+SceneGraph::NodeId SceneGraph::create(NodeId parent, const Transform& local) {
+    NodeId handle;
+    if (!mFreeHandles.empty()) {
+        handle = mFreeHandles.back();
+        mFreeHandles.pop_back();
+    } else {
+        handle = static_cast<NodeId>(mIndexOf.size());
+        mIndexOf.push_back(none);
+    }
+    // Appending keeps parents first, the parent is already somewhere before the end
+    auto index = static_cast<uint32_t>(mHandle.size());
+    mParent.push_back(valid(parent) ? mIndexOf[parent] : none);
+    mLocal.push_back(local);
+    mWorld.emplace_back(1.0f);
+    mDirty.push_back(1);
+    mHandle.push_back(handle);
+    mIndexOf[handle] = index;
+    mAnyDirty = true;
+    return handle;
+}
+
+std::vector<SceneGraph::NodeId> SceneGraph::remove(NodeId node) {
+    std::vector<NodeId> removed;
+    if (!valid(node)) return removed;
+    // Descendants come after the node, and a live node never has a removed parent,
+    // so one pass that follows removed parents finds the whole subtree
+    uint32_t first = mIndexOf[node];
+    for (uint32_t i = first; i < mHandle.size(); ++i) {
+        if (mHandle[i] == none) continue;
+        if (i != first && (mParent[i] == none || mHandle[mParent[i]] != none)) continue;
+        removed.push_back(mHandle[i]);
+        mIndexOf[mHandle[i]] = none;
+        mFreeHandles.push_back(mHandle[i]);
+        mHandle[i] = none;
+        ++mRemoved;
+    }
+    return removed;
+}
+
+SceneGraph::NodeId SceneGraph::parent(NodeId node) const {
+    uint32_t p = mParent[mIndexOf[node]];
+    return p == none ? none : mHandle[p];
+}
+
+void SceneGraph::setLocal(NodeId node, const Transform& local) {
+    uint32_t i = mIndexOf[node];
+    mLocal[i] = local;
+    mDirty[i] = 1;
+    mAnyDirty = true;
+}
+
+void SceneGraph::update() {
+    if (mRemoved) compact();
+    if (!mAnyDirty) return;
+    // A parent is visited before its children, its flag tells them its world matrix moved
+    for (size_t i = 0; i < mHandle.size(); ++i) {
+        uint32_t p = mParent[i];
+        if (p != none && mDirty[p]) mDirty[i] = 1;
+        if (!mDirty[i]) continue;
+        mWorld[i] = p == none ? mLocal[i].matrix() : mWorld[p] * mLocal[i].matrix();
+    }
+    std::fill(mDirty.begin(), mDirty.end(), 0);
+    mAnyDirty = false;
+}
+
+void SceneGraph::compact() {
+    // Order is kept, so parents stay first and are remapped before their children
+    std::vector<uint32_t> newIndex(mHandle.size(), none);
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < mHandle.size(); ++i) {
+        if (mHandle[i] == none) continue;
+        newIndex[i] = count;
+        mParent[count] = mParent[i] == none ? none : newIndex[mParent[i]];
+        mLocal[count] = mLocal[i];
+        mWorld[count] = mWorld[i];
+        mDirty[count] = mDirty[i];
+        mHandle[count] = mHandle[i];
+        mIndexOf[mHandle[count]] = count;
+        ++count;
+    }
+    mParent.resize(count);
+    mLocal.resize(count);
+    mWorld.resize(count);
+    mDirty.resize(count);
+    mHandle.resize(count);
+    mRemoved = 0;
+}
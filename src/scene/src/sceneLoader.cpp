@@ -0,0 +1,370 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#include "scene/sceneLoader.h"
+#include "scene/scene.h"
+#include "camera/intrinsics.h"
+#include "camera/orthographic.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <nlohmann/json.hpp>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+
+// Builds the DOM one "objects" entry at a time and hands it over once it is complete.
+// Instance data arrays are diverted into streams, the DOM keeps {"stream": index} in their place
+class SceneSax : public nlohmann::json_sax<json> {
+public:
+    using EntryCallback = std::function<void(const json& entry, std::vector<std::vector<float>>& streams)>;
+
+    explicit SceneSax(EntryCallback onEntry) : mOnEntry(std::move(onEntry)) {}
+
+    const std::string& error() const { return mError; }
+    // Everything outside the "objects" entries, once parsed
+    const json& root() const { return mRoot; }
+
+    bool null() override { return value(nullptr); }
+    bool boolean(bool val) override { return value(val); }
+    bool number_integer(number_integer_t val) override { return number(static_cast<double>(val)) || value(val); }
+    bool number_unsigned(number_unsigned_t val) override { return number(static_cast<double>(val)) || value(val); }
+    bool number_float(number_float_t val, const string_t&) override { return number(val) || value(val); }
+    bool string(string_t& val) override { return value(std::move(val)); }
+    bool binary(binary_t& val) override { return value(json::binary(std::move(val))); }
+
+    bool start_object(std::size_t) override {
+        if (mStreamDepth) return fail("instance data may only hold numbers");
+        open(json::object());
+        return true;
+    }
+    bool key(string_t& val) override {
+        mKey = std::move(val);
+        return true;
+    }
+    bool end_object() override {
+        // Root, "objects", entry
+        bool entry = mStack.size() == 3 && mKeys[1] == "objects" && mStack[1]->is_array();
+        if (entry) mOnEntry(*mStack.back(), mStreams);
+        close();
+        if (entry) {
+            mStack.back()->get_ref<json::array_t&>().pop_back();
+            mStreams.clear();
+        }
+        return true;
+    }
+    bool start_array(std::size_t) override {
+        if (mStreamDepth) {
+            ++mStreamDepth;
+            return true;
+        }
+        if (!mStack.empty() && mStack.back()->is_object() && mKey == "data" && mKeys.back() == "instances") {
+            (*mStack.back())["data"] = {{"stream", mStreams.size()}};
+            mStreams.emplace_back();
+            mStreamDepth = 1;
+            return true;
+        }
+        open(json::array());
+        return true;
+    }
+    bool end_array() override {
+        if (mStreamDepth) {
+            --mStreamDepth;
+            return true;
+        }
+        close();
+        return true;
+    }
+    bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& e) override {
+        return fail(std::string(e.what()) + " at byte " + std::to_string(position));
+    }
+
+private:
+    // True when the number went into a stream
+    bool number(double val) {
+        if (!mStreamDepth) return false;
+        mStreams.back().push_back(static_cast<float>(val));
+        return true;
+    }
+    template<typename T>
+    bool value(T&& val) {
+        if (mStreamDepth) return fail("instance data may only hold numbers");
+        if (mStack.empty()) {
+            mRoot = std::forward<T>(val);
+        } else if (mStack.back()->is_array()) {
+            mStack.back()->push_back(std::forward<T>(val));
+        } else {
+            (*mStack.back())[mKey] = std::forward<T>(val);
+        }
+        return true;
+    }
+    // Only the newest element of a container is ever written to, so these pointers stay valid
+    void open(json container) {
+        std::string key = mStack.empty() || mStack.back()->is_array() ? std::string() : mKey;
+        if (mStack.empty()) {
+            mRoot = std::move(container);
+            mStack.push_back(&mRoot);
+        } else if (mStack.back()->is_array()) {
+            mStack.back()->push_back(std::move(container));
+            mStack.push_back(&mStack.back()->back());
+        } else {
+            json& slot = (*mStack.back())[mKey];
+            slot = std::move(container);
+            mStack.push_back(&slot);
+        }
+        mKeys.push_back(std::move(key));
+    }
+    void close() {
+        mStack.pop_back();
+        mKeys.pop_back();
+    }
+    bool fail(std::string message) {
+        mError = std::move(message);
+        return false;
+    }
+
+    EntryCallback mOnEntry;
+    json mRoot;
+    std::vector<json*> mStack;
+    std::vector<std::string> mKeys;     // the key each open container was stored under, empty in arrays
+    std::string mKey;
+    std::vector<std::vector<float>> mStreams;
+    int mStreamDepth = 0;
+    std::string mError;
+};
+
+glm::vec3 vec3At(const json& value) {
+    return { value[0].get<float>(), value[1].get<float>(), value[2].get<float>() };
+}
+
+Transform parseTransform(const json& entry) {
+    Transform local;
+    if (entry.contains("position")) local.translation = vec3At(entry["position"]);
+    if (entry.contains("scale")) local.scale = vec3At(entry["scale"]);
+    if (entry.contains("rotation") && entry["rotation"].contains("type")) {
+        const auto& rotation = entry["rotation"];
+        const auto& data = rotation["data"];
+        if (rotation["type"] == "euler_xyz") {
+            glm::quat rotX = glm::angleAxis(glm::radians(data[0].get<float>()), glm::vec3(1.0f, 0.0f, 0.0f));
+            glm::quat rotY = glm::angleAxis(glm::radians(data[1].get<float>()), glm::vec3(0.0f, 1.0f, 0.0f));
+            glm::quat rotZ = glm::angleAxis(glm::radians(data[2].get<float>()), glm::vec3(0.0f, 0.0f, 1.0f));
+            local.rotation = rotZ * rotY * rotX;
+        }
+        if (rotation["type"] == "quaternion") {
+            local.rotation = glm::normalize(glm::quat(data[0].get<float>(), data[1].get<float>(),
+                                                      data[2].get<float>(), data[3].get<float>()));
+        }
+    }
+    return local;
+}
+
+enum class InstanceLayout { T, TR, TRS, MATRIX };
+
+size_t stride(InstanceLayout layout) {
+    switch (layout) {
+        case InstanceLayout::T: return 3;
+        case InstanceLayout::TR: return 7;
+        case InstanceLayout::TRS: return 10;
+        case InstanceLayout::MATRIX: return 16;
+    }
+    return 0;
+}
+
+Transform decode(InstanceLayout layout, const float* r) {
+    if (layout == InstanceLayout::MATRIX) {
+        glm::mat4 m(1.0f);
+        for (int c = 0; c < 4; ++c)
+            m[c] = glm::vec4(r[c * 4], r[c * 4 + 1], r[c * 4 + 2], r[c * 4 + 3]);
+        return Transform::fromMatrix(m);
+    }
+    Transform t;
+    t.translation = glm::vec3(r[0], r[1], r[2]);
+    if (layout != InstanceLayout::T) t.rotation = glm::normalize(glm::quat(r[3], r[4], r[5], r[6]));
+    if (layout == InstanceLayout::TRS) t.scale = glm::vec3(r[7], r[8], r[9]);
+    return t;
+}
+
+}
+
+bool SceneLoader::load(const fs::path& path, SceneGraph::NodeId parent) {
+    std::error_code error;
+    fs::path canonical = fs::weakly_canonical(path, error);
+    if (error) canonical = path;
+    if (std::find(mIncludes.begin(), mIncludes.end(), canonical) != mIncludes.end()) {
+        std::cerr << "Scene includes itself: " << path << std::endl;
+        return false;
+    }
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file: " << path << std::endl;
+        return false;
+    }
+
+    mIncludes.push_back(canonical);
+    const fs::path directory = path.parent_path();
+    SceneSax sax([&](const json& entry, Streams& streams) {
+        loadEntry(entry, parent, streams, directory);
+    });
+    bool parsed = json::sax_parse(file, &sax);
+    mIncludes.pop_back();
+    if (!parsed) std::cerr << "Failed to parse " << path << ": " << sax.error() << std::endl;
+    // Included files only add objects
+    else if (mIncludes.empty() && sax.root().is_object()) loadCamera(sax.root());
+    return parsed;
+}
+
+void SceneLoader::loadCamera(const json& root) {
+    if (root.contains("resolution"))
+        mScene.setResolution(root["resolution"][0].get<int>(), root["resolution"][1].get<int>());
+    if (!root.contains("camera")) return;
+    const json& block = root["camera"];
+    const glm::ivec2 resolution = mScene.getResolution();
+
+    std::shared_ptr<Camera> camera;
+    if (block.contains("fx")) {
+        if (resolution.x <= 0 || resolution.y <= 0) {
+            std::cerr << "Camera intrinsics need a \"resolution\"" << std::endl;
+            return;
+        }
+        float fx = block["fx"].get<float>();
+        camera = std::make_shared<IntrinsicsCamera>(fx, block.value("fy", fx),
+                                                    block.value("cx", resolution.x * 0.5f), block.value("cy", resolution.y * 0.5f),
+                                                    resolution.x, resolution.y);
+    } else if (block.value("type", std::string("perspective")) == "orthographic") {
+        camera = std::make_shared<OrthographicCamera>();
+    } else {
+        camera = std::make_shared<PerspectiveCamera>();
+        if (block.contains("fov")) camera->setFov(block["fov"].get<float>());
+    }
+    if (auto perspective = std::dynamic_pointer_cast<PerspectiveCamera>(camera)) {
+        if (block.contains("near")) perspective->setNear(block["near"].get<float>());
+        if (block.contains("far")) perspective->setFar(block["far"].get<float>());
+    }
+
+    glm::vec3 position = block.contains("position") ? vec3At(block["position"]) : glm::vec3(0.0f);
+    camera->setPosition(position);
+    glm::vec3 forward(0.0f, 0.0f, -1.0f);
+    if (block.contains("look_at")) forward = vec3At(block["look_at"]) - position;
+    else if (block.contains("rotation")) forward = parseTransform(block).rotation * forward;
+    float yaw = -90.0f, pitch = 0.0f;
+    if (glm::length(forward) > 0.0f) {
+        forward = glm::normalize(forward);
+        yaw = glm::degrees(std::atan2(forward.z, forward.x));
+        pitch = glm::degrees(std::asin(glm::clamp(forward.y, -1.0f, 1.0f)));
+    }
+    // Straight up or down has no yaw
+    camera->setRotation(block.value("yaw", yaw), glm::clamp(block.value("pitch", pitch), -89.0f, 89.0f));
+    mScene.setCamera(camera);
+}
+
+void SceneLoader::loadEntry(const json& entry, SceneGraph::NodeId parent, Streams& streams, const fs::path& directory) {
+    Transform local = parseTransform(entry);
+    SceneGraph::NodeId node;
+    std::shared_ptr<Object> model;
+    if (entry.contains("file") && !entry.contains("instances")) {
+        model = mScene.loadModelFile(resolve(directory, entry["file"].get<std::string>()));
+    }
+    if (model) {
+        model->setLocalTransform(local);
+        mScene.addObject(model, parent);
+        node = model->getNode();
+    } else {
+        // Groups only contribute their transform
+        node = mScene.addGroup(local, parent);
+    }
+
+    if (entry.contains("instances") && entry.contains("file")) {
+        loadInstances(entry["instances"], resolve(directory, entry["file"].get<std::string>()), node, streams, directory);
+    }
+    if (entry.contains("include")) {
+        load(resolve(directory, entry["include"].get<std::string>()), node);
+    }
+    if (entry.contains("children")) {
+        for (const auto& child : entry["children"]) loadEntry(child, node, streams, directory);
+    }
+}
+
+void SceneLoader::loadInstances(const json& instances, const fs::path& file, SceneGraph::NodeId parent,
+                                Streams& streams, const fs::path& directory) {
+    static const std::pair<const char*, InstanceLayout> layouts[] = {
+        {"t", InstanceLayout::T}, {"tr", InstanceLayout::TR}, {"trs", InstanceLayout::TRS}, {"matrix", InstanceLayout::MATRIX}
+    };
+    InstanceLayout layout = InstanceLayout::TRS;
+    if (instances.contains("layout")) {
+        std::string name = instances["layout"].get<std::string>();
+        auto it = std::find_if(std::begin(layouts), std::end(layouts), [&](const auto& l) { return name == l.first; });
+        if (it == std::end(layouts)) {
+            std::cerr << "Unknown instance layout: " << name << std::endl;
+            return;
+        }
+        layout = it->second;
+    }
+    const size_t floats = stride(layout);
+
+    // The file is read once, every record after the first shares its shapes
+    std::shared_ptr<Object> prototype;
+    auto place = [&](const float* record) {
+        std::shared_ptr<Object> model;
+        if (!prototype) {
+            prototype = model = mScene.loadModelFile(file);
+            if (!model) return false;
+        } else {
+            model = prototype->instance();
+        }
+        model->setLocalTransform(decode(layout, record));
+        mScene.addObject(model, parent);
+        return true;
+    };
+
+    if (instances.contains("data")) {
+        const json& data = instances["data"];
+        std::vector<float> inline_;
+        const std::vector<float>* values = &inline_;
+        if (data.is_object() && data.contains("stream")) {
+            values = &streams[data["stream"].get<size_t>()];
+        } else if (data.is_array()) {
+            for (const auto& number : data.flatten()) inline_.push_back(number.get<float>());
+        }
+        if (values->size() % floats)
+            std::cerr << "Instance data of " << file << " is not a whole number of records" << std::endl;
+        for (size_t i = 0; i + floats <= values->size(); i += floats)
+            if (!place(values->data() + i)) return;
+        // Placed, the numbers are no longer needed
+        if (values != &inline_) std::vector<float>().swap(streams[data["stream"].get<size_t>()]);
+    }
+
+    if (instances.contains("binary")) {
+        fs::path blob = resolve(directory, instances["binary"].get<std::string>());
+        std::ifstream in(blob, std::ios::binary);
+        if (!in.is_open()) {
+            std::cerr << "Failed to open file: " << blob << std::endl;
+            return;
+        }
+        in.seekg(static_cast<std::streamoff>(instances.value("offset", uint64_t(0))));
+        uint64_t remaining = instances.value("count", UINT64_MAX);
+        // A few thousand records at a time, a blob is never held whole
+        std::vector<float> chunk(floats * 4096);
+        while (remaining && in) {
+            size_t records = static_cast<size_t>(std::min<uint64_t>(remaining, 4096));
+            in.read(reinterpret_cast<char*>(chunk.data()), static_cast<std::streamsize>(records * floats * sizeof(float)));
+            records = static_cast<size_t>(in.gcount()) / (floats * sizeof(float));
+            for (size_t i = 0; i < records; ++i)
+                if (!place(chunk.data() + i * floats)) return;
+            remaining -= records;
+        }
+        if (remaining && remaining != UINT64_MAX && instances.contains("count"))
+            std::cerr << "Binary instance file " << blob << " ended " << remaining << " records early" << std::endl;
+    }
+}
+
+fs::path SceneLoader::resolve(const fs::path& directory, const fs::path& path) {
+    if (path.is_absolute()) return path;
+    std::error_code error;
+    fs::path local = directory / path;
+    return fs::exists(local, error) ? local : path;
+}
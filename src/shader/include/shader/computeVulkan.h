@@ -0,0 +1,32 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#ifndef TOY_RENDERER_COMPUTEVULKAN_H
+#define TOY_RENDERER_COMPUTEVULKAN_H
+
+#include "shader/shaderVulkan.h"
+
+// A single compute stage with one descriptor set and an optional push constant block.
+// Not a Shader: it has no render pass or vertex input, and renders nothing by itself.
+class computeShaderVulkan {
+public:
+    explicit computeShaderVulkan(std::string computePath) : mComputePath(std::move(computePath)) {}
+    ~computeShaderVulkan() { cleanup(); }
+
+    void init(const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingCount, uint32_t pushConstantSize = 0);
+    void cleanup();
+
+    descriptorSetLayout& getDescriptorSetLayout() { return mDescriptorSetLayout; }
+    pipelineLayout& getPipelineLayout() { return mPipelineLayout; }
+    pipeline& getPipeline() { return mPipeline; }
+
+private:
+    std::string mComputePath;
+    shaderModule comp;
+    descriptorSetLayout mDescriptorSetLayout;
+    pipelineLayout mPipelineLayout;
+    pipeline mPipeline;
+};
+
+#endif //TOY_RENDERER_COMPUTEVULKAN_H
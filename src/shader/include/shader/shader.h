@@ -15,7 +15,10 @@ enum SHADER_TYPE
 {
     WIREFRAME,
     Blinn_Phong,
-    MATERIAL
+    MATERIAL,
+    OCCLUSION_PROXY,    // depth-only bounding boxes for occlusion queries, never selected from the UI
+    MATERIAL_BINDLESS,  // MATERIAL reading its texture per draw, used in its place when bindless textures are on
+    DEPTH_PREPASS       // positions only, fills depth ahead of the shading pass, never selected from the UI
 };
 
 enum SHADER_BACKEND_TYPE
@@ -50,9 +53,17 @@ public:
     virtual descriptorSet& getDescriptorSet() = 0;
     virtual pipelineLayout& getPipelineLayout() = 0;
     virtual pipeline& getPipeline() = 0;
+    // The material shaders' pipelines for alpha-tested shapes, which keep the usual depth test after a pre-pass,
+    // and for blended ones, which blend and don't write depth. Others only have the one pipeline
+    virtual pipeline& getMaskedPipeline() { return getPipeline(); }
+    virtual pipeline& getBlendPipeline() { return getPipeline(); }
     virtual uniformBuffer& getHasTextureBuffer() = 0;
     virtual descriptorSetLayout& getDescriptorSetLayout() = 0;
     virtual const easyVulkan::renderPassWithFramebuffers& RenderPassAndFramebuffers() = 0;
+    // Depth test and clear for reverse-Z. Vulkan bakes them into the pipeline, OpenGL sets them per frame
+    virtual void setReverseZ(bool reverseZ) {}
+    // Shading after a depth pre-pass: EQUAL depth test, no depth writes. Same split as setReverseZ
+    virtual void setDepthEqual(bool depthEqual) {}
 
 
 protected:
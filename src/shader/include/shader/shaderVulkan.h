@@ -9,6 +9,7 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <functional>
 #include <string>
 #include "EasyVulkan/GlfwGeneral.hpp"
 #include <glslang/glslang/Public/ShaderLang.h>
@@ -31,14 +32,18 @@ public:
     {
         cleanup();
     }
-    std::vector<uint32_t> CompileGLSLToSPIRV(const std::string& shaderSource, EShLanguage stage);
-    std::string readFile(const std::string& filepath);
+    static std::vector<uint32_t> CompileGLSLToSPIRV(const std::string& shaderSource, EShLanguage stage);
+    static std::string readFile(const std::string& filepath);
+    // Size of the texture array of MATERIAL_BINDLESS, 0 when the device lacks descriptor indexing
+    static uint32_t BindlessTextureCapacity();
+    // 32-bit float where the device can render to it, which reverse-Z relies on for its precision
+    static VkFormat DepthFormat();
     void LoadShaders(const std::string &vertexPath, const std::string &fragmentPath, const std::string &geometryPath = "");
     void use() override  {return;}
     void init() override;
 
     const easyVulkan::renderPassWithFramebuffers& RenderPassAndFramebuffers() override {
-        static const auto& rpwf = easyVulkan::CreateRpwf_ScreenWithDS();
+        static const auto& rpwf = easyVulkan::CreateRpwf_ScreenWithDS(DepthFormat());
         return rpwf;
     }
 
@@ -59,6 +64,12 @@ public:
         glm::mat4 proj;
     };
 
+    struct occlusionProxyConstants {
+        glm::mat4 viewProjection;
+        glm::vec4 boxMin;
+        glm::vec4 boxMax;
+    };
+
     struct unoformBufferObject_Material {
         glm::mat4 model;
         glm::mat4 view;
@@ -83,7 +94,12 @@ public:
     descriptorSet& getDescriptorSet() override { return mdescriptorSet_triangle; }
     pipelineLayout& getPipelineLayout() override { return pipelineLayout_triangle; }
     pipeline& getPipeline() override { return pipeline_triangle; }
+    pipeline& getMaskedPipeline() override { return pipeline_masked; }
+    pipeline& getBlendPipeline() override { return pipeline_blend; }
     descriptorSetLayout& getDescriptorSetLayout() override { return descriptorSetLayout_triangle; }
+    // Both rebuild the pipeline when they change, the device is waited on first
+    void setReverseZ(bool reverseZ) override;
+    void setDepthEqual(bool depthEqual) override;
 
 private:
     shaderModule vert, frag, geom;
@@ -91,6 +107,12 @@ private:
     descriptorSetLayout descriptorSetLayout_triangle;
     pipelineLayout pipelineLayout_triangle;
     pipeline pipeline_triangle;
+    pipeline pipeline_masked;   // material shaders only
+    pipeline pipeline_blend;
+    std::function<void()> mCreatePipeline;
+    void RecreatePipeline();
+    bool mReverseZ = false;
+    bool mDepthEqual = false;
 
     std::optional<uniformBuffer> muniformBuffer;
     std::optional<uniformBuffer> mDummyBuffer;
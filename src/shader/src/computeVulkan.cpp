@@ -0,0 +1,52 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#include "shader/computeVulkan.h"
+
+void computeShaderVulkan::init(const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingCount, uint32_t pushConstantSize)
+{
+    glslang::InitializeProcess();
+    std::vector<uint32_t> spirv = shaderVulkan::CompileGLSLToSPIRV(shaderVulkan::readFile(mComputePath), EShLangCompute);
+    glslang::FinalizeProcess();
+    comp.Create(spirv.size() * sizeof(uint32_t), spirv.data());
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = bindingCount,
+        .pBindings = bindings
+    };
+    mDescriptorSetLayout.Create(descriptorSetLayoutCreateInfo);
+
+    VkPushConstantRange pushConstantRange = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = pushConstantSize
+    };
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = mDescriptorSetLayout.Address(),
+        .pushConstantRangeCount = pushConstantSize ? 1u : 0u,
+        .pPushConstantRanges = &pushConstantRange
+    };
+    mPipelineLayout.Create(pipelineLayoutCreateInfo);
+
+    // Compute pipelines do not depend on the swapchain, no recreate callbacks needed
+    VkComputePipelineCreateInfo pipelineCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = comp.StageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT),
+        .layout = mPipelineLayout
+    };
+    mPipeline.Create(pipelineCreateInfo);
+}
+
+void computeShaderVulkan::cleanup()
+{
+    if (!mPipeline && !mPipelineLayout && !mDescriptorSetLayout && !comp) return;
+    graphicsBase::Base().WaitIdle();
+    mPipeline.~pipeline();
+    mPipelineLayout.~pipelineLayout();
+    mDescriptorSetLayout.~descriptorSetLayout();
+    comp.~shaderModule();
+}
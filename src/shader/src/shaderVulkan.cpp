@@ -69,25 +69,62 @@ void shaderVulkan::init()
 {
     LoadShaders(mVertexPath, mFragmentPath, mGeometryPath);
 
-    VkDescriptorSetLayoutBinding bindings[3] = {
+    VkDescriptorSetLayoutBinding bindings[6] = {
             { .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT },
             { .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT },
-            { .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT }
+            { .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT },
+            // Model matrix of every draw, indexed by the instance index
+            { .binding = 3, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT },
+            // Material table entry of every draw, and the table
+            { .binding = 5, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT },
+            { .binding = 6, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT }
     };
 
     VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo_triangle = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
     };
 
-    descriptorSetLayoutCreateInfo_triangle.bindingCount = 3, descriptorSetLayoutCreateInfo_triangle.pBindings = bindings;
+    descriptorSetLayoutCreateInfo_triangle.bindingCount = 6, descriptorSetLayoutCreateInfo_triangle.pBindings = bindings;
+
+    // The bindless material keeps the camera, the draws and the materials, and samples every texture
+    // of the scene from one array with the index its material holds. Elements of removed textures stay unwritten
+    VkDescriptorSetLayoutBinding bindlessBindings[5] = {
+            bindings[0],
+            bindings[3],
+            { .binding = 4, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = BindlessTextureCapacity(), .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT },
+            bindings[4],
+            bindings[5]
+    };
+    VkDescriptorBindingFlags bindlessFlags[5] = { 0, 0, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT, 0, 0 };
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .bindingCount = 5,
+        .pBindingFlags = bindlessFlags
+    };
+    if(mShaderType == SHADER_TYPE::MATERIAL_BINDLESS)
+    {
+        descriptorSetLayoutCreateInfo_triangle.pNext = &bindingFlagsCreateInfo;
+        descriptorSetLayoutCreateInfo_triangle.bindingCount = 5;
+        descriptorSetLayoutCreateInfo_triangle.pBindings = bindlessBindings;
+    }
 
     descriptorSetLayout_triangle.Create(descriptorSetLayoutCreateInfo_triangle);
 
+    VkPushConstantRange pushConstantRange = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = sizeof(occlusionProxyConstants)
+    };
     VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
         .setLayoutCount = 1,
         .pSetLayouts = descriptorSetLayout_triangle.Address()
     };
+    if(mShaderType == SHADER_TYPE::OCCLUSION_PROXY)
+    {
+        pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+        pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+    }
     pipelineLayout_triangle.Create(pipelineLayoutCreateInfo);
 
     VkPipelineShaderStageCreateInfo shaderStageCreateInfos_triangle[2] = {
@@ -95,16 +132,26 @@ void shaderVulkan::init()
             frag.StageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT)
     };
 
-    auto Create = [this, &shaderStageCreateInfos_triangle] {
+    // The stages are copied, the lambda runs again on every swapchain recreation
+    mCreatePipeline = [this, shaderStageCreateInfos_triangle] {
         graphicsPipelineCreateInfoPack pipelineCiPack;
         pipelineCiPack.createInfo.layout = pipelineLayout_triangle;
         pipelineCiPack.createInfo.renderPass = RenderPassAndFramebuffers().pass;
 
 
-        pipelineCiPack.vertexInputBindings.emplace_back(0, sizeof(material), VK_VERTEX_INPUT_RATE_VERTEX);
-        pipelineCiPack.vertexInputAttributes.emplace_back(0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(material, position));
-        pipelineCiPack.vertexInputAttributes.emplace_back(1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(material, normal));
-        pipelineCiPack.vertexInputAttributes.emplace_back(2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(material, tex));
+        // Occlusion proxies build their cube from gl_VertexIndex, the depth pre-pass reads a position-only stream
+        if(mShaderType == SHADER_TYPE::DEPTH_PREPASS)
+        {
+            pipelineCiPack.vertexInputBindings.emplace_back(0, sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX);
+            pipelineCiPack.vertexInputAttributes.emplace_back(0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0);
+        }
+        else if(mShaderType != SHADER_TYPE::OCCLUSION_PROXY)
+        {
+            pipelineCiPack.vertexInputBindings.emplace_back(0, sizeof(material), VK_VERTEX_INPUT_RATE_VERTEX);
+            pipelineCiPack.vertexInputAttributes.emplace_back(0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(material, position));
+            pipelineCiPack.vertexInputAttributes.emplace_back(1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(material, normal));
+            pipelineCiPack.vertexInputAttributes.emplace_back(2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(material, tex));
+        }
 
         pipelineCiPack.inputAssemblyStateCi.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
         pipelineCiPack.viewports.emplace_back(0.f, 0.f, float(windowSize.width), float(windowSize.height), 0.f, 1.f);
@@ -134,27 +181,118 @@ void shaderVulkan::init()
 
         pipelineCiPack.depthStencilStateCi.depthTestEnable = VK_TRUE;
         pipelineCiPack.depthStencilStateCi.depthWriteEnable = VK_TRUE;
-        pipelineCiPack.depthStencilStateCi.depthCompareOp = VK_COMPARE_OP_LESS;
+        pipelineCiPack.depthStencilStateCi.depthCompareOp = mReverseZ ? VK_COMPARE_OP_GREATER : VK_COMPARE_OP_LESS;
 
         pipelineCiPack.colorBlendAttachmentStates.push_back({ .colorWriteMask = 0b1111 });
 
+        if(mShaderType == SHADER_TYPE::DEPTH_PREPASS)
+            pipelineCiPack.colorBlendAttachmentStates.back().colorWriteMask = 0;
+        if(mDepthEqual)
+        {
+            // The pre-pass left the nearest depth, shade only that
+            pipelineCiPack.depthStencilStateCi.depthWriteEnable = VK_FALSE;
+            pipelineCiPack.depthStencilStateCi.depthCompareOp = VK_COMPARE_OP_EQUAL;
+        }
+
+        if(mShaderType == SHADER_TYPE::OCCLUSION_PROXY)
+        {
+            // Test against the depth of what was drawn, touch nothing
+            pipelineCiPack.rasterizationStateCi.polygonMode = VK_POLYGON_MODE_FILL;
+            pipelineCiPack.rasterizationStateCi.cullMode = VK_CULL_MODE_NONE;
+            pipelineCiPack.depthStencilStateCi.depthWriteEnable = VK_FALSE;
+            pipelineCiPack.depthStencilStateCi.depthCompareOp = mReverseZ ? VK_COMPARE_OP_GREATER_OR_EQUAL : VK_COMPARE_OP_LESS_OR_EQUAL;
+            pipelineCiPack.colorBlendAttachmentStates.back().colorWriteMask = 0;
+        }
+
         pipelineCiPack.UpdateAllArrays();
         pipelineCiPack.createInfo.stageCount = 2;
         pipelineCiPack.createInfo.pStages = shaderStageCreateInfos_triangle;
 
         pipeline_triangle.Create(pipelineCiPack);
+
+        // The material shaders also draw alpha-tested shapes, with the usual depth test after a pre-pass,
+        // and blended ones, over what is drawn without writing depth
+        if(mShaderType == SHADER_TYPE::MATERIAL || mShaderType == SHADER_TYPE::MATERIAL_BINDLESS)
+        {
+            pipelineCiPack.depthStencilStateCi.depthWriteEnable = VK_TRUE;
+            pipelineCiPack.depthStencilStateCi.depthCompareOp = mReverseZ ? VK_COMPARE_OP_GREATER : VK_COMPARE_OP_LESS;
+            pipeline_masked.Create(pipelineCiPack);
+
+            pipelineCiPack.depthStencilStateCi.depthWriteEnable = VK_FALSE;
+            pipelineCiPack.colorBlendAttachmentStates.back() = {
+                .blendEnable = VK_TRUE,
+                .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+                .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+                .colorBlendOp = VK_BLEND_OP_ADD,
+                .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+                .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+                .alphaBlendOp = VK_BLEND_OP_ADD,
+                .colorWriteMask = 0b1111
+            };
+            pipelineCiPack.UpdateAllArrays();
+            pipeline_blend.Create(pipelineCiPack);
+        }
     };
 
     auto Destroy = [this] {
         pipeline_triangle.~pipeline();
+        pipeline_masked.~pipeline();
+        pipeline_blend.~pipeline();
     };
 
-    graphicsBase::Base().AddCallback_CreateSwapchain(Create);
+    graphicsBase::Base().AddCallback_CreateSwapchain([this] { mCreatePipeline(); });
     graphicsBase::Base().AddCallback_DestroySwapchain(Destroy);
-    Create();
+    mCreatePipeline();
 
     mcommandPool.AllocateBuffers(mcommandBuffer);
-    initForUniform();
+    // The renderer owns the one set of the bindless material
+    if(mShaderType != SHADER_TYPE::MATERIAL_BINDLESS)
+        initForUniform();
+}
+
+uint32_t shaderVulkan::BindlessTextureCapacity()
+{
+    const VkPhysicalDeviceVulkan12Features& features = graphicsBase::Base().PhysicalDeviceVulkan12Features();
+    if (!features.runtimeDescriptorArray || !features.descriptorBindingPartiallyBound ||
+        !features.shaderSampledImageArrayNonUniformIndexing)
+        return 0;
+    const VkPhysicalDeviceLimits& limits = graphicsBase::Base().PhysicalDeviceProperties().limits;
+    return std::min({ 4096u, limits.maxPerStageDescriptorSamplers, limits.maxPerStageDescriptorSampledImages,
+                      limits.maxDescriptorSetSamplers, limits.maxDescriptorSetSampledImages });
+}
+
+VkFormat shaderVulkan::DepthFormat()
+{
+    const VkFormatProperties& properties = FormatProperties(VK_FORMAT_D32_SFLOAT);
+    if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+        return VK_FORMAT_D32_SFLOAT;
+    return VK_FORMAT_D24_UNORM_S8_UINT;
+}
+
+void shaderVulkan::setReverseZ(bool reverseZ)
+{
+    if (reverseZ == mReverseZ) return;
+    mReverseZ = reverseZ;
+    mclearValue[1].depthStencil.depth = reverseZ ? 0.f : 1.f;
+    RecreatePipeline();
+}
+
+void shaderVulkan::setDepthEqual(bool depthEqual)
+{
+    if (depthEqual == mDepthEqual) return;
+    mDepthEqual = depthEqual;
+    RecreatePipeline();
+}
+
+void shaderVulkan::RecreatePipeline()
+{
+    // Before init() the pipeline is created with the new state
+    if (!mCreatePipeline) return;
+    graphicsBase::Base().WaitIdle();
+    pipeline_triangle.~pipeline();
+    pipeline_masked.~pipeline();
+    pipeline_blend.~pipeline();
+    mCreatePipeline();
 }
 
 void shaderVulkan::initForUniform()
@@ -163,7 +301,8 @@ void shaderVulkan::initForUniform()
     mHasTextureBuffer.emplace((sizeof(int)));
     VkDescriptorPoolSize poolSizes[] = {
             { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 },
-            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 }
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 }
     };
     mdescriptorPool.emplace(1, poolSizes);
     mdescriptorPool->AllocateSets(mdescriptorSet_triangle, descriptorSetLayout_triangle);
@@ -101,7 +101,36 @@ public:
             ImGui::PopItemWidth();
         }
 
+        ImGui::Spacing();
+        ImGui::TextWrapped("Camera Path");
+        CameraPath& path = mViewer->getCameraPath();
+        if (mViewer->isRecordingPath()) {
+            if (ImGui::Button("Stop")) mViewer->stopPathRecording();
+            ImGui::SameLine();
+            ImGui::Text("%zu keys, %.1f s", path.size(), path.duration());
+        } else if (mViewer->isReplaying()) {
+            ImGui::TextUnformatted("Replaying");
+        } else {
+            if (ImGui::Button("Record")) mViewer->startPathRecording();
+            ImGui::SameLine();
+            if (ImGui::Button("Replay")) mViewer->startReplay({});
+            ImGui::SameLine();
+            ImGui::Text("%zu keys, %.1f s", path.size(), path.duration());
+            ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x);
+            ImGui::InputText("##Camera Path File", mPathFile, sizeof(mPathFile));
+            ImGui::PopItemWidth();
+            if (ImGui::Button("Load")) path.load(mPathFile);
+            ImGui::SameLine();
+            if (ImGui::Button("Save")) path.save(mPathFile);
+            const ReplayResult& result = mViewer->getReplayResult();
+            if (result.frames)
+                ImGui::Text("Last replay: p50 %.2f, p95 %.2f, p99 %.2f ms", result.p50Ms, result.p95Ms, result.p99Ms);
+        }
+
         ImGui::End();
     };
+
+private:
+    char mPathFile[256] = "camera_path.txt";
 };
 #endif //TOY_RENDERER_UPDATE_CAMERAUI_H
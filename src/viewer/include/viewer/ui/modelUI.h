@@ -58,8 +58,9 @@ public:
             ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(0.8f, 0.1f, 0.1f, 0.7f));  // Reddish button
             if (ImGui::Button("X", ImVec2(30, 30)))
             {
-                mViewer->getRender()->removeModel(model);
-                mViewer->getScene()->removeModel(model);
+                // Parts parented under the model go with it
+                for (const auto& removed : mViewer->getScene()->removeModel(model))
+                    mViewer->getRender()->removeModel(removed);
             }
             ImGui::PopStyleColor();
             ImGui::PopID();
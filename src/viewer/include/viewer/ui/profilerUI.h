@@ -0,0 +1,165 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#ifndef TOY_RENDERER_PROFILERUI_H
+#define TOY_RENDERER_PROFILERUI_H
+
+#include "profiler/profiler.h"
+#include "ui.h"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <string>
+
+// Frame times of the recent history, one frame's zones as a flame graph per thread with the GPU
+// below, averages per zone and Chrome trace export
+class ProfilerUI : public UI {
+public:
+    explicit ProfilerUI(std::shared_ptr<Viewer> viewer) {
+        mViewer = std::move(viewer);
+        mName = "Profiler";
+    }
+    void render() override
+    {
+        if(!mVisible)return;
+
+        ImGui::SetNextWindowSize(ImVec2(720, 420), ImGuiCond_Once);
+        ImGui::SetNextWindowPos(ImVec2(20, 560), ImGuiCond_Once);
+        ImGui::Begin(mName.c_str(), &mVisible);
+
+        Profiler& profiler = Profiler::get();
+        bool enabled = profiler.enabled();
+        if (ImGui::Checkbox("Enabled", &enabled))
+            profiler.setEnabled(enabled);
+        ImGui::SameLine();
+        ImGui::Checkbox("Pause", &mPaused);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(200);
+        ImGui::InputText("##trace", mTracePath, sizeof(mTracePath));
+        ImGui::SameLine();
+        if (ImGui::Button("Export trace"))
+            mExportStatus = profiler.exportChromeTrace(mTracePath) ? "Written" : "Failed";
+        if (!mExportStatus.empty()) {
+            ImGui::SameLine();
+            ImGui::TextUnformatted(mExportStatus.c_str());
+        }
+
+        if (!mPaused || mFrames.empty()) {
+            mFrames = profiler.history();
+            mSelected = -1;
+        }
+        if (mFrames.empty()) {
+            ImGui::TextUnformatted("No frames recorded");
+            ImGui::End();
+            return;
+        }
+
+        std::vector<float> frameMs(mFrames.size());
+        for (size_t i = 0; i < mFrames.size(); ++i)
+            frameMs[i] = static_cast<float>(mFrames[i].durationNs) * 1e-6f;
+        float longest = *std::max_element(frameMs.begin(), frameMs.end());
+        char overlay[64];
+        std::snprintf(overlay, sizeof(overlay), "last %.2f ms, max %.2f ms", frameMs.back(), longest);
+        ImGui::PlotHistogram("##frames", frameMs.data(), static_cast<int>(frameMs.size()), 0, overlay,
+                             0.0f, longest * 1.1f, ImVec2(-1, 60));
+
+        if (mPaused) {
+            int last = static_cast<int>(mFrames.size()) - 1;
+            if (mSelected < 0) mSelected = last;
+            ImGui::SliderInt("Frame", &mSelected, 0, last);
+        }
+        const ProfileFrame& frame = mFrames[mSelected < 0 ? mFrames.size() - 1 : mSelected];
+        drawTimeline(frame);
+        drawAverages();
+        ImGui::End();
+    }
+
+private:
+    void drawTimeline(const ProfileFrame& frame)
+    {
+        // One lane per thread and depth, the GPU lane last
+        uint32_t gpuDepth = 0;
+        std::map<uint32_t, uint32_t> threadDepth;
+        for (const auto& zone : frame.zones) {
+            if (zone.thread == Profiler::gpuThread) gpuDepth = 1;
+            else threadDepth[zone.thread] = std::max(threadDepth[zone.thread], zone.depth + 1);
+        }
+        std::map<uint32_t, uint32_t> firstLane;
+        uint32_t lanes = 0;
+        for (const auto& [thread, depth] : threadDepth) {
+            firstLane[thread] = lanes;
+            lanes += depth;
+        }
+        const uint32_t gpuLane = lanes;
+        lanes += gpuDepth;
+
+        const float laneHeight = ImGui::GetTextLineHeight() + 4.0f;
+        const float width = ImGui::GetContentRegionAvail().x;
+        const ImVec2 origin = ImGui::GetCursorScreenPos();
+        ImGui::InvisibleButton("##timeline", ImVec2(width, std::max(1u, lanes) * laneHeight));
+        ImDrawList* draw = ImGui::GetWindowDrawList();
+        // GPU work may end after the CPU moved on, stretch to whichever is later
+        uint64_t end = frame.startNs + frame.durationNs;
+        for (const auto& zone : frame.zones) end = std::max(end, zone.startNs + zone.durationNs);
+        const double scale = width / static_cast<double>(std::max<uint64_t>(1, end - frame.startNs));
+
+        for (const auto& zone : frame.zones) {
+            bool gpu = zone.thread == Profiler::gpuThread;
+            uint32_t lane = gpu ? gpuLane : firstLane[zone.thread] + zone.depth;
+            float x0 = origin.x + static_cast<float>((zone.startNs - std::min(zone.startNs, frame.startNs)) * scale);
+            float x1 = std::max(x0 + 1.0f, x0 + static_cast<float>(zone.durationNs * scale));
+            float y0 = origin.y + lane * laneHeight;
+            ImU32 color = gpu ? IM_COL32(200, 110, 60, 255) : IM_COL32(70, 120 + 30 * (zone.depth % 4), 200, 255);
+            draw->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y0 + laneHeight - 1.0f), color);
+            char label[96];
+            std::snprintf(label, sizeof(label), "%s %.2f ms", zone.name, zone.durationNs * 1e-6);
+            if (ImGui::CalcTextSize(label).x < x1 - x0 - 4.0f)
+                draw->AddText(ImVec2(x0 + 2.0f, y0 + 2.0f), IM_COL32_WHITE, label);
+            if (ImGui::IsMouseHoveringRect(ImVec2(x0, y0), ImVec2(x1, y0 + laneHeight)))
+                ImGui::SetTooltip("%s%s", gpu ? "GPU " : "", label);
+        }
+    }
+
+    void drawAverages()
+    {
+        struct Total {
+            double ms = 0.0;
+            uint32_t frames = 0;
+        };
+        std::map<std::pair<bool, std::string>, Total> totals;
+        for (const auto& frame : mFrames) {
+            std::map<std::pair<bool, std::string>, double> inFrame;
+            for (const auto& zone : frame.zones)
+                inFrame[{zone.thread == Profiler::gpuThread, zone.name}] += zone.durationNs * 1e-6;
+            for (const auto& [key, ms] : inFrame) {
+                totals[key].ms += ms;
+                ++totals[key].frames;
+            }
+        }
+        if (!ImGui::BeginTable("##zones", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Borders))
+            return;
+        ImGui::TableSetupColumn("Zone");
+        ImGui::TableSetupColumn("Where");
+        ImGui::TableSetupColumn("ms per frame");
+        ImGui::TableHeadersRow();
+        for (const auto& [key, total] : totals) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(key.second.c_str());
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(key.first ? "GPU" : "CPU");
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", total.ms / total.frames);
+        }
+        ImGui::EndTable();
+    }
+
+    std::vector<ProfileFrame> mFrames;
+    bool mPaused = false;
+    int mSelected = -1;
+    char mTracePath[256] = "profile.json";
+    std::string mExportStatus;
+};
+
+#endif //TOY_RENDERER_PROFILERUI_H
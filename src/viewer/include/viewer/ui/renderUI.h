@@ -19,7 +19,7 @@ public:
     {
         if(!mVisible)return;
 
-        ImGui::SetNextWindowSize(ImVec2(mViewer->getWidth() * 0.1f, 60), ImGuiCond_Once);
+        ImGui::SetNextWindowSize(ImVec2(mViewer->getWidth() * 0.1f, 440), ImGuiCond_Once);
         ImGui::SetNextWindowPos(ImVec2(mViewer->getWidth() * 0.9f, 90), ImGuiCond_Once);
 
         ImGui::Begin(mName.c_str(), &mVisible, ImGuiWindowFlags_MenuBar);
@@ -56,6 +56,65 @@ public:
 
             ImGui::EndMenuBar();
         }
+
+        auto render = mViewer->getRender();
+        bool culling = render->getFrustumCulling();
+        if (ImGui::Checkbox("Frustum culling", &culling))
+            render->setFrustumCulling(culling);
+        bool occlusion = render->getOcclusionCulling();
+        if (ImGui::Checkbox("Occlusion culling", &occlusion))
+            render->setOcclusionCulling(occlusion);
+        bool lod = render->getLODEnabled();
+        if (ImGui::Checkbox("LOD", &lod))
+            render->setLODEnabled(lod);
+        float lodBias = render->getLODBias();
+        if (ImGui::SliderFloat("LOD bias", &lodBias, 0.25f, 4.0f, "%.2f", ImGuiSliderFlags_Logarithmic))
+            render->setLODBias(lodBias);
+        if (mViewer->getBackendType() == SHADER_BACKEND_TYPE::VULKAN)
+        {
+            bool meshlets = render->getMeshletCulling();
+            if (ImGui::Checkbox("Meshlet culling", &meshlets))
+                render->setMeshletCulling(meshlets);
+            bool cone = render->getClusterConeCulling();
+            if (ImGui::Checkbox("Cluster backface culling", &cone))
+                render->setClusterConeCulling(cone);
+        }
+        bool reverseZ = render->getReverseZ();
+        if (ImGui::Checkbox("Reverse-Z depth", &reverseZ))
+            render->setReverseZ(reverseZ);
+        bool prepass = render->getDepthPrepass();
+        if (ImGui::Checkbox("Depth pre-pass", &prepass))
+            render->setDepthPrepass(prepass);
+        bool frontToBack = render->getFrontToBack();
+        if (ImGui::Checkbox("Front to back", &frontToBack))
+            render->setFrontToBack(frontToBack);
+        if (render->bindlessTexturesSupported())
+        {
+            bool bindless = render->getBindlessTextures();
+            if (ImGui::Checkbox("Bindless textures", &bindless))
+                render->setBindlessTextures(bindless);
+        }
+        else
+            ImGui::TextDisabled("Bindless textures unsupported");
+        if (mViewer->getLastSwitchTime() > 0.0)
+            ImGui::Text("Last switch: %.0f ms", mViewer->getLastSwitchTime());
+        const auto& cache = render->getResourceCache();
+        ImGui::Text("Cached: %zu images, %zu models", cache->imageCount(), cache->modelCount());
+        const CullingStats& stats = render->getCullingStats();
+        ImGui::Text("Objects: %u drawn / %u culled", stats.drawnObjects, stats.culledObjects);
+        ImGui::Text("Shapes: %u drawn / %u culled", stats.drawnShapes, stats.culledShapes);
+        ImGui::Text("Occluded: %u skipped / %u queries", stats.occludedShapes, stats.occlusionQueries);
+        ImGui::Text("Triangles: %llu", static_cast<unsigned long long>(stats.drawnTriangles));
+        ImGui::Text("Draw calls: %u", stats.drawCalls);
+        ImGui::Text("Instanced: %u shapes", stats.instancedShapes);
+        ImGui::Text("Meshlets: %u tested in %u shapes", stats.meshletsTested, stats.meshletShapes);
+        ImGui::Text("Overdraw: %.2f samples per pixel", render->getRenderStats().overdraw());
+        if (mViewer->getBackendType() == SHADER_BACKEND_TYPE::VULKAN)
+        {
+            auto memory = vulkan::memoryAllocator::Default().Statistics();
+            ImGui::Text("Memory: %u blocks + %u dedicated, %u allocations", memory.blockCount, memory.dedicatedCount, memory.allocationCount);
+            ImGui::Text("%.1f / %.1f MB used, %.0f%% fragmented", memory.usedBytes / 1048576.0, memory.reservedBytes / 1048576.0, memory.fragmentation * 100.0f);
+        }
         ImGui::End();
     }
 
@@ -0,0 +1,96 @@
+//
+// Created by clx on 26-10-19.
+//
+
+#ifndef TOY_RENDERER_STATSUI_H
+#define TOY_RENDERER_STATSUI_H
+
+#include "profiler/profiler.h"
+#include "render/statsRecorder.h"
+#include "ui.h"
+#include <cfloat>
+#include <deque>
+#include <memory>
+#include <vector>
+
+// What the current renderer handed the API last frame and the GPU memory it holds, with a recording
+// of every frame's counters to CSV or JSON. The UI runs before the frame renders, so it reads the
+// frame before
+class StatsUI : public UI {
+public:
+    explicit StatsUI(std::shared_ptr<Viewer> viewer) {
+        mViewer = std::move(viewer);
+        mName = "Stats";
+    }
+    void render() override
+    {
+        auto render = mViewer->getRender();
+        // Keeps recording with the panel closed
+        if (mRecorder)
+            mRecorder->record(Profiler::get().frameIndex(), ImGui::GetIO().DeltaTime * 1000.0, *render);
+        const CullingStats& culling = render->getCullingStats();
+        const RenderStats& work = render->getRenderStats();
+        mDrawCalls.push_back(static_cast<float>(culling.drawCalls));
+        mUploadKB.push_back(static_cast<float>(work.uploadBytes / 1024.0));
+        if (mDrawCalls.size() > historySize) {
+            mDrawCalls.pop_front();
+            mUploadKB.pop_front();
+        }
+        if(!mVisible)return;
+
+        ImGui::SetNextWindowSize(ImVec2(mViewer->getWidth() * 0.12f, 440), ImGuiCond_Once);
+        ImGui::SetNextWindowPos(ImVec2(mViewer->getWidth() * 0.77f, 90), ImGuiCond_Once);
+        ImGui::Begin(mName.c_str(), &mVisible);
+
+        ImGui::Text("Draw calls: %u", culling.drawCalls);
+        ImGui::Text("Triangles: %llu", static_cast<unsigned long long>(culling.drawnTriangles));
+        ImGui::Text("Vertices: %llu", static_cast<unsigned long long>(culling.drawnVertices));
+        ImGui::Text("Pipeline binds: %u", work.pipelineBinds);
+        ImGui::Text("Descriptor binds: %u", work.descriptorBinds);
+        ImGui::Text("Texture binds: %u", work.textureBinds);
+        ImGui::Text("State changes: %u sorted, %u unsorted", work.sortedStateChanges, work.unsortedStateChanges);
+        ImGui::Text("Alpha shapes: %u tested, %u blended", work.maskedShapes, work.blendedShapes);
+        ImGui::Text("Uploads: %u, %.1f KB", work.bufferUploads, work.uploadBytes / 1024.0);
+        ImGui::Text("Shaded samples: %llu, %.2f per pixel", static_cast<unsigned long long>(work.shadedSamples), work.overdraw());
+        plot("##draws", mDrawCalls, "draw calls");
+        plot("##uploads", mUploadKB, "upload KB");
+
+        const MemoryStats& memory = render->getMemoryStats();
+        ImGui::Separator();
+        ImGui::TextUnformatted("GPU memory");
+        ImGui::Text("Geometry: %.1f MB", memory.geometry / 1048576.0);
+        ImGui::Text("Draw data: %.1f MB", memory.drawData / 1048576.0);
+        ImGui::Text("Textures: %.1f MB", memory.textures / 1048576.0);
+        ImGui::Text("Total: %.1f MB", memory.total() / 1048576.0);
+
+        ImGui::Separator();
+        ImGui::InputText("##stats", mPath, sizeof(mPath), mRecorder ? ImGuiInputTextFlags_ReadOnly : 0);
+        if (!mRecorder && ImGui::Button("Start")) {
+            mRecorder = std::make_unique<StatsRecorder>(mPath);
+            if (!mRecorder->isOpen()) mRecorder.reset();
+        } else if (mRecorder && ImGui::Button("Stop")) {
+            mRecorder.reset();
+        }
+        if (mRecorder) {
+            ImGui::SameLine();
+            ImGui::Text("%zu frames", mRecorder->frames());
+        }
+        ImGui::End();
+    }
+
+private:
+    static constexpr size_t historySize = 240;
+
+    static void plot(const char* id, const std::deque<float>& history, const char* label)
+    {
+        std::vector<float> values(history.begin(), history.end());
+        ImGui::PlotLines(id, values.data(), static_cast<int>(values.size()), 0, label, 0.0f, FLT_MAX, ImVec2(-1, 40));
+    }
+
+    std::deque<float> mDrawCalls;
+    std::deque<float> mUploadKB;
+    std::unique_ptr<StatsRecorder> mRecorder;
+    char mPath[256] = "stats.csv";
+};
+
+#endif //TOY_RENDERER_STATSUI_H
@@ -16,6 +16,8 @@ class ModelUI;
 class ShaderUI;
 class CameraUI;
 class RenderUI;
+class ProfilerUI;
+class StatsUI;
 
 class UI {
 public:
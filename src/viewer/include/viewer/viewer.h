@@ -5,6 +5,7 @@
 #ifndef VIEWER_H
 #define VIEWER_H
 
+#include "camera/cameraPath.h"
 #include "camera/orthographic.h"
 #include "camera/perspective.h"
 #include "scene/scene.h"
@@ -14,6 +15,8 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 #include <imgui_impl_vulkan.h>
+#include <chrono>
+#include <filesystem>
 #include <memory>
 
 #include "ui/ui.h"
@@ -22,6 +25,23 @@
 
 class UI;
 
+struct ReplayOptions {
+    float timestep = 1.0f / 60.0f;  // path time per frame, whatever the frame really took
+    uint32_t warmupFrames = 10;     // held at the first key and not measured, the first frames upload
+    std::filesystem::path report;   // JSON written when the replay ends, none when empty
+    bool exitWhenDone = false;
+};
+
+// Frame times of the last finished replay, start to start of consecutive frames
+struct ReplayResult {
+    size_t frames = 0;
+    double meanMs = 0.0;
+    double p50Ms = 0.0;
+    double p95Ms = 0.0;
+    double p99Ms = 0.0;
+    double maxMs = 0.0;
+};
+
 class Viewer {
 public:
     Viewer() = default;
@@ -35,6 +55,7 @@ public:
         mheight = height;
         mRender_OpenGL = std::move(render_OpenGL);
         mRender_Vulkan = std::move(render_Vulkan);
+        mRender_Vulkan->setResourceCache(mRender_OpenGL->getResourceCache());
         if(mShaderBackendType == SHADER_BACKEND_TYPE::OPENGL)
         {
             mCurrentRender = mRender_OpenGL;
@@ -79,6 +100,17 @@ public:
     void setMouseSensitivity(float sensitivity) { mMouseSensitivity = sensitivity; }
     SHADER_BACKEND_TYPE getBackendType() const { return mShaderBackendType; }
     void setSwitchType() { shouldswitch = true; }
+    // From the switch request to the new backend's first presented frame, 0 before any switch
+    double getLastSwitchTime() const { return mLastSwitchMs; }
+    // Recording samples the camera once per frame against the wall clock
+    void startPathRecording();
+    void stopPathRecording() { mRecordingPath = false; }
+    bool isRecordingPath() const { return mRecordingPath; }
+    CameraPath& getCameraPath() { return mCameraPath; }
+    // The camera follows the path instead of the input, one fixed timestep per frame
+    void startReplay(const ReplayOptions& options);
+    bool isReplaying() const { return mReplaying; }
+    const ReplayResult& getReplayResult() const { return mReplayResult; }
     void cleanupVulkan();
     void cleanupOpenGL()
     {
@@ -106,6 +138,22 @@ private:
     VkDescriptorPool mImGuiDescriptorPool = VK_NULL_HANDLE;
     VkExtent2D prevWindowSize;
     bool shouldswitch = false;
+    std::chrono::steady_clock::time_point mSwitchStart;
+    bool mSwitchTiming = false;
+    double mSwitchSetupMs = 0.0;
+    double mLastSwitchMs = 0.0;
+
+    void updateCameraPath();
+    void finishReplay();
+    CameraPath mCameraPath;
+    bool mRecordingPath = false;
+    double mRecordStart = 0.0;
+    bool mReplaying = false;
+    ReplayOptions mReplayOptions;
+    uint64_t mReplayFrame = 0;
+    std::chrono::steady_clock::time_point mReplayLast;
+    std::vector<double> mReplayFrameMs;
+    ReplayResult mReplayResult;
 };
 
 
@@ -2,10 +2,15 @@
 // Created by clx on 25-3-20.
 //
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <fstream>
+#include <numeric>
+#include <nlohmann/json.hpp>
 #include "camera/camera.h"
 #include "viewer/viewer.h"
+#include "profiler/profiler.h"
 
 void Viewer::initWindow(const std::string& title) {
     glfwDefaultWindowHints();
@@ -14,8 +19,8 @@ void Viewer::initWindow(const std::string& title) {
         return;
     }
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
     mWindow = glfwCreateWindow(mwidth, mheight, title.c_str(), nullptr, nullptr);
@@ -108,6 +113,7 @@ void Viewer::mainloop()
     while (!glfwWindowShouldClose(mWindow)) {
          while (glfwGetWindowAttrib(mWindow, GLFW_ICONIFIED))
              glfwWaitEvents();
+        Profiler::get().beginFrame();
 
         if (shouldswitch) {
             switchBackend();
@@ -132,10 +138,13 @@ void Viewer::mainloop()
                  continue;
              }
          }
-        processInput(mWindow);
-
-        glfwPollEvents();
-        glfwGetWindowSize(mWindow, &mwidth, &mheight);
+        {
+            TR_PROFILE_ZONE("events");
+            processInput(mWindow);
+            glfwPollEvents();
+            glfwGetWindowSize(mWindow, &mwidth, &mheight);
+            updateCameraPath();
+        }
 
         if (mCurrentRender->getType() == SHADER_BACKEND_TYPE::OPENGL) {
             ImGui_ImplOpenGL3_NewFrame();
@@ -144,27 +153,26 @@ void Viewer::mainloop()
         }
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
-        for(auto& ui : mUI)
         {
-            ui->render();
+            TR_PROFILE_ZONE("ui");
+            for(auto& ui : mUI)
+            {
+                ui->render();
+            }
         }
 
+        mCamera->setClipConvention(mCurrentRender->getType() == SHADER_BACKEND_TYPE::VULKAN ? CLIP_VULKAN : CLIP_OPENGL);
+        mCamera->setReverseZ(mCurrentRender->getReverseZ());
         mCamera->update(mwidth, mheight);
         glm::mat4 proj = mCamera->getProjectionMatrix();
-        if(mCurrentRender->getType() == SHADER_BACKEND_TYPE::VULKAN)
         {
-            if(mCamera->getType() == CameraType::PERSPECTIVE)
-            {
-                for(int j = 0; j < 4; ++j)proj[j][1] *= -1;
-            }
-            else
-            {
-                proj[1][1] *= -1;
-                proj[2][2] = proj[2][2] * 0.5f;
-                proj[3][2] = (proj[3][2] + 1.0f) * 0.5f;
-            }
+            TR_PROFILE_ZONE("update transforms");
+            mScene->updateTransforms();
+        }
+        {
+            TR_PROFILE_ZONE("render");
+            mCurrentRender->render(mScene, mCamera->getViewMatrix(), proj);
         }
-        mCurrentRender->render(mScene, mCamera->getViewMatrix(), proj);
         ImGui::Render();
         ImDrawData* draw_data = ImGui::GetDrawData();
 
@@ -173,27 +181,45 @@ void Viewer::mainloop()
             continue;
 
         if (mCurrentRender->getType() == SHADER_BACKEND_TYPE::OPENGL) {
+            TR_PROFILE_ZONE("imgui draw");
             ImGui_ImplOpenGL3_RenderDrawData(draw_data);
         }
         else {
             auto &CommandBuffer = mCurrentRender->getCurrentShader()->getCommandBuffer();
             auto &rpwf = mCurrentRender->getCurrentShader()->RenderPassAndFramebuffers();
-            ImGui_ImplVulkan_RenderDrawData(draw_data, CommandBuffer);
+            {
+                TR_PROFILE_ZONE("imgui draw");
+                ImGui_ImplVulkan_RenderDrawData(draw_data, CommandBuffer);
+            }
             rpwf.pass.CmdEnd(CommandBuffer);
             CommandBuffer.End();
             auto shader = mCurrentRender->getCurrentShader();
             fence &Fence = shader->getFence();
             semaphore &semaphore_imageIsAvailable = shader->getSemaphoreImageIsAvailable();
             semaphore &semaphore_renderingIsOver = shader->getSemaphoreRenderingIsOver();
-            graphicsBase::Base().SubmitCommandBuffer_Graphics(CommandBuffer, semaphore_imageIsAvailable,
-                                                              semaphore_renderingIsOver, Fence);
-            graphicsBase::Base().PresentImage(semaphore_renderingIsOver);
+            {
+                TR_PROFILE_ZONE("submit and present");
+                graphicsBase::Base().SubmitCommandBuffer_Graphics(CommandBuffer, semaphore_imageIsAvailable,
+                                                                  semaphore_renderingIsOver, Fence);
+                graphicsBase::Base().PresentImage(semaphore_renderingIsOver);
+            }
             glfwPollEvents();
 
+            TR_PROFILE_ZONE("wait for GPU");
             Fence.WaitAndReset();
         }
 
-        glfwSwapBuffers(mWindow);
+        {
+            TR_PROFILE_ZONE("swap buffers");
+            glfwSwapBuffers(mWindow);
+        }
+
+        if (mSwitchTiming) {
+            mSwitchTiming = false;
+            mLastSwitchMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - mSwitchStart).count();
+            std::cout << "Switched to " << (mShaderBackendType == SHADER_BACKEND_TYPE::VULKAN ? "Vulkan" : "OpenGL")
+                      << " in " << mLastSwitchMs << " ms (setup " << mSwitchSetupMs << " ms)" << std::endl;
+        }
 
         static double time0 = glfwGetTime();
         static double time1;
@@ -213,8 +239,95 @@ void Viewer::mainloop()
     }
 }
 
+void Viewer::startPathRecording()
+{
+    mReplaying = false;
+    mCameraPath.clear();
+    mRecordStart = glfwGetTime();
+    mRecordingPath = true;
+}
+
+void Viewer::startReplay(const ReplayOptions& options)
+{
+    if (mCameraPath.empty()) {
+        std::cerr << "No camera path to replay" << std::endl;
+        if (options.exitWhenDone) glfwSetWindowShouldClose(mWindow, true);
+        return;
+    }
+    mRecordingPath = false;
+    mReplaying = true;
+    mReplayOptions = options;
+    mReplayOptions.timestep = std::max(options.timestep, 1e-4f);
+    mReplayFrame = 0;
+    mReplayFrameMs.clear();
+    mReplayFrameMs.reserve(static_cast<size_t>(mCameraPath.duration() / mReplayOptions.timestep) + 2);
+}
+
+void Viewer::updateCameraPath()
+{
+    if (mRecordingPath)
+        mCameraPath.record(static_cast<float>(glfwGetTime() - mRecordStart), *mCamera);
+    if (!mReplaying) return;
+
+    // A frame is timed at the start of the next one, so it covers presenting and waiting too
+    auto now = std::chrono::steady_clock::now();
+    if (mReplayFrame > mReplayOptions.warmupFrames)
+        mReplayFrameMs.push_back(std::chrono::duration<double, std::milli>(now - mReplayLast).count());
+    mReplayLast = now;
+
+    uint64_t step = mReplayFrame > mReplayOptions.warmupFrames ? mReplayFrame - mReplayOptions.warmupFrames : 0;
+    float time = static_cast<float>(step) * mReplayOptions.timestep;
+    if (time > mCameraPath.duration()) {
+        finishReplay();
+        return;
+    }
+    mCameraPath.apply(time, *mCamera);
+    ++mReplayFrame;
+}
+
+void Viewer::finishReplay()
+{
+    mReplaying = false;
+    std::vector<double> sorted = mReplayFrameMs;
+    std::sort(sorted.begin(), sorted.end());
+    // Nearest rank
+    auto percentile = [&sorted](double p) {
+        size_t rank = static_cast<size_t>(std::ceil(p * static_cast<double>(sorted.size())));
+        return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+    };
+    mReplayResult = {};
+    if (!sorted.empty()) {
+        mReplayResult.frames = sorted.size();
+        mReplayResult.meanMs = std::accumulate(sorted.begin(), sorted.end(), 0.0) / static_cast<double>(sorted.size());
+        mReplayResult.p50Ms = percentile(0.50);
+        mReplayResult.p95Ms = percentile(0.95);
+        mReplayResult.p99Ms = percentile(0.99);
+        mReplayResult.maxMs = sorted.back();
+    }
+    const char* backend = mShaderBackendType == SHADER_BACKEND_TYPE::VULKAN ? "Vulkan" : "OpenGL";
+    std::cout << "Replay on " << backend << ": " << mReplayResult.frames << " frames, mean " << mReplayResult.meanMs
+              << " ms, p50 " << mReplayResult.p50Ms << " ms, p95 " << mReplayResult.p95Ms << " ms, p99 "
+              << mReplayResult.p99Ms << " ms, max " << mReplayResult.maxMs << " ms" << std::endl;
+
+    if (!mReplayOptions.report.empty()) {
+        nlohmann::json report = {
+            {"backend", backend}, {"width", mwidth}, {"height", mheight},
+            {"timestep", mReplayOptions.timestep}, {"warmup_frames", mReplayOptions.warmupFrames},
+            {"frames", mReplayResult.frames}, {"mean_ms", mReplayResult.meanMs},
+            {"p50_ms", mReplayResult.p50Ms}, {"p95_ms", mReplayResult.p95Ms}, {"p99_ms", mReplayResult.p99Ms},
+            {"max_ms", mReplayResult.maxMs}, {"frame_ms", mReplayFrameMs}
+        };
+        std::ofstream file(mReplayOptions.report);
+        if (file.is_open()) file << report.dump(2) << std::endl;
+        else std::cerr << "Failed to write " << mReplayOptions.report << std::endl;
+    }
+    if (mReplayOptions.exitWhenDone)
+        glfwSetWindowShouldClose(mWindow, true);
+}
+
 void Viewer::switchBackend()
 {
+    mSwitchStart = std::chrono::steady_clock::now();
     if (mCurrentRender->getType() == SHADER_BACKEND_TYPE::OPENGL) {
         ImGui_ImplOpenGL3_Shutdown();
         cleanupOpenGL();
@@ -231,6 +344,16 @@ void Viewer::switchBackend()
         mWindow = nullptr;
     }
 
+    const bool frustumCulling = mCurrentRender->getFrustumCulling();
+    const bool occlusionCulling = mCurrentRender->getOcclusionCulling();
+    const bool lodEnabled = mCurrentRender->getLODEnabled();
+    const float lodBias = mCurrentRender->getLODBias();
+    const bool meshletCulling = mCurrentRender->getMeshletCulling();
+    const bool clusterConeCulling = mCurrentRender->getClusterConeCulling();
+    const bool bindlessTextures = mCurrentRender->getBindlessTextures();
+    const bool reverseZ = mCurrentRender->getReverseZ();
+    const bool depthPrepass = mCurrentRender->getDepthPrepass();
+    const bool frontToBack = mCurrentRender->getFrontToBack();
     SHADER_BACKEND_TYPE newBackendType = (mShaderBackendType == SHADER_BACKEND_TYPE::OPENGL)
                                          ? SHADER_BACKEND_TYPE::VULKAN
                                          : SHADER_BACKEND_TYPE::OPENGL;
@@ -258,9 +381,22 @@ void Viewer::switchBackend()
     initBackend();
 
     if (mCurrentRender) {
+        mCurrentRender->setFrustumCulling(frustumCulling);
+        mCurrentRender->setOcclusionCulling(occlusionCulling);
+        mCurrentRender->setLODEnabled(lodEnabled);
+        mCurrentRender->setLODBias(lodBias);
+        mCurrentRender->setMeshletCulling(meshletCulling);
+        mCurrentRender->setClusterConeCulling(clusterConeCulling);
+        mCurrentRender->setBindlessTextures(bindlessTextures);
+        mCurrentRender->setReverseZ(reverseZ);
+        mCurrentRender->setDepthPrepass(depthPrepass);
+        mCurrentRender->setFrontToBack(frontToBack);
         mCurrentRender->init();
+        // Geometry and images come from the cache both renderers share, nothing is read from disk again
         mCurrentRender->setup(mScene);
     }
+    mSwitchSetupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - mSwitchStart).count();
+    mSwitchTiming = true;
 
     firstMouse = true;
     rightMousePressed = false;
@@ -313,6 +449,8 @@ void Viewer::processInput(GLFWwindow *window) {
     float currentFrame = glfwGetTime();
     float deltaTime = currentFrame - lastFrame;
     lastFrame = currentFrame;
+    // The path drives the camera
+    if (mReplaying) return;
 
     // WASD movement (front, left, back, right) and space shift movement (up, down)
     if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {